@@ -7,6 +7,8 @@
 #include <stdlib.h>                                   // for strtoul, abs, NULL
 #include <string.h>                                   // for strlen, strcspn
 #include <algorithm>                                  // for max, min
+#include <atomic>                                     // for atomic, memory_order_relaxed
+#include <chrono>                                     // for steady_clock
 #include <cmath>                                      // for acos, asin, atan
 #include <memory>                                     // for __shared_ptr
 
@@ -1029,6 +1031,95 @@ static inline void compilefloat(vector<uint> &code, const char *word = nullptr)
 
 static bool compilearg(vector<uint> &code, const char *&p, int wordtype);
 static void compilestatements(vector<uint> &code, const char *&p, int rettype, int brak = '\0');
+static const uint *runcode(const uint *code, tagval &result);
+
+#define MAXRUNDEPTH 255
+static int rundepth = 0;
+
+/// Builtins without side effects.
+/// Calls of them with constant arguments get evaluated while compiling, the code only contains their result.
+static const char * const purecommands[] =
+{
+    "+", "-", "*", "div", "mod", "+f", "-f", "*f", "divf", "modf", "min", "max", "minf", "maxf", "abs", "absf",
+    "=", "!=", "<", ">", "<=", ">=", "=f", "!=f", "<f", ">f", "<=f", ">=f", "!",
+    "&", "|", "^", "~", "&~", "|~", "^~", "<<", ">>",
+    "sqrt", "pow", "exp", "loge", "log2", "log10", "sin", "cos", "tan", "asin", "acos", "atan", "atan2",
+    "=s", "!=s", "<s", ">s", "<=s", ">=s", "strcmp", "strlen", "strstr"
+};
+
+static bool ispure(ident *id)
+{
+    static bool marked = false;
+    if(!marked)
+    {
+        for(const char *name : purecommands)
+        {
+            ident *cmd = idents.access(name);
+            if(cmd && cmd->type == ID_COMMAND) cmd->flags |= IDF_PURE;
+        }
+        marked = true;
+    }
+    return (id->flags&IDF_PURE) != 0;
+}
+
+/// The number of values code[start..end) pushes, or -1 if it does anything but pushing constants.
+static int countconstants(const vector<uint> &code, int start, int end)
+{
+    int n = 0;
+    for(int i = start; i < end; n++)
+    {
+        uint op = code[i++];
+        switch(op&0xFF)
+        {
+            case CODE_VALI|RET_NULL: case CODE_VALI|RET_STR: case CODE_VALI|RET_INT: case CODE_VALI|RET_FLOAT:
+            case CODE_VAL|RET_NULL:
+                break;
+            case CODE_VAL|RET_INT: case CODE_VAL|RET_FLOAT:
+                i++;
+                break;
+            case CODE_MACRO: case CODE_VAL|RET_STR:
+                i += (op>>8)/sizeof(uint) + 1;
+                break;
+            default:
+                return -1;
+        }
+    }
+    return n;
+}
+
+/// Run code[start..], which only works on constants and leaves its value as result, and replace it by that value.
+/// @return false if the value has no exact representation as constant, the code then stays as it is.
+static bool foldconstant(vector<uint> &code, int start, bool macro = false)
+{
+    if(rundepth + 2 >= MAXRUNDEPTH) return false;
+    vector<uint> buf;
+    buf.reserve(code.length() - start + 2);
+    buf.add(CODE_START);
+    buf.put(&code[start], code.length() - start);
+    buf.add(CODE_EXIT);
+    tagval result;
+    runcode(buf.getbuf()+1, result);
+    if(result.type == VAL_FLOAT && !std::isfinite(result.f)) return false;
+    code.setsize(start);
+    switch(result.type)
+    {
+        case VAL_INT: compileint(code, result.i); break;
+        case VAL_FLOAT: compilefloat(code, result.f); break;
+        case VAL_STR: case VAL_MACRO: compilestr(code, result.s, int(strlen(result.s)), macro); break;
+        default: compilenull(code); break;
+    }
+    freearg(result);
+    return true;
+}
+
+/// Concatenate the last numconc values with spaces, right away if they are constants.
+static void compileconc(vector<uint> &code, int start, int numconc)
+{
+    code.add(CODE_CONC|RET_STR|(numconc<<8));
+    if(countconstants(code, start, code.length()-1) != numconc) return;
+    code.add(CODE_RESULT);
+    if(!foldconstant(code, start)) code.pop();
+}
 
 static inline void compileval(vector<uint> &code, int wordtype, char *word, int wordlen)
 {
@@ -1322,16 +1413,25 @@ static bool compileword(vector<uint> &code, const char *&p, int wordtype, char *
         case '\"': word = cutstring(p, wordlen); break;
         case '$': compilelookup(code, p, wordtype); return true;
         case '(':
+        {
             p++;
+            int start = code.length();
             code.add(CODE_ENTER);
             compilestatements(code, p, VAL_ANY, ')');
             code.add(CODE_EXIT|(wordtype < VAL_ANY ? wordtype<<CODE_RET : 0));
+            // an expression which folded to a constant is replaced by its value
+            if(code[code.length()-2] == CODE_RESULT && countconstants(code, start+1, code.length()-2) == 1)
+            {
+                code.add(CODE_RESULT);
+                if(!foldconstant(code, start, wordtype == VAL_STR)) code.pop();
+            }
             switch(wordtype)
             {
                 case VAL_CODE: code.add(CODE_COMPILE); break;
                 case VAL_IDENT: code.add(CODE_IDENTU); break;
             }
-            return true;        
+            return true;
+        }
         case '[':
             p++;
             compileblock(code, p, wordtype);
@@ -1412,11 +1512,13 @@ static void compilestatements(vector<uint> &code, const char *&p, int rettype, i
                     break;
                 case ID_COMMAND:
                 {
-                    int comtype = CODE_COM, fakeargs = 0;
+                    int comtype = CODE_COM, fakeargs = 0, start = code.length();
                     bool rep = false;
                     for(const char *fmt = id->args; *fmt; fmt++) switch(*fmt)
                     {
                     case 's': 
+                    {
+                        int argstart = code.length();
                         if(more) more = compilearg(code, p, VAL_STR);
                         if(!more) 
                         {
@@ -1428,10 +1530,11 @@ static void compilestatements(vector<uint> &code, const char *&p, int rettype, i
                         {
                             int numconc = 0;
                             while(numargs + numconc < MAXARGS && (more = compilearg(code, p, VAL_STR))) numconc++;
-                            if(numconc > 0) code.add(CODE_CONC|RET_STR|((numconc+1)<<8));
+                            if(numconc > 0) compileconc(code, argstart, numconc+1);
                         }
                         numargs++;
                         break;
+                    }
                     case 'i': if(more) more = compilearg(code, p, VAL_INT); if(!more) { if(rep) break; compileint(code); fakeargs++; } numargs++; break;
                     case 'b': if(more) more = compilearg(code, p, VAL_INT); if(!more) { if(rep) break; compileint(code, INT_MIN); fakeargs++; } numargs++; break;
                     case 'f': if(more) more = compilearg(code, p, VAL_FLOAT); if(!more) { if(rep) break; compilefloat(code); fakeargs++; } numargs++; break; 
@@ -1457,6 +1560,8 @@ static void compilestatements(vector<uint> &code, const char *&p, int rettype, i
                     }
                 endfmt:
                     code.add(comtype|(rettype < VAL_ANY ? rettype<<CODE_RET : 0)|(id->index<<8));
+                    if(ispure(id) && countconstants(code, start, code.length()-1) >= 0 && foldconstant(code, start))
+                        code.add(CODE_RESULT|(rettype < VAL_ANY ? rettype<<CODE_RET : 0));
                     break;
                 }
                 case ID_LOCAL:
@@ -1476,15 +1581,18 @@ static void compilestatements(vector<uint> &code, const char *&p, int rettype, i
                     else code.add(CODE_FVAR1|(id->index<<8));
                     break;
                 case ID_SVAR:
+                {
+                    int argstart = code.length();
                     if(!(more = compilearg(code, p, VAL_STR))) code.add(CODE_PRINT|(id->index<<8));
                     else 
                     {
                         int numconc = 0;
                         while(numconc+1 < MAXARGS && (more = compilearg(code, p, VAL_ANY))) numconc++;
-                        if(numconc > 0) code.add(CODE_CONC|RET_STR|((numconc+1)<<8));
+                        if(numconc > 0) compileconc(code, argstart, numconc+1);
                         code.add(CODE_SVAR1|(id->index<<8));
                     }
                     break;
+                }
             }        
             delete[] idname;
         }
@@ -1575,6 +1683,66 @@ void freecode(uint *code)
     }
 }
 
+/// A script compiled by compilecode(), kept for the next time the same text gets executed.
+struct cachedscript
+{
+    const char *name;   ///< the script text
+    uint *code;
+    int len;
+    int numidents;      ///< size of identmap when compiled, the code depends on which idents exist
+};
+
+static hashnameset<cachedscript> scriptcache;
+
+static void clearscriptcache()
+{
+    enumerate(scriptcache, cachedscript, s, { freecode(s.code); delete[] s.name; });
+    scriptcache.clear();
+}
+
+/// How many compiled scripts are kept at most, 0 to compile every script again each time it gets executed.
+VARF(maxcachedscripts, 0, 256, 4096, clearscriptcache());
+
+/// Scripts longer than this are mostly config files which get executed once only.
+#define MAXCACHEDSCRIPTLEN 4096
+
+/// Get the compiled code of p, which is recompiled only if idents got added since it was compiled last.
+/// @return nullptr if p is not worth caching, the caller then has to compile it itself.
+static cachedscript *getcachedscript(const char *p)
+{
+    if(!maxcachedscripts || strlen(p) > MAXCACHEDSCRIPTLEN) return nullptr;
+    cachedscript *s = scriptcache.access(p);
+    if(s && s->numidents == identmap.length()) return s;
+
+    vector<uint> buf;
+    buf.reserve(64);
+    compilemain(buf, p);
+    uint *code = new uint[buf.length()];
+    memcpy(code, buf.getbuf(), buf.length()*sizeof(uint));
+    code[0] += 0x100;
+    if(s) freecode(s->code);
+    else
+    {
+        if(scriptcache.numelems >= maxcachedscripts) clearscriptcache();
+        const char *name = newstring(p);
+        s = &scriptcache[name];
+        s->name = name;
+    }
+    s->code = code;
+    s->len = buf.length();
+    s->numidents = identmap.length();
+    return s;
+}
+
+/// Compile p into buf like compilemain() does, but take the code from the script cache if possible.
+static void compilescript(vector<uint> &buf, const char *p)
+{
+    cachedscript *s = getcachedscript(p);
+    if(!s) { compilemain(buf, p); return; }
+    buf.put(s->code, s->len);
+    buf[0] = CODE_START;
+}
+
 void printvar(ident *id, int i)
 {
     if (i < 0) Log.std->info("{} = {}", id->name, i);
@@ -1658,6 +1826,151 @@ static const uint *skipcode(const uint *code, tagval &result)
     }
 }
 
+/// Opt-in profiling of the aliases and builtins scripts call, see scriptprofilestats and scriptprofiledump.
+VARF(scriptprofile, 0, 0, 1, scriptprofiling = scriptprofile != 0);
+
+std::atomic<uint> scriptallocs(0);
+bool scriptprofiling = false;
+
+typedef std::chrono::steady_clock profclock;
+
+/// Totals of one alias or builtin.
+struct scriptprofentry
+{
+    int calls, allocs, depth;
+    profclock::duration inclusive, exclusive;
+};
+
+/// A node of the call tree, one per distinct stack of calls.
+struct scriptprofnode
+{
+    int parent;
+    ident *id;
+    profclock::duration exclusive;
+};
+
+struct scriptprofframe
+{
+    int node;
+    uint allocs, childallocs;
+    profclock::duration children;
+    profclock::time_point start;
+};
+
+static vector<scriptprofentry> profentries; // by ident index
+static vector<scriptprofnode> profnodes;
+static hashtable<ivec, int> profchildren;   // (parent node, ident index) -> node
+static vector<scriptprofframe> profstack;
+
+static void scriptprofenter(ident *id)
+{
+    while(profentries.length() <= id->index) profentries.add(scriptprofentry());
+    scriptprofentry &e = profentries[id->index];
+    e.calls++;
+    e.depth++;
+    int parent = profstack.empty() ? -1 : profstack.last().node;
+    int &node = profchildren.access(ivec(parent, id->index, 0), -1);
+    if(node < 0)
+    {
+        node = profnodes.length();
+        scriptprofnode &n = profnodes.add();
+        n.parent = parent;
+        n.id = id;
+        n.exclusive = profclock::duration::zero();
+    }
+    scriptprofframe &f = profstack.add();
+    f.node = node;
+    f.allocs = scriptallocs.load(std::memory_order_relaxed);
+    f.childallocs = 0;
+    f.children = profclock::duration::zero();
+    f.start = profclock::now();
+}
+
+static void scriptprofleave()
+{
+    profclock::time_point end = profclock::now();
+    if(profstack.empty()) return;
+    scriptprofframe f = profstack.pop();
+    scriptprofnode &n = profnodes[f.node];
+    scriptprofentry &e = profentries[n.id->index];
+    profclock::duration total = end - f.start;
+    uint allocs = scriptallocs.load(std::memory_order_relaxed) - f.allocs;
+    n.exclusive += total - f.children;
+    e.exclusive += total - f.children;
+    e.allocs += allocs - f.childallocs;
+    // recursive calls are already part of the time of the outermost call
+    if(--e.depth <= 0) { e.inclusive += total; e.depth = 0; }
+    if(profstack.length())
+    {
+        profstack.last().children += total;
+        profstack.last().childallocs += allocs;
+    }
+}
+
+/// Profiles the call of id for as long as it lives, if profiling was enabled when it got created.
+struct scriptprofscope
+{
+    bool active;
+
+    scriptprofscope(ident *id) : active(scriptprofile != 0) { if(active) scriptprofenter(id); }
+    ~scriptprofscope() { if(active) scriptprofleave(); }
+};
+
+static void scriptprofilereset()
+{
+    // calls in progress keep their frames, so nodes and depths stay
+    loopv(profentries)
+    {
+        scriptprofentry &e = profentries[i];
+        e.calls = e.allocs = 0;
+        e.inclusive = e.exclusive = profclock::duration::zero();
+    }
+    loopv(profnodes) profnodes[i].exclusive = profclock::duration::zero();
+}
+COMMAND(scriptprofilereset, "");
+
+static void scriptprofilestats(int *num)
+{
+    typedef std::chrono::duration<double, std::milli> ms;
+    vector<int> order;
+    loopv(profentries) if(profentries[i].calls) order.add(i);
+    order.sort([](const int &a, const int &b) { return profentries[a].exclusive > profentries[b].exclusive; });
+    Log.std->info("script profile: {} aliases and builtins called", order.length());
+    Log.std->info("  {:>8} {:>12} {:>12} {:>8}  name", "calls", "incl ms", "excl ms", "allocs");
+    loopv(order)
+    {
+        if(i >= (*num > 0 ? *num : 20)) break;
+        const scriptprofentry &e = profentries[order[i]];
+        Log.std->info("  {:>8} {:>12.3f} {:>12.3f} {:>8}  {}", e.calls, ms(e.inclusive).count(), ms(e.exclusive).count(), e.allocs, identmap[order[i]]->name);
+    }
+}
+COMMAND(scriptprofilestats, "i");
+
+/// Write the call tree as collapsed stacks, one "outer;inner;innermost microseconds" line per stack,
+/// which flamegraph tools take as input.
+static void scriptprofiledump(const char *name)
+{
+    stream *f = openutf8file(path(name && name[0] ? name : "scriptprofile.txt", true), "w");
+    if(!f) { Log.std->error("could not write script profile {}", name); return; }
+    vector<int> stack;
+    loopv(profnodes)
+    {
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(profnodes[i].exclusive).count();
+        if(us <= 0) continue;
+        stack.setsize(0);
+        for(int node = i; node >= 0; node = profnodes[node].parent) stack.add(node);
+        loopvrev(stack)
+        {
+            // ; and spaces separate frames and the count
+            for(const char *s = profnodes[stack[i]].id->name; *s; s++) f->putchar(*s == ';' || iscubespace(*s) ? '_' : *s);
+            f->putchar(i ? ';' : ' ');
+        }
+        f->printf("%lld\n", us);
+    }
+    delete f;
+}
+COMMAND(scriptprofiledump, "s");
+
 static inline void callcommand(ident *id, tagval *args, int numargs, bool lookup = false)
 {
     int i = -1, fakeargs = 0;
@@ -1681,7 +1994,7 @@ static inline void callcommand(ident *id, tagval *args, int numargs, bool lookup
             {
                 vector<uint> buf;
                 buf.reserve(64);
-                compilemain(buf, numargs <= i ? "" : args[i].getstr());
+                compilescript(buf, numargs <= i ? "" : args[i].getstr());
                 freearg(args[i]);
                 args[i].setcode(buf.getbuf()+1);
                 buf.disown();
@@ -1722,9 +2035,6 @@ cleanup:
     for(; i < numargs; i++) freearg(args[i]);
 }
 
-#define MAXRUNDEPTH 255
-static int rundepth = 0;
- 
 static const uint *runcode(const uint *code, tagval &result)
 {
     result.setnull();
@@ -1823,7 +2133,7 @@ static const uint *runcode(const uint *code, tagval &result)
                 {
                     case VAL_INT: buf.reserve(8); buf.add(CODE_START); compileint(buf, arg.i); buf.add(CODE_RESULT); buf.add(CODE_EXIT); break;
                     case VAL_FLOAT: buf.reserve(8); buf.add(CODE_START); compilefloat(buf, arg.f); buf.add(CODE_RESULT); buf.add(CODE_EXIT); break;
-                    case VAL_STR: case VAL_MACRO: buf.reserve(64); compilemain(buf, arg.s); freearg(arg); break;
+                    case VAL_STR: case VAL_MACRO: buf.reserve(64); compilescript(buf, arg.s); freearg(arg); break;
                     default: buf.reserve(8); buf.add(CODE_START); compilenull(buf); buf.add(CODE_RESULT); buf.add(CODE_EXIT); break;
                 }
                 arg.setcode(buf.getbuf()+1);
@@ -1973,7 +2283,10 @@ static const uint *runcode(const uint *code, tagval &result)
             callcom:
 #endif
                 forcenull(result);
-                CALLCOM(numargs) 
+                {
+                    scriptprofscope prof(id);
+                    CALLCOM(numargs)
+                }
             forceresult:
                 freeargs(args, numargs, 0);
                 forcearg(result, op&CODE_RET_MASK);
@@ -1988,12 +2301,16 @@ static const uint *runcode(const uint *code, tagval &result)
             case CODE_COMV|RET_NULL: case CODE_COMV|RET_STR: case CODE_COMV|RET_FLOAT: case CODE_COMV|RET_INT:
                 id = identmap[op>>8];
                 forcenull(result);
-                ((comfunv)id->fun)(args, numargs);
+                {
+                    scriptprofscope prof(id);
+                    ((comfunv)id->fun)(args, numargs);
+                }
                 goto forceresult; 
             case CODE_COMC|RET_NULL: case CODE_COMC|RET_STR: case CODE_COMC|RET_FLOAT: case CODE_COMC|RET_INT:
                 id = identmap[op>>8];
                 forcenull(result);
                 {
+                    scriptprofscope prof(id);
                     vector<char> buf;
                     buf.reserve(MAXSTRLEN);
                     ((comfun1)id->fun)(conc(buf, args, numargs, true));
@@ -2046,12 +2363,15 @@ static const uint *runcode(const uint *code, tagval &result)
                     identflags |= id->flags&IDF_OVERRIDDEN; \
                     identlink aliaslink = { id, aliasstack, (1<<newargs)-1, argstack }; \
                     aliasstack = &aliaslink; \
-                    if(!id->code) id->code = compilecode(id->getstr()); \
-                    uint *code = id->code; \
-                    code[0] += 0x100; \
-                    runcode(code+1, result); \
-                    code[0] -= 0x100; \
-                    if(int(code[0]) < 0x100) delete[] code; \
+                    { \
+                        scriptprofscope prof(id); \
+                        if(!id->code) id->code = compilecode(id->getstr()); \
+                        uint *code = id->code; \
+                        code[0] += 0x100; \
+                        runcode(code+1, result); \
+                        code[0] -= 0x100; \
+                        if(int(code[0]) < 0x100) delete[] code; \
+                    } \
                     aliasstack = aliaslink.next; \
                     identflags = oldflags; \
                     for(int i = 0; i < newargs; i++) \
@@ -2093,11 +2413,14 @@ static const uint *runcode(const uint *code, tagval &result)
                 switch(id->type)
                 {
                     case ID_COMMAND:
+                    {
                         freearg(args[0]);
+                        scriptprofscope prof(id);
                         callcommand(id, args+1, numargs-1);
                         forcearg(result, op&CODE_RET_MASK);
                         numargs = 0;
                         continue;
+                    }
                     case ID_LOCAL:
                     {
                         identstack locals[MAXARGS];
@@ -2151,6 +2474,14 @@ void executeret(const uint *code, tagval &result)
 
 void executeret(const char *p, tagval &result)
 {
+    if(cachedscript *s = getcachedscript(p))
+    {
+        uint *code = s->code;
+        keepcode(code);
+        runcode(code+1, result);
+        freecode(code);
+        return;
+    }
     vector<uint> code;
     code.reserve(64);
     compilemain(code, p, VAL_ANY);
@@ -2187,12 +2518,22 @@ int execute(const uint *code)
 
 int execute(const char *p)
 {
-    vector<uint> code;
-    code.reserve(64);
-    compilemain(code, p, VAL_INT);
     tagval result;
-    runcode(code.getbuf()+1, result);
-    if(int(code[0]) >= 0x100) code.disown();
+    if(cachedscript *s = getcachedscript(p))
+    {
+        uint *code = s->code;
+        keepcode(code);
+        runcode(code+1, result);
+        freecode(code);
+    }
+    else
+    {
+        vector<uint> code;
+        code.reserve(64);
+        compilemain(code, p, VAL_INT);
+        runcode(code.getbuf()+1, result);
+        if(int(code[0]) >= 0x100) code.disown();
+    }
     int i = result.getint();
     freearg(result);
     return i;
@@ -10,7 +10,6 @@
 #include "SDL_mutex.h"                                // for SDL_UnlockMutex
 #include "SDL_opengl.h"                               // for glGenTextures
 #include "SDL_stdinc.h"                               // for Uint32
-#include "SDL_thread.h"                               // for SDL_CreateThread
 #include "SDL_timer.h"                                // for SDL_GetTicks
 #include "inexor/engine/blend.hpp"                    // for setblendmaporigin
 #include "inexor/engine/lightmap.hpp"                 // for LightMap, Light...
@@ -45,6 +44,7 @@
 #include "inexor/texture/slot.hpp"                    // for VSlot, lookupvslot
 #include "inexor/texture/texsettings.hpp"             // for hwtexsize, maxt...
 #include "inexor/texture/texture.hpp"                 // for createtexture
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem, Job...
 
 struct BlendMapCache;
 struct ShadowRayCache;
@@ -77,13 +77,13 @@ struct lightmapworker
     BlendMapCache *blendmapcache;
     bool needspace, doneworking;
     SDL_cond *spacecond;
-    SDL_Thread *thread;
+    inexor::util::JobHandle job;
 
     lightmapworker();
     ~lightmapworker();
 
     void reset();
-    bool setupthread();
+    bool setupthread(int index);
     void cleanupthread();
 
     static int work(void *data);
@@ -645,13 +645,18 @@ static float calcocclusion(ShadowRayCache *cache, const vec &o, const vec &norma
     // TODO: decken werden nicht beleuchtet
     // if(normal == vec(0, 0, -1)) ...
 
-    int occluedrays = 0;
-    for(auto it : rays)
+    // check whether there's a wall in the field around the sample:
+    std::array<vec, 5> origins, dirs;
+    std::array<float, 5> dists;
+    loopi(rays.size())
     {
-        // check whether there's a wall in the field around the sample:
-        vec ray(rotationmatrix.transform(it));
-        if(shadowray(cache, vec(ray).mul(tolerance).add(o), ray, ambientocclusionradius, RAY_ALPHAPOLY|RAY_SHADOW|(skytexturelight ? RAY_SKIPSKY : 0), nullptr) <= (ambientocclusionradius-1.0f)) occluedrays++;
-    } // TODO ambientocclusionradius - tolerance
+        dirs[i] = rotationmatrix.transform(rays[i]);
+        origins[i] = vec(dirs[i]).mul(tolerance).add(o);
+    }
+    shadowrayssamestart(cache, rays.size(), origins.data(), dirs.data(), dists.data(), ambientocclusionradius, RAY_ALPHAPOLY|RAY_SHADOW|(skytexturelight ? RAY_SKIPSKY : 0), nullptr);
+    int occluedrays = 0;
+    for(float dist : dists) if(dist <= (ambientocclusionradius-1.0f)) occluedrays++;
+    // TODO ambientocclusionradius - tolerance
     // TODO: more rays to the side?
     // TODO: make ao part of calcskylight,
     // but this entire (lightmap packaging) system is fucked, ao should be treated on diffuse only, but we clmap diffuse..
@@ -816,9 +821,18 @@ static void calcskylight(lightmapworker *w, const vec &o, const vec &normal, flo
     flags |= RAY_SHADOW;
     if(skytexturelight) flags |= RAY_SKIPSKY;
     int hit = 0;
-    if(w) loopi(17) 
+    if(w)
     {
-        if(normal.dot(rays[i])>=0 && shadowray(w->shadowraycache, vec(rays[i]).mul(tolerance).add(o), rays[i], 1e16f, flags, t)>1e15f) hit++;
+        vec origins[17], dirs[17];
+        float dists[17];
+        int numrays = 0;
+        loopi(17) if(normal.dot(rays[i])>=0)
+        {
+            dirs[numrays] = rays[i];
+            origins[numrays++] = vec(rays[i]).mul(tolerance).add(o);
+        }
+        shadowrayssamestart(w->shadowraycache, numrays, origins, dirs, dists, 1e16f, flags, t);
+        loopi(numrays) if(dists[i]>1e15f) hit++;
     }
     else loopi(17) 
     {
@@ -2193,7 +2207,6 @@ lightmapworker::lightmapworker()
     blendmapcache = newblendmapcache();
     needspace = doneworking = false;
     spacecond = nullptr;
-    thread = nullptr;
 }
 
 lightmapworker::~lightmapworker()
@@ -2211,7 +2224,7 @@ lightmapworker::~lightmapworker()
 void lightmapworker::cleanupthread()
 {
     if(spacecond) { SDL_DestroyCond(spacecond); spacecond = nullptr; }
-    thread = nullptr;
+    job = nullptr;
 }
 
 void lightmapworker::reset()
@@ -2222,12 +2235,15 @@ void lightmapworker::reset()
     resetshadowraycache(shadowraycache);
 }
 
-bool lightmapworker::setupthread()
+/// Runs the worker loop as a job, each worker on its own worker of the job system.
+bool lightmapworker::setupthread(int index)
 {
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(!jobs) return false;
     if(!spacecond) spacecond = SDL_CreateCond();
     if(!spacecond) return false;
-    thread = SDL_CreateThread(work, "lightmap worker", this);
-    return thread!=nullptr;
+    job = jobs->submit([this] { work(this); }, {}, index);
+    return true;
 }
 
 static Uint32 calclighttimer(Uint32 interval, void *param)
@@ -2250,6 +2266,15 @@ bool setlightmapquality(int quality)
 
 VARP(lightthreads, 0, 0, 16);
 
+/// Every worker loop occupies a worker of the job system for the whole calclight, so there can not be more of them.
+static int numlightthreads()
+{
+    extern SharedVar<int> numcpus;
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(!jobs) return 1;
+    return min(lightthreads > 0 ? int(lightthreads) : int(numcpus), jobs->num_workers());
+}
+
 #define ALLOCLOCK(name, init) { if(lightmapping > 1) name = init(); if(!name) lightmapping = 1; }
 #define FREELOCK(name, destroy) { if(name) { destroy(name); name = NULL; } }
 
@@ -2279,7 +2304,7 @@ static void setupthreads(int numthreads)
     {
         lightmapworker *w = lightmapworkers[i];
         w->reset();
-        if(lightmapping <= 1 || w->setupthread()) continue;
+        if(lightmapping <= 1 || w->setupthread(i)) continue;
         w->cleanupthread();
         lightmapping = i >= 1 ? max(i, 2) : 1;
         break;
@@ -2301,10 +2326,11 @@ static void cleanupthreads()
             if(w->needspace && w->spacecond) SDL_CondSignal(w->spacecond);
         }
         SDL_UnlockMutex(tasklock);
+        inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
         loopv(lightmapworkers) 
         {
             lightmapworker *w = lightmapworkers[i];
-            if(w->thread) SDL_WaitThread(w->thread, nullptr);
+            if(w->job) jobs->wait(w->job);
         }
     }
     loopv(lightmapexts)
@@ -2335,8 +2361,7 @@ void calclight(int *quality)
     mpremip(true);                                                        //merge faces and consequently reduce vertex data
     optimizeblendmap();
     loadlayermasks();
-    extern SharedVar<int> numcpus;
-    int numthreads = lightthreads > 0 ? lightthreads : numcpus;
+    int numthreads = numlightthreads();
     if(numthreads > 1) preloadusedmapmodels(false, true);
     resetlightmaps(false);
     clearsurfaces(worldroot);
@@ -2393,8 +2418,7 @@ void patchlight(int *quality)
     }
     renderbackground("patching lightmaps... (esc to abort)");
     loadlayermasks();
-    extern SharedVar<int> numcpus;
-    int numthreads = lightthreads > 0 ? lightthreads : numcpus;
+    int numthreads = numlightthreads();
     if(numthreads > 1) preloadusedmapmodels(false, true);
     cleanuplightmaps();
     taskprogress = progress = 0;
@@ -2651,6 +2675,47 @@ static void findunlit(int i)
 VARF(roundlightmaptex, 0, 4, 16, { cleanuplightmaps(); initlights(); allchanged(); });
 VARF(batchlightmaps, 0, 4, 256, { cleanuplightmaps(); initlights(); allchanged(); });
 
+/// A lightmap that gets copied into the pixels of a combined lightmap texture.
+struct lightmapcopy
+{
+    LightMap *lm;
+    uchar *dst;
+    size_t stride;
+};
+
+static vector<int> unlitlightmaps;
+static vector<lightmapcopy> lightmapcopies;
+
+static void preparelightmap(int i)
+{
+    int numunlit = unlitlightmaps.length();
+    if(i < numunlit) findunlit(unlitlightmaps[i]);
+    else
+    {
+        lightmapcopy &c = lightmapcopies[i - numunlit];
+        copylightmap(*c.lm, c.dst, c.stride);
+    }
+}
+
+/// Work off the queued unlit searches and copies, spread over the cores since there are hundreds of them on big maps.
+/// Each one touches a different lightmap or region of a texture, so they need no locking.
+static void flushlightmapjobs()
+{
+    int numjobs = unlitlightmaps.length() + lightmapcopies.length();
+    if(inexor::util::JobSystem *jobs = inexor::util::JobSystem::running()) jobs->parallel_for(numjobs, preparelightmap);
+    else loopi(numjobs) preparelightmap(i);
+    unlitlightmaps.setsize(0);
+    lightmapcopies.setsize(0);
+}
+
+/// A combined lightmap texture that is ready to be uploaded, once its lightmaps are copied into it.
+struct lightmapupload
+{
+    int tex, bpp;
+    uchar *data;
+    LightMap *firstlm;
+};
+
 void genlightmaptexs(int flagmask, int flagval)
 {
     if(lightmaptexs.length() < LMID_RESERVED) genreservedlightmaptexs();
@@ -2663,8 +2728,12 @@ void genlightmaptexs(int flagmask, int flagval)
         int type = lm.type&LM_TYPE;
         remaining[type]++; 
         total++;
-        if(lm.unlitx < 0) findunlit(i);
+        if(lm.unlitx < 0) unlitlightmaps.add(i);
     }
+    flushlightmapjobs();
+
+    // lay out all textures first, so filling them can happen in parallel, only the upload has to stay on the GL thread
+    vector<lightmapupload> uploads;
 
     int sizelimit = (maxtexsize ? min(maxtexsize, hwtexsize) : hwtexsize)/max(LM_PACKW, LM_PACKH);
     sizelimit = min(batchlightmaps, sizelimit*sizelimit);
@@ -2713,17 +2782,35 @@ void genlightmaptexs(int flagmask, int flagval)
                 tex.unlity = offsety + lm.unlity;
             }
 
-            if(data) copylightmap(lm, &data[bpp*(offsety*tex.w + offsetx)], bpp*tex.w);
+            if(data)
+            {
+                lightmapcopy &c = lightmapcopies.add();
+                c.lm = &lm;
+                c.dst = &data[bpp*(offsety*tex.w + offsetx)];
+                c.stride = bpp*tex.w;
+            }
 
             offsetx += LM_PACKW;
             if(offsetx >= tex.w) { offsetx = 0; offsety += LM_PACKH; }
             if(offsety >= tex.h) break;
         }
-        
+
+        lightmapupload &u = uploads.add();
+        u.tex = lightmaptexs.length()-1;
+        u.bpp = bpp;
+        u.data = data;
+        u.firstlm = firstlm;
+    }
+    flushlightmapjobs();
+
+    loopv(uploads)
+    {
+        lightmapupload &u = uploads[i];
+        LightMapTexture &tex = lightmaptexs[u.tex];
         glGenTextures(1, &tex.id);
-        createtexture(tex.id, tex.w, tex.h, data ? data : firstlm->data, 3, 1, bpp==4 ? GL_RGBA : GL_RGB);
-        if(data) delete[] data;
-    }        
+        createtexture(tex.id, tex.w, tex.h, u.data ? u.data : u.firstlm->data, 3, 1, u.bpp==4 ? GL_RGBA : GL_RGB);
+        if(u.data) delete[] u.data;
+    }
 }
 
 bool brightengeom = false, shouldlightents = false;
@@ -47,9 +47,11 @@
 #include "inexor/shared/tools.hpp"                    // for clamp
 #include "inexor/sound/mumble.hpp"                    // for initmumble
 #include "inexor/sound/sound.hpp"                     // for clear_sound
+#include "inexor/texture/streaming.hpp"               // for updatetexstreaming
 #include "inexor/texture/texture.hpp"                 // for reloadtexture
 #include "inexor/ui/legacy/menus.hpp"                 // for initwarning
 #include "inexor/ui/screen/ScreenManager.hpp"         // for ScreenManager
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem
 #include "inexor/util/Subsystem.hpp"                  // for Metasystem, SUB...
 #include "inexor/util/legacy_time.hpp"                // for updatetime, las...
 
@@ -98,6 +100,7 @@ void quit()
     disconnect();
     writecfg();
     cleanup();
+    metapp.stop("jobs");
     metapp.stop("cef");
     metapp.stop("rpc");
     exit(EXIT_SUCCESS);
@@ -269,6 +272,26 @@ COMMAND(resetgl, "");
 
 VAR(numcpus, 1, 1, 16);
 
+static bool jobthreadschanged = false;
+
+/// Worker threads of the job system, 0 uses one for every core besides the main thread.
+/// Changes apply once the job system has nothing left to do, see applyjobthreads().
+VARFP(jobthreads, 0, 0, 64, jobthreadschanged = true);
+
+/// Restart the workers with the number jobthreads asks for, unless jobs are still running:
+/// restarting waits for them, which would stall the frame.
+static void applyjobthreads()
+{
+    if(!jobthreadschanged) return;
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(jobs)
+    {
+        if(!jobs->idle()) return;
+        jobs->set_num_workers(jobthreads > 0 ? jobthreads : numcpus - 1);
+    }
+    jobthreadschanged = false;
+}
+
 /// find command line argument
 static bool findarg(int argc, char **argv, const char *str)
 {
@@ -332,6 +355,12 @@ int main(int argc, char **argv)
 
     numcpus = clamp(SDL_GetCPUCount(), 1, 16);
 
+    // Engine wide worker threads, used by lightmap and pvs generation.
+    SUBSYSTEM_REQUIRE(jobs);
+    metapp.start("jobs");
+    inexor::util::JobSystem::running()->set_num_workers(jobthreads > 0 ? jobthreads : numcpus - 1);
+    metapp.initialize("jobs", argc, argv);
+
     Log.start_stop->info("init: SDL");
 
     int par = 0;
@@ -444,6 +473,7 @@ int main(int argc, char **argv)
         updatetime(game::ispaused(), game::gamespeed, fps_limit);
 
         metapp.tick();
+        applyjobthreads();
 
         input_router.checkinput();
         menuprocess();
@@ -463,6 +493,8 @@ int main(int argc, char **argv)
 
         if(screen_manager.minimized) continue;
 
+        updatetexstreaming();
+
         inbetweenframes = false;
 
         if(mainmenu) gl_drawmainmenu();
@@ -5,9 +5,10 @@
 #include <stdlib.h>                                   // for abs
 #include <string.h>                                   // for memcpy, memset
 #include <algorithm>                                  // for max, min, swap
+#include <chrono>                                     // for steady_clock
 #include <memory>                                     // for __shared_ptr
 
-#include "inexor/engine/lightmap.hpp"                 // for brightencube
+#include "inexor/engine/lightmap.hpp"                 // for brightencube, lightmapping
 #include "inexor/engine/material.hpp"                 // for ::MAT_AIR, ::MA...
 #include "inexor/engine/octa.hpp"                     // for insideworld
 #include "inexor/engine/octaedit.hpp"                 // for ::EDIT_REMIP
@@ -28,8 +29,115 @@
 #include "inexor/shared/cube_vector.hpp"              // for vector
 #include "inexor/shared/geom.hpp"                     // for ivec, ivec::(an...
 #include "inexor/shared/tools.hpp"                    // for max, min, clamp
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem
 #include "inexor/util/legacy_time.hpp"                // for totalmillis
 
+/// A slab of cache line aligned blocks of 8 cubes which newcubes() hands out instead of heap allocating every block.
+struct cubeslab
+{
+    uchar *data;
+    cube *blocks, *freeblocks;      // freed blocks are linked through their children pointer
+    int used, live;
+    cubeslab *prev, *next;          // list of slabs with free blocks
+    bool partial;
+
+    cube *end() const { return blocks + 8*CUBESLABBLOCKS; }
+
+    static const int CUBESLABBLOCKS = 2048;
+};
+
+static vector<cubeslab *> cubeslabs;          // sorted by address, to find the slab of a block
+static cubeslab *partialslabs = nullptr;
+
+static void linkcubeslab(cubeslab *s)
+{
+    s->partial = true;
+    s->prev = nullptr;
+    s->next = partialslabs;
+    if(partialslabs) partialslabs->prev = s;
+    partialslabs = s;
+}
+
+static void unlinkcubeslab(cubeslab *s)
+{
+    if(s->prev) s->prev->next = s->next;
+    else partialslabs = s->next;
+    if(s->next) s->next->prev = s->prev;
+    s->prev = s->next = nullptr;
+    s->partial = false;
+}
+
+static cubeslab *newcubeslab()
+{
+    cubeslab *s = new cubeslab;
+    s->data = new uchar[cubeslab::CUBESLABBLOCKS*8*sizeof(cube) + 63];
+    s->blocks = (cube *)(((size_t)s->data + 63) & ~size_t(63));
+    s->freeblocks = nullptr;
+    s->used = s->live = 0;
+    s->prev = s->next = nullptr;
+    s->partial = false;
+    int pos = 0;
+    while(pos < cubeslabs.length() && cubeslabs[pos]->blocks < s->blocks) pos++;
+    cubeslabs.insert(pos, s);
+    return s;
+}
+
+static void freecubeslab(cubeslab *s)
+{
+    if(s->partial) unlinkcubeslab(s);
+    cubeslabs.removeobj(s);
+    delete[] s->data;
+    delete s;
+}
+
+static cubeslab *findcubeslab(const cube *c)
+{
+    int lo = 0, hi = cubeslabs.length()-1;
+    while(lo <= hi)
+    {
+        int mid = (lo + hi)/2;
+        cubeslab *s = cubeslabs[mid];
+        if(c < s->blocks) hi = mid-1;
+        else if(c >= s->end()) lo = mid+1;
+        else return s;
+    }
+    return nullptr;
+}
+
+/// Take the next unused block of s, starting a new slab when s is full.
+static cube *bumpcubeblock(cubeslab *&s)
+{
+    if(!s || s->used >= cubeslab::CUBESLABBLOCKS) s = newcubeslab();
+    s->live++;
+    return &s->blocks[8*s->used++];
+}
+
+static cube *alloccubeblock()
+{
+    cubeslab *s = partialslabs;
+    if(!s) linkcubeslab(s = newcubeslab());
+    cube *c = s->freeblocks;
+    if(c)
+    {
+        s->freeblocks = c->children;
+        s->live++;
+    }
+    else c = bumpcubeblock(s);
+    if(!s->freeblocks && s->used >= cubeslab::CUBESLABBLOCKS) unlinkcubeslab(s);
+    return c;
+}
+
+static void freecubeblock(cube *c)
+{
+    cubeslab *s = findcubeslab(c);
+    ASSERT(s);
+    c->children = s->freeblocks;
+    s->freeblocks = c;
+    // keep the last slab around so editing a single cube back and forth does not churn slabs
+    if(--s->live <= 0 && cubeslabs.length() > 1) freecubeslab(s);
+    else if(!s->partial) linkcubeslab(s);
+}
+
 cube *worldroot = newcubes(F_SOLID);
 int allocnodes = 0;
 
@@ -79,7 +187,7 @@ cubeext *newcubeext(cube &c, int maxverts, bool init)
 
 cube *newcubes(uint face, int mat)
 {
-    cube *c = new cube[8];
+    cube *c = alloccubeblock();
     loopi(8)
     {
         c->children = nullptr;
@@ -106,10 +214,101 @@ void freeocta(cube *c)
 {
     if(!c) return;
     loopi(8) discardchildren(c[i]);
-    delete[] c;
+    freecubeblock(c);
     allocnodes--;
 }
 
+/// Compact the octree of every map on load, see compactoctree().
+static VAR_NOSYNC(octreecompact, 0, 1, 1);
+
+/// Move all blocks of the world into fresh slabs in breadth-first order, so each level of the tree
+/// lies contiguous in the morton order of its parents. Blocks owned by undo or copy buffers stay put.
+static void compactcubes()
+{
+    if(!worldroot) return;
+    vector<cube *> order, moved;
+    order.add(worldroot);
+    loopv(order) loopj(8) if(order[i][j].children) order.add(order[i][j].children);
+    cubeslab *s = nullptr;
+    loopv(order) moved.add(bumpcubeblock(s));
+    int next = 0;
+    loopv(order)
+    {
+        cube *c = moved[i];
+        memcpy(c, order[i], 8*sizeof(cube));
+        loopj(8) if(c[j].children) c[j].children = moved[++next];
+    }
+    worldroot = moved[0];
+    if(s->used < cubeslab::CUBESLABBLOCKS) linkcubeslab(s);
+    loopv(order) freecubeblock(order[i]);
+    resetclipplanes();
+}
+
+/// Every cube moves, so nothing else may look at the tree meanwhile.
+static bool cancompact()
+{
+    if(lightmapping) { Log.std->error("can not compact the octree while lightmapping"); return false; }
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(jobs && !jobs->idle()) { Log.std->error("can not compact the octree while jobs are running"); return false; }
+    return true;
+}
+
+void compactoctree()
+{
+    if(octreecompact && cancompact()) compactcubes();
+}
+
+ICOMMAND(compactoctree, "", (), { if(cancompact()) compactcubes(); });
+
+/// Time ray casts, collisions and lookups at the same random spots of the map in its current layout and after compactoctree.
+static void octreebench(int *num)
+{
+    int n = *num > 0 ? *num : 100000;
+    vector<vec> pos, dirs;
+    loopi(n)
+    {
+        pos.add(vec(rndscale(worldsize), rndscale(worldsize), rndscale(worldsize)));
+        dirs.add(vec(rndscale(2)-1, rndscale(2)-1, rndscale(2)-1).normalize());
+    }
+    loopk(2)
+    {
+        if(k)
+        {
+            if(!cancompact()) return;
+            compactcubes();
+        }
+        float dist = 0;
+        int collisions = 0, solid = 0;
+        auto start = std::chrono::steady_clock::now();
+        loopv(pos) dist += raycube(pos[i], dirs[i]);
+        auto raydone = std::chrono::steady_clock::now();
+        physent d;
+        loopv(pos)
+        {
+            d.o = pos[i];
+            if(!collide(&d, vec(0, 0, 0), 0, false)) collisions++;
+        }
+        auto collidedone = std::chrono::steady_clock::now();
+        loopv(pos) if(!isempty(lookupcube(ivec(pos[i])))) solid++;
+        auto lookupdone = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::micro> rays = raydone - start, collides = collidedone - raydone, lookups = lookupdone - collidedone;
+        Log.std->info("octreebench ({}): {:.3f} us per ray cast, {:.3f} us per collision, {:.3f} us per lookup ({}, {}, {})",
+                      k ? "compacted" : "current layout", rays.count()/n, collides.count()/n, lookups.count()/n,
+                      dist/n, collisions, solid);
+    }
+    size_t reserved = 0, live = 0;
+    loopv(cubeslabs)
+    {
+        reserved += cubeslab::CUBESLABBLOCKS*8*sizeof(cube) + 63;
+        live += cubeslabs[i]->live*8*sizeof(cube);
+    }
+    // a heap block carries at least two words of allocator bookkeeping and is only 16 byte aligned
+    size_t heap = allocnodes*(8*sizeof(cube) + 2*sizeof(void *));
+    Log.std->info("octreebench: {} nodes in {} slabs, {} KB reserved, {} KB used, about {} KB as heap blocks",
+                  allocnodes, cubeslabs.length(), reserved/1024, live/1024, heap/1024);
+}
+COMMAND(octreebench, "i");
+
 void freecubeext(cube &c)
 {
     if(c.ext)
@@ -145,7 +344,8 @@ void discardchildren(cube &c, bool fixtex, int depth)
             loopi(6) c.texture[i] = getmippedtexture(c, i);
             if(depth > 0 && filled != F_EMPTY) c.faces[0] = F_SOLID;
         }
-        DELETEA(c.children);
+        freecubeblock(c.children);
+        c.children = nullptr;
         allocnodes--;
     }
 }
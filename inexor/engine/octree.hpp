@@ -205,17 +205,17 @@ struct cubeext
     vertinfo *verts() { return (vertinfo *)(this+1); }
 };  
 
+/// The fields every traversal reads come first, render only data (ext, texture) last.
+/// Blocks of 8 children are carved from cache line aligned slabs, see newcubes().
 struct cube
 {
     cube *children;          // points to 8 cube structures which are its children, or NULL. -Z first, then -Y, -X
-    cubeext *ext;            // extended info for the cube
     union
     {
         uchar edges[12];     // edges of the cube, each uchar is 2 4bit values denoting the range.
                              // see documentation jpgs for more info.
         uint faces[3];       // 4 edges of each dimension together representing 2 perpendicular faces
     };
-    ushort texture[6];       // one for each face. same order as orient.
     ushort material;         // empty-space material
     uchar merged;            // merged faces of the cube
     union
@@ -223,6 +223,8 @@ struct cube
         uchar escaped;       // mask of which children have escaped merges
         uchar visible;       // visibility info for faces
     };
+    cubeext *ext;            // extended info for the cube
+    ushort texture[6];       // one for each face. same order as orient.
 };
 
 extern SharedVar<int> worldsize;
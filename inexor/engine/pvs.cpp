@@ -3,11 +3,11 @@
 #include <string.h>                                   // for memset, memcpy
 #include <algorithm>                                  // for max, min, swap
 #include <memory>                                     // for __shared_ptr
+#include <vector>                                     // for vector
 
 #include "SDL_keycode.h"                              // for ::SDLK_ESCAPE
 #include "SDL_mutex.h"                                // for SDL_LockMutex
 #include "SDL_stdinc.h"                               // for Uint32
-#include "SDL_thread.h"                               // for SDL_CreateThread
 #include "SDL_timer.h"                                // for SDL_GetTicks
 #include "inexor/engine/material.hpp"                 // for ::MATF_CLIP
 #include "inexor/engine/octarender.hpp"               // for valist
@@ -31,6 +31,7 @@
 #include "inexor/shared/cube_vector.hpp"              // for vector
 #include "inexor/shared/ents.hpp"                     // for physent
 #include "inexor/shared/tools.hpp"                    // for max, min, swap
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem, Job...
 
 using namespace inexor::io;
 
@@ -320,9 +321,13 @@ static struct
 static vector<materialsurface *> waterfalls;
 uint numwaterplanes = 0;
 
+struct pvsworker;
+/// Indexed by JobSystem::worker_index() when generating in parallel.
+static vector<pvsworker *> pvsworkers;
+
 struct pvsworker
 {
-    pvsworker() : thread(nullptr), pvsnodes(new pvsnode[origpvsnodes.length()])
+    pvsworker() : pvsnodes(new pvsnode[origpvsnodes.length()])
     {
     }
     ~pvsworker()
@@ -330,7 +335,6 @@ struct pvsworker
         delete[] pvsnodes;
     }
 
-    SDL_Thread *thread;
     pvsnode *pvsnodes;
 
     shaftbb viewcellbb;
@@ -827,9 +831,11 @@ struct pvsworker
         return *val;
     }
 
-    static int run(void *data)
+    /// Job working off the view cell requests, with the scratch nodes of the worker it runs on.
+    static void run()
     {
-        pvsworker *w = (pvsworker *)data;
+        pvsworker *&w = pvsworkers[inexor::util::JobSystem::running()->worker_index()];
+        if(!w) w = new pvsworker;
         SDL_LockMutex(viewcellmutex);
         while(viewcellrequests.length())
         {
@@ -840,7 +846,6 @@ struct pvsworker
             *req.result = result;
         }
         SDL_UnlockMutex(viewcellmutex);
-        return 0;
     }
 };
 
@@ -864,7 +869,6 @@ struct viewcellnode
 };
 
 VARP(pvsthreads, 0, 0, 16);
-static vector<pvsworker *> pvsworkers;
 
 static volatile bool check_genpvs_progress = false;
 
@@ -1157,7 +1161,8 @@ void genpvs(int *viewcellsize)
     check_genpvs_progress = false;
     SDL_TimerID timer = 0;
     extern SharedVar<int> numcpus;
-    int numthreads = pvsthreads > 0 ? pvsthreads : numcpus;
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    int numthreads = jobs ? min(pvsthreads > 0 ? int(pvsthreads) : int(numcpus), jobs->num_workers()) : 1;
     if(numthreads<=1) 
     {
         pvsworkers.add(new pvsworker);
@@ -1174,11 +1179,9 @@ void genpvs(int *viewcellsize)
         renderprogress(0, "creating threads");
         if(!pvsmutex) pvsmutex = SDL_CreateMutex();
         if(!viewcellmutex) viewcellmutex = SDL_CreateMutex();
-        loopi(numthreads)
-        {
-            pvsworker *w = pvsworkers.add(new pvsworker);
-            w->thread = SDL_CreateThread(pvsworker::run, "pvs worker", w);
-        }
+        loopi(jobs->num_workers() + 1) pvsworkers.add(nullptr);
+        std::vector<inexor::util::JobHandle> runs;
+        loopi(numthreads) runs.push_back(jobs->submit(pvsworker::run, {}, i));
         show_genpvs_progress(0, 0);
         while(!genpvs_canceled)
         {
@@ -1192,7 +1195,7 @@ void genpvs(int *viewcellsize)
         SDL_LockMutex(viewcellmutex);
         viewcellrequests.setsize(0);
         SDL_UnlockMutex(viewcellmutex);
-        loopv(pvsworkers) SDL_WaitThread(pvsworkers[i]->thread, nullptr);
+        for(auto &run : runs) jobs->wait(run);
     }
     pvsworkers.deletecontents();
 
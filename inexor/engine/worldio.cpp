@@ -6,8 +6,12 @@
 #include <math.h>                                     // for floor
 #include <stdio.h>                                    // for remove, rename
 #include <string.h>                            // for memcmp, strcmp, strstr
+#include <zlib.h>                                     // for crc32
 #include <algorithm>                           // for min
+#include <atomic>                                     // for atomic
 #include <memory>                              // for __shared_ptr
+#include <random>                                     // for random_device
+#include <string>                                     // for string
 
 #include "SDL_timer.h"                                // for SDL_GetTicks
 #include "inexor/client/network.hpp"                  // for multiplayer
@@ -45,6 +49,7 @@
 #include "inexor/texture/slot.hpp"                    // for VSlot, vslots
 #include "inexor/texture/texture.hpp"                 // for textureload
 #include "inexor/ui/legacy/menus.hpp"                 // for clearmainmenu
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem
 #include "inexor/util/legacy_time.hpp"                // for totalmillis
 
 using namespace inexor::sound;
@@ -75,6 +80,126 @@ void getmapfilename(const char *fname, const char *realname, char *mapname)
 }
 
 
+/// Keep an uncompressed copy of every loaded map next to it, so the next load needs no inflating.
+VARP(mapcache, 0, 1, 1);
+
+#define MAPCACHE_MAGIC "OMCF"
+#define MAPCACHE_VERSION 1
+
+/// The uncompressed map data follows this header in the cache file.
+/// crc and size are the ones of the .ogz it was made from, as stored in its gzip trailer,
+/// which makes crc the crc32 of the data following the header as well.
+struct mapcacheheader
+{
+    char magic[4];
+    int version;
+    uint crc, size;
+};
+
+static void getmapcachename(const char *ogzname, char *cachename)
+{
+    copystring(cachename, ogzname, MAXSTRLEN);
+    cutogz(cachename);
+    concatstring(cachename, ".mapcache", MAXSTRLEN);
+}
+
+/// Read crc32 and size of the uncompressed data from the gzip trailer, without inflating anything.
+static bool getmaptrailer(const char *ogzname, uint &crc, uint &size)
+{
+    stream *f = openrawfile(ogzname, "rb");
+    if(!f) return false;
+    bool ok = f->seek(-8, SEEK_END);
+    crc = f->getlil<uint>();
+    size = f->getlil<uint>();
+    delete f;
+    return ok;
+}
+
+/// Open the cached uncompressed copy of a map if it is up to date.
+/// @param crc gets the crc of the map, which then does not need to be calculated while reading
+static stream *openmapcache(const char *ogzname, uint &crc)
+{
+    uint size;
+    if(!mapcache || !getmaptrailer(ogzname, crc, size)) return nullptr;
+    string cachename;
+    getmapcachename(ogzname, cachename);
+    stream *f = openrawfile(cachename, "rb");
+    if(!f) return nullptr;
+    mapcacheheader hdr;
+    if(f->read(&hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr.magic, MAPCACHE_MAGIC, sizeof(hdr.magic))) { delete f; return nullptr; }
+    lilswap(&hdr.version, 3);
+    if(hdr.version != MAPCACHE_VERSION || hdr.crc != crc || hdr.size != size) { delete f; return nullptr; }
+    stream *m = openmapped(f, sizeof(hdr));
+    if(!m) { delete f; return nullptr; }
+    if(m->size() != stream::offset(size)) { delete m; return nullptr; }
+    // still far cheaper than inflating, and a damaged cache must not be loaded
+    uint datacrc = crc32(0, nullptr, 0);
+    uchar buf[1<<16];
+    for(size_t n; (n = m->read(buf, sizeof(buf))) > 0;) datacrc = crc32(datacrc, buf, n);
+    if(datacrc != crc || !m->seek(0, SEEK_SET))
+    {
+        Log.world->warn("map cache {} is damaged", cachename);
+        delete m;
+        return nullptr;
+    }
+    return m;
+}
+
+/// Inflate the map once more into its cache file.
+/// The data goes to a temporary file which replaces the cache only once it is complete and checked,
+/// so a partial cache never matches and a cache someone has mapped right now is never rewritten in place.
+/// The temporary file name is unique, since other processes (server instances, a client and a server
+/// sharing the home directory) may write the same cache at the same time.
+static void inflatemapcache(const char *ogzname)
+{
+    uint crc, size;
+    if(!getmaptrailer(ogzname, crc, size)) return;
+    stream *gz = opengzfile(ogzname, "rb");
+    if(!gz) return;
+    string cachename, tmpname;
+    getmapcachename(ogzname, cachename);
+    static std::atomic<uint> tmpcount(0);
+    formatstring(tmpname, "%s.%08x%04x.tmp", cachename, uint(std::random_device()()), tmpcount++&0xFFFF);
+    stream *f = openrawfile(tmpname, "wb");
+    if(!f) { delete gz; return; }
+    mapcacheheader hdr;
+    memcpy(hdr.magic, MAPCACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = MAPCACHE_VERSION;
+    hdr.crc = crc;
+    hdr.size = size;
+    lilswap(&hdr.version, 3);
+    bool ok = f->write(&hdr, sizeof(hdr)) == sizeof(hdr);
+    uint written = 0;
+    uchar buf[1<<16];
+    for(size_t n; ok && (n = gz->read(buf, sizeof(buf))) > 0; written += n) ok = f->write(buf, n) == n;
+    ok = ok && written == size && gz->getcrc() == crc;
+    delete gz;
+    delete f;
+    string tmpfile, cachefile;
+    copystring(tmpfile, findfile(tmpname, "wb"));
+    copystring(cachefile, findfile(cachename, "wb"));
+    if(ok && rename(tmpfile, cachefile))
+    {
+        remove(cachefile); // windows does not replace existing files
+        ok = !rename(tmpfile, cachefile);
+    }
+    if(!ok)
+    {
+        remove(tmpfile);
+        Log.world->warn("could not write map cache {}", cachename);
+    }
+}
+
+/// Write the cache of a map which just got loaded from its .ogz, on the job system if it runs.
+static void writemapcache(const char *ogzname)
+{
+    if(!mapcache) return;
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(!jobs) { inflatemapcache(ogzname); return; }
+    std::string name = ogzname;
+    jobs->submit([name] { inflatemapcache(name.c_str()); });
+}
+
 /// fix entity attributes according to the program version
 /// (the entity format has changed over time)
 /// @param e a reference to an entity
@@ -112,7 +237,10 @@ bool loadents(const char *fname, vector<entity> &ents, uint *crc)
     getmapfilename(fname, nullptr, mapname);
     formatstring(ogzname, "%s/%s.ogz", *mapdir, mapname);
     path(ogzname);
-    stream *f = opengzfile(ogzname, "rb");
+    uint cachedcrc = 0;
+    stream *f = openmapcache(ogzname, cachedcrc);
+    bool cached = f != nullptr;
+    if(!f) f = opengzfile(ogzname, "rb");
     if(!f) return false;
     octaheader hdr;
     if(f->read(&hdr, 7*sizeof(int)) != 7*sizeof(int)) { Log.world->error("map {} has malformatted header", ogzname); delete f; return false; }
@@ -210,12 +338,18 @@ bool loadents(const char *fname, vector<entity> &ents, uint *crc)
     /// calculate CRC32 hash sum from file stream
     if(crc)
     {
-        f->seek(0, SEEK_END);
-        *crc = f->getcrc();
+        if(cached) *crc = cachedcrc;
+        else
+        {
+            f->seek(0, SEEK_END);
+            *crc = f->getcrc();
+        }
     }
     
     delete f;
 
+    if(!cached) writemapcache(ogzname);
+
     return true;
 }
 
@@ -1217,12 +1351,22 @@ void clearmapcrc()
     mapcrc = 0;
 }
 
+/// Inflate maps on a background thread while the octree gets parsed.
+VARP(mapreadahead, 0, 1, 1);
+
 bool load_world(const char *mname, const char *cname)        // still supports all map formats that have existed since the earliest cube betas!
 {
     int loadingstart = SDL_GetTicks();
     setmapfilenames(mname, cname);
-    stream *f = opengzfile(ogzname, "rb");
-    if(!f) { Log.world->error("could not read map {0}", ogzname); return false; }
+    uint cachedcrc = 0;
+    stream *f = openmapcache(ogzname, cachedcrc);
+    bool cached = f != nullptr;
+    if(!f)
+    {
+        f = opengzfile(ogzname, "rb");
+        if(!f) { Log.world->error("could not read map {0}", ogzname); return false; }
+        if(mapreadahead) f = openreadahead(f, 1<<18);
+    }
     octaheader hdr;
     if(f->read(&hdr, 7*sizeof(int)) != 7*sizeof(int)) { Log.world->error("map {0} has malformatted header", ogzname); delete f; return false; }
     lilswap(&hdr.version, 6);
@@ -1427,6 +1571,7 @@ bool load_world(const char *mname, const char *cname)        // still supports a
 
     renderprogress(0, "validating...");
     validatec(worldroot, hdr.worldsize>>1);
+    compactoctree();
 
     if(!failed)
     {
@@ -1454,10 +1599,12 @@ bool load_world(const char *mname, const char *cname)        // still supports a
         if(hdr.version >= 28 && hdr.blendmap) loadblendmap(f, hdr.blendmap);
     }
 
-    mapcrc = f->getcrc();
+    mapcrc = cached ? cachedcrc : f->getcrc();
     delete f;
 
-    Log.world->info("read map {} ({} seconds)", ogzname, ((SDL_GetTicks()-loadingstart)/1000.0f));
+    Log.world->info("read map {} ({} seconds{})", ogzname, ((SDL_GetTicks()-loadingstart)/1000.0f), cached ? ", cached" : "");
+
+    if(!cached && !failed) writemapcache(ogzname);
 
     clearmainmenu();
 
@@ -242,6 +242,7 @@ namespace ai
             int count = 0;
             loopv(players) if(players[i]->ai) think(players[i], ++count == iteration ? true : false);
             if(++iteration > count) iteration = 0;
+            movebots();
         }
     }
 
@@ -1202,7 +1203,7 @@ namespace ai
         return process(d, b) >= 2;
     }
 
-	void timeouts(fpsent *d, aistate &b)
+	void timeouts(fpsent *d)
 	{
         if(d->blocked)
         {
@@ -1265,7 +1266,16 @@ namespace ai
         }
 	}
 
-    void logic(fpsent *d, aistate &b, bool run)
+    /// living bots are moved together once all of them have thought, see movebots()
+    struct aimove
+    {
+        fpsent *d;
+        bool timeouts;
+    };
+    static vector<aimove> aimoves;
+
+    /// @return whether d was queued in aimoves, its turn is then finished by movebots()
+    bool logic(fpsent *d, aistate &b, bool run)
     {
         bool allowmove = canmove(d) && b.type != AI_S_WAIT;
         if(d->state != CS_ALIVE || !allowmove) d->stopmoving();
@@ -1279,11 +1289,10 @@ namespace ai
             if(!intermission)
             {
                 if(d->ragdoll) cleanragdoll(d);
-                moveplayer(d, 10, true);
-                if(allowmove && !b.idle) timeouts(d, b);
-                if(d->quadmillis) entities::checkquad(curtime, d);
-				entities::checkitems(d);
-				if(cmode) cmode->checkitems(d);
+                aimove &m = aimoves.add();
+                m.d = d;
+                m.timeouts = allowmove && !b.idle;
+                return true;
             }
         }
         else if(d->state == CS_DEAD)
@@ -1296,6 +1305,32 @@ namespace ai
             }
         }
         d->attacking = d->jumping = false;
+        return false;
+    }
+
+    static void endthink(fpsent *d)
+    {
+        if(d->ai->trywipe) d->ai->wipe();
+        d->ai->lastrun = lastmillis;
+    }
+
+    void movebots()
+    {
+        static vector<physent *> movers;
+        movers.setsize(0);
+        loopv(aimoves) movers.add(aimoves[i].d);
+        moveplayers(movers.getbuf(), movers.length(), 10, true);
+        loopv(aimoves)
+        {
+            fpsent *d = aimoves[i].d;
+            if(aimoves[i].timeouts) timeouts(d);
+            if(d->quadmillis) entities::checkquad(curtime, d);
+            entities::checkitems(d);
+            if(cmode) cmode->checkitems(d);
+            d->attacking = d->jumping = false;
+            endthink(d);
+        }
+        aimoves.setsize(0);
     }
 
 	void avoid()
@@ -1360,11 +1395,10 @@ namespace ai
                     }
                 }
             }
-            logic(d, c, run);
+            if(logic(d, c, run)) return;
             break;
         }
-        if(d->ai->trywipe) d->ai->wipe();
-        d->ai->lastrun = lastmillis;
+        endthink(d);
     }
 
     void drawroute(fpsent *d, float amt = 1.f)
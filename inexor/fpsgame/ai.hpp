@@ -288,6 +288,7 @@ namespace ai
     extern void update();
     extern void avoid();
     extern void think(fpsent *d, bool run);
+    extern void movebots();
 
     extern bool badhealth(fpsent *d);
     extern bool checkothers(vector<int> &targets, fpsent *d = nullptr, int state = -1, int targtype = -1, int target = -1, bool teams = false, int *members = nullptr);
@@ -58,6 +58,7 @@
 #include "inexor/network/legacy/crypto.hpp"               // for hashpassword
 #include "inexor/network/legacy/cube_network.hpp"         // for getint, get...
 #include "inexor/network/legacy/game_types.hpp"           // for ::N_EDITF
+#include "inexor/network/legacy/position_codec.hpp"       // for positionstate
 #include "inexor/physics/physics.hpp"                     // for vecfromyawp...
 #include "inexor/shared/command.hpp"                      // for intret, result
 #include "inexor/shared/cube_endian.hpp"                  // for lilswap
@@ -234,6 +235,12 @@ namespace game
     /// push dead bodies (?)
     VARP(deadpush, 1, 2, 20);
 
+    /// Accept delta compressed positions if the server offers them (see position_codec.hpp).
+    VARP(poscodec, 0, 1, 1);
+    bool poscodecoffered = false;
+    int posframe = 0, posackframe = -1, lastposack = -1;
+    vector<positionhistory> poshistory;
+
     /// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
     /// team, name and playermodel settings
 
@@ -1017,6 +1024,10 @@ namespace game
         player1->state = CS_ALIVE;
         player1->privilege = PRIV_NONE;
         sendcrc = senditemstoserver = false;
+        poscodecoffered = false;
+        posframe = 0;
+        posackframe = lastposack = -1;
+        poshistory.shrink(0);
         demoplayback = false;
         gamepaused = false;
         gamespeed = 100;
@@ -1165,6 +1176,12 @@ namespace game
             messagereliable = false;
             messagecn = -1;
         }
+        if(posackframe != lastposack)
+        {
+            putint(p, N_POSACK);
+            putuint(p, posackframe&0xFF);
+            lastposack = posackframe;
+        }
         if(totalmillis-lastping>250)
         {
             putint(p, N_PING);
@@ -1233,6 +1250,73 @@ namespace game
         }
     }
 
+    /// apply a received position of another client
+    static void setposition(const positionstate &s)
+    {
+        vec o, vel, falling;
+        float yaw, pitch, roll;
+        loopk(3) o[k] = s[positionstate::O_X+k]/DMF;
+        int dir = s[positionstate::DIR];
+        yaw = dir%360;
+        pitch = clamp(dir/360, 0, 180)-90;
+        roll = clamp(s[positionstate::ROLL], 0, 180)-90;
+        int mag = s[positionstate::VEL];
+        dir = s[positionstate::VELDIR];
+        vecfromyawpitch(dir%360, clamp(dir/360, 0, 180)-90, 1, 0, vel);
+        vel.mul(mag/DVELF);
+        int flags = s[positionstate::FLAGS];
+        if(flags&(1<<4))
+        {
+            mag = s[positionstate::FALL];
+            if(flags&(1<<6))
+            {
+                dir = s[positionstate::FALLDIR];
+                vecfromyawpitch(dir%360, clamp(dir/360, 0, 180)-90, 1, 0, falling);
+            }
+            else falling = vec(0, 0, -1);
+            falling.mul(mag/DVELF);
+        }
+        else falling = vec(0, 0, 0);
+        int physstate = s[positionstate::PHYSSTATE];
+        int seqcolor = (physstate>>3)&1;
+        fpsent *d = getclient(s.cn);
+        if(!d || d->lifesequence < 0 || seqcolor!=(d->lifesequence&1) || d->state==CS_DEAD) return;
+        float oldyaw = d->yaw, oldpitch = d->pitch, oldroll = d->roll;
+        d->yaw = yaw;
+        d->pitch = pitch;
+        d->roll = roll;
+        d->move = (physstate>>4)&2 ? -1 : (physstate>>4)&1;
+        d->strafe = (physstate>>6)&2 ? -1 : (physstate>>6)&1;
+        vec oldpos(d->o);
+        d->o = o;
+        d->o.z += d->eyeheight;
+        d->vel = vel;
+        d->falling = falling;
+        d->physstate = physstate&7;
+        updatephysstate(d);
+        updatepos(d);
+        if(smoothmove && d->smoothmillis>=0 && oldpos.dist(d->o) < smoothdist)
+        {
+            d->newpos = d->o;
+            d->newyaw = d->yaw;
+            d->newpitch = d->pitch;
+            d->newroll = d->roll;
+            d->o = oldpos;
+            d->yaw = oldyaw;
+            d->pitch = oldpitch;
+            d->roll = oldroll;
+            (d->deltapos = oldpos).sub(d->newpos);
+            d->deltayaw = oldyaw - d->newyaw;
+            if(d->deltayaw > 180) d->deltayaw -= 360;
+            else if(d->deltayaw < -180) d->deltayaw += 360;
+            d->deltapitch = oldpitch - d->newpitch;
+            d->deltaroll = oldroll - d->newroll;
+            d->smoothmillis = lastmillis;
+        }
+        else d->smoothmillis = 0;
+        if(d->state==CS_LAGGED || d->state==CS_SPAWNING) d->state = CS_ALIVE;
+    }
+
 	// parse player positions from network packages
     void parsepositions(ucharbuf &p)
     {
@@ -1242,77 +1326,24 @@ namespace game
             case N_DEMOPACKET: break;
             case N_POS:                        // position of another client
             {
-                int cn = getuint(p), physstate = p.get(), flags = getuint(p);
-                vec o, vel, falling;
-                float yaw, pitch, roll;
-                loopk(3)
-                {
-                    int n = p.get(); 
-					n |= p.get()<<8; 
-					if(flags&(1<<k)) 
-					{ 
-						n |= p.get()<<16; 
-                        if(n&0x800000) n |= -1<<24;
-					}
-                    o[k] = n/DMF;
-                }
-                int dir = p.get(); dir |= p.get()<<8;
-                yaw = dir%360;
-                pitch = clamp(dir/360, 0, 180)-90;
-                roll = clamp(int(p.get()), 0, 180)-90;
-                int mag = p.get(); if(flags&(1<<3)) mag |= p.get()<<8;
-                dir = p.get(); dir |= p.get()<<8;
-                vecfromyawpitch(dir%360, clamp(dir/360, 0, 180)-90, 1, 0, vel);
-                vel.mul(mag/DVELF);
-                if(flags&(1<<4))
-                {
-                    mag = p.get(); if(flags&(1<<5)) mag |= p.get()<<8;
-                    if(flags&(1<<6))
-                    {
-                        dir = p.get(); dir |= p.get()<<8;
-                        vecfromyawpitch(dir%360, clamp(dir/360, 0, 180)-90, 1, 0, falling);
-                    }
-                    else falling = vec(0, 0, -1);
-                    falling.mul(mag/DVELF);
-                }
-                else falling = vec(0, 0, 0);
-                int seqcolor = (physstate>>3)&1;
-                fpsent *d = getclient(cn);
-                if(!d || d->lifesequence < 0 || seqcolor!=(d->lifesequence&1) || d->state==CS_DEAD) continue;
-                float oldyaw = d->yaw, oldpitch = d->pitch, oldroll = d->roll;
-                d->yaw = yaw;
-                d->pitch = pitch;
-                d->roll = roll;
-                d->move = (physstate>>4)&2 ? -1 : (physstate>>4)&1;
-                d->strafe = (physstate>>6)&2 ? -1 : (physstate>>6)&1;
-                vec oldpos(d->o);
-                d->o = o;
-                d->o.z += d->eyeheight;
-                d->vel = vel;
-                d->falling = falling;
-                d->physstate = physstate&7;
-                updatephysstate(d);
-                updatepos(d);
-                if(smoothmove && d->smoothmillis>=0 && oldpos.dist(d->o) < smoothdist)
-                {
-                    d->newpos = d->o;
-                    d->newyaw = d->yaw;
-                    d->newpitch = d->pitch;
-                    d->newroll = d->roll;
-                    d->o = oldpos;
-                    d->yaw = oldyaw;
-                    d->pitch = oldpitch;
-                    d->roll = oldroll;
-                    (d->deltapos = oldpos).sub(d->newpos);
-                    d->deltayaw = oldyaw - d->newyaw;
-                    if(d->deltayaw > 180) d->deltayaw -= 360;
-                    else if(d->deltayaw < -180) d->deltayaw += 360;
-                    d->deltapitch = oldpitch - d->newpitch;
-                    d->deltaroll = oldroll - d->newroll;
-                    d->smoothmillis = lastmillis;
-                }
-                else d->smoothmillis = 0;
-                if(d->state==CS_LAGGED || d->state==CS_SPAWNING) d->state = CS_ALIVE;
+                positionstate s;
+                getposition(p, s);
+                setposition(s);
+                break;
+            }
+
+            case N_POSFRAME:
+                posframe = unwrapframe(getuint(p)&0xFF, posframe + 0x7F);
+                if(posframe > posackframe) posackframe = posframe;
+                break;
+
+            case N_POSDELTA:                   // delta compressed position of another client
+            {
+                positionstate s;
+                s.cn = getuint(p);
+                if(s.cn < 0 || s.cn >= 2*MAXCLIENTS) { neterr("cn"); return; }
+                while(poshistory.length() <= s.cn) poshistory.add();
+                if(getpositiondelta(p, poshistory[s.cn], posframe, s)) setposition(s);
                 break;
             }
 
@@ -1412,6 +1443,12 @@ namespace game
             {
                 connected = true;
                 notifywelcome();
+                if(poscodecoffered)
+                {
+                    defformatstring(accept, "poscodec %d", POSCODEC_VERSION);
+                    addmsg(N_SERVCMD, "rs", accept);
+                    poscodecoffered = false;
+                }
                 break;
             }
 
@@ -2132,8 +2169,12 @@ namespace game
             }
 
             case N_SERVCMD:
+            {
                 getstring(text, p);
+                int version = 0;
+                if(sscanf(text, "poscodec %d", &version) == 1) poscodecoffered = poscodec && version == POSCODEC_VERSION;
                 break;
+            }
 
             default:
                 if(cmode && cmode->parse_network_message(type, p)) return;
@@ -2235,13 +2276,21 @@ namespace game
     }
     ICOMMAND(cleardemos, "i", (int *val), cleardemos(*val));
 
-    void getdemo(int i)
+    void getdemo(int i, int from)
     {
         if(i<=0) Log.std->info("getting demo...");
         else Log.std->info("getting demo {0}...", i);
-        addmsg(N_GETDEMO, "ri", i);
+        if(from > 0) addmsg(N_GETDEMOFROM, "rii", i, from*1000);
+        else addmsg(N_GETDEMO, "ri", i);
+    }
+    ICOMMAND(getdemo, "ii", (int *val, int *from), getdemo(*val, *from));
+
+    void seekdemo(int secs)
+    {
+        if(player1->privilege<PRIV_MASTER || !m_demo) return;
+        addmsg(N_SEEKDEMO, "ri", secs*1000);
     }
-    ICOMMAND(getdemo, "i", (int *val), getdemo(*val));
+    ICOMMAND(seekdemo, "i", (int *secs), seekdemo(*secs));
 
     void listdemos()
     {
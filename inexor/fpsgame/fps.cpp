@@ -255,19 +255,19 @@ namespace game
 	/// use latency and assume player movement to
 	/// predict a player's new position. Improves visual appearance
 	/// of his movement tremendous - even under lag
+    /// startprediction() resets d to the last position received, then d gets moved
+    /// and finishprediction() blends it into the position it is displayed at.
     /// @see moveplayer
-    void predictplayer(fpsent *d, bool move)
+    void startprediction(fpsent *d)
     {
         d->o = d->newpos;
         d->yaw = d->newyaw;
         d->pitch = d->newpitch;
         d->roll = d->newroll;
+    }
 
-        if(move)
-        {
-            moveplayer(d, 1, false);
-            d->newpos = d->o;
-        }
+    void finishprediction(fpsent *d)
+    {
         float k = 1.0f - float(lastmillis - d->smoothmillis)/smoothmove;
         if(k>0)
         {
@@ -284,9 +284,13 @@ namespace game
 	/// handle ragdoll, check for lag
     /// @see updateworld
     /// @see moveragdoll
-    /// @see predictplayer
+    /// @see startprediction
     void otherplayers(int curtime)
     {
+        static vector<physent *> movers;
+        static vector<fpsent *> predicted;
+        movers.setsize(0);
+        predicted.setsize(0);
         loopv(players)
         {
             fpsent *d = players[i];
@@ -308,11 +312,23 @@ namespace game
             }
             if(d->state==CS_ALIVE || d->state==CS_EDITING)
             {
-                if(smoothmove && d->smoothmillis>0) predictplayer(d, true);
-                else moveplayer(d, 1, false);
+                if(smoothmove && d->smoothmillis>0)
+                {
+                    startprediction(d);
+                    predicted.add(d);
+                }
+                movers.add(d);
             }
             else if(d->state==CS_DEAD && !d->ragdoll && lastmillis-d->lastpain<2000) moveplayer(d, 1, true);
         }
+        // all remote players are moved together on the job system
+        moveplayers(movers.getbuf(), movers.length(), 1, false);
+        loopv(predicted)
+        {
+            fpsent *d = predicted[i];
+            d->newpos = d->o;
+            finishprediction(d);
+        }
     }
 
     /// called in game loop to the update game world
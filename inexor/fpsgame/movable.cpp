@@ -158,6 +158,8 @@ namespace game
     void updatemovables(int curtime)
     {
         if(!curtime) return;
+        static vector<physent *> movers;
+        movers.setsize(0);
         loopv(movables)
         {
             movable *m = movables[i];
@@ -184,9 +186,11 @@ namespace game
             else if(m->maymove() || (m->stacked && (m->stacked->state!=CS_ALIVE || m->stackpos != m->stacked->o)))
             {
                 if(physsteps > 0) m->stacked = nullptr;
-                moveplayer(m, 1, true);
+                movers.add(m);
             }
         }
+        // falling and pushed movables move together once the platforms carried theirs along
+        moveplayers(movers.getbuf(), movers.length(), 1, true);
     }
 
     void rendermovables()
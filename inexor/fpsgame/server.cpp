@@ -24,6 +24,7 @@
 #include "inexor/server/demos.hpp"                        // for enddemorecord
 #include "inexor/server/extinfo.hpp"                      // for extserverin...
 #include "inexor/server/game_management.hpp"              // for pausegame
+#include "inexor/server/hitverify.hpp"                    // for verifyhits
 #include "inexor/server/gamemode/bomb_server.hpp"         // for bombservermode
 #include "inexor/server/gamemode/capture_server.hpp"      // for captureserv...
 #include "inexor/server/gamemode/collect_server.hpp"      // for collectserv...
@@ -32,6 +33,8 @@
 #include "inexor/server/gamemode/hideandseek_server.hpp"  // for hideandseek...
 #include "inexor/server/network.hpp"                      // for sendserveri...
 #include "inexor/server/network_send.hpp"                 // for sendf, send...
+#include "inexor/server/position_compression.hpp"         // for putcompressedposition
+#include "inexor/server/relevance.hpp"                    // for checkrelevance
 #include "inexor/shared/command.hpp"                      // for explodelist
 #include "inexor/shared/cube_endian.hpp"                  // for lilswap
 #include "inexor/shared/cube_formatting.hpp"              // for formatstring
@@ -533,10 +536,10 @@ extern int getservermtu();
         }
 
         uchar operator[](int msg) const { return msg >= 0 && msg < NUMMSG ? msgmask[msg] : 0; }
-    } msgfilter(-1, N_CONNECT, N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPCHANGE, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_TEAMINFO, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_BASESCORE, N_BASEINFO, N_BASEREGEN, N_ANNOUNCE, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_INVISFLAG, N_CLIENT,  N_INITAI, N_EXPIRETOKENS, N_DROPTOKENS, N_STEALTOKENS, N_DEMOPACKET,
+    } msgfilter(-1, N_CONNECT, N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPCHANGE, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_TEAMINFO, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_BASESCORE, N_BASEINFO, N_BASEREGEN, N_ANNOUNCE, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_INVISFLAG, N_CLIENT,  N_INITAI, N_EXPIRETOKENS, N_DROPTOKENS, N_STEALTOKENS, N_DEMOPACKET, N_POSFRAME, N_POSDELTA,
                 -2, N_REMIP, N_NEWMAP, N_GETMAP, N_SENDMAP, N_CLIPBOARD,
                 -3, N_EDITENT, N_EDITF, N_EDITT, N_EDITM, N_FLIP, N_COPY, N_PASTE, N_ROTATE, N_REPLACE, N_DELCUBE, N_EDITVAR, N_EDITVSLOT, N_UNDO, N_REDO,
-                -4, N_POS, NUMMSG);
+                -4, N_POS, N_POSACK, NUMMSG);
 
     int checktype(int type, clientinfo *ci)
     {
@@ -566,34 +569,55 @@ extern int getservermtu();
         return type;
     }
     // worldstate
+
+    /// One immutable frame of relayed positions/messages per tick.
+    /// Every chunk gets appended twice, so the window a client receives (everything except its own
+    /// slice) is always contiguous and can be handed to enet without copying it per recipient.
+    /// Frames are reference counted by the packets pointing into them and recycled afterwards.
     struct worldstate
     {
         int uses, len;
+        int index; ///< in worldstates while referenced, so it is removed in O(1)
         uchar *data;
 
-        worldstate() : uses(0), len(0), data(nullptr) {}
+        worldstate() : uses(0), len(0), index(-1), data(nullptr) {}
+        ~worldstate() { cleanup(); }
 
-        void setup(int n) { len = n; data = new uchar[n]; }
+        void setup(int n)
+        {
+            if(n > len) { DELETEA(data); data = new uchar[n]; len = n; }
+        }
         void cleanup() { DELETEA(data); len = 0; }
-        bool contains(const uchar *p) const { return p >= data && p < &data[len]; }
     };
-    vector<worldstate> worldstates;
+    /// Frames still referenced by queued packets (some may be reclaimed later) and recycled ones.
+    vector<worldstate *> worldstates, freeworldstates;
     bool reliablemessages = false;
 
+    /// Keep at most this many spare frames around for reuse.
+    static constexpr int MAXFREEWORLDSTATES = 8;
+
+    static worldstate *newworldstate(int len)
+    {
+        worldstate *ws = freeworldstates.empty() ? new worldstate : freeworldstates.pop();
+        ws->setup(len);
+        ws->uses = 0;
+        return ws;
+    }
+
+    static void freeworldstate(worldstate *ws)
+    {
+        if(freeworldstates.length() < MAXFREEWORLDSTATES) freeworldstates.add(ws);
+        else delete ws;
+    }
+
     void cleanworldstate(ENetPacket *packet)
     {
-        loopv(worldstates)
-        {
-            worldstate &ws = worldstates[i];
-            if(!ws.contains(packet->data)) continue;
-            ws.uses--;
-            if(ws.uses <= 0)
-            {
-                ws.cleanup();
-                worldstates.removeunordered(i);
-            }
-            break;
-        }
+        worldstate *ws = (worldstate *)packet->userData;
+        if(!ws || --ws->uses > 0) return;
+        worldstates.removeunordered(ws->index);
+        if(worldstates.inrange(ws->index)) worldstates[ws->index]->index = ws->index;
+        ws->index = -1;
+        freeworldstate(ws);
     }
 
     void flushclientposition(clientinfo &ci)
@@ -605,23 +629,31 @@ extern int getservermtu();
         sendpacket(-1, 0, p.finalize(), ci.ownernum);
     }
 
-    static void sendpositions(worldstate &ws, ucharbuf &wsbuf)
+    /// Flush the current chunk of the worldstate to all clients.
+    /// Each client gets a view starting right behind its own slice, which wraps into the mirrored
+    /// second half of the chunk, so nobody receives its own data echoed back.
+    static void sendworldstate(worldstate &ws, ucharbuf &wsbuf, int chan, int flags)
     {
         if(wsbuf.empty()) return;
         int wslen = wsbuf.length();
-        recordpacket(0, wsbuf.buf, wslen);
+        recordpacket(chan, wsbuf.buf, wslen);
         wsbuf.put(wsbuf.buf, wslen);
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
-            if(ci.state.aitype != AI_NONE) continue;
+            if(ci.state.aitype != AI_NONE || (chan == 0 && ci.poscodec)) continue;
             uchar *data = wsbuf.buf;
             int size = wslen;
             if(ci.wsdata >= wsbuf.buf) { data = ci.wsdata + ci.wslen; size -= ci.wslen; }
             if(size <= 0) continue;
-            ENetPacket *packet = enet_packet_create(data, size, ENET_PACKET_FLAG_NO_ALLOCATE);
-            sendpacket(ci.clientnum, 0, packet);
-            if(packet->referenceCount) { ws.uses++; packet->freeCallback = cleanworldstate; }
+            ENetPacket *packet = enet_packet_create(data, size, flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+            sendpacket(ci.clientnum, chan, packet);
+            if(packet->referenceCount)
+            {
+                ws.uses++;
+                packet->userData = &ws;
+                packet->freeCallback = cleanworldstate;
+            }
             else enet_packet_destroy(packet);
         }
         wsbuf.offset(wsbuf.length());
@@ -630,7 +662,7 @@ extern int getservermtu();
     static inline void addposition(worldstate &ws, ucharbuf &wsbuf, int mtu, clientinfo &bi, clientinfo &ci)
     {
         if(bi.position.empty()) return;
-        if(wsbuf.length() + bi.position.length() > mtu) sendpositions(ws, wsbuf);
+        if(wsbuf.length() + bi.position.length() > mtu) sendworldstate(ws, wsbuf, 0, 0);
         int offset = wsbuf.length();
         wsbuf.put(bi.position.getbuf(), bi.position.length());
         bi.position.setsize(0);
@@ -639,32 +671,66 @@ extern int getservermtu();
         else ci.wslen += len;
     }
 
-    static void sendmessages(worldstate &ws, ucharbuf &wsbuf)
+    static bool flushclientpositions(clientinfo &ci, vector<uchar> &buf)
     {
-        if(wsbuf.empty()) return;
-        int wslen = wsbuf.length();
-        recordpacket(1, wsbuf.buf, wslen);
-        wsbuf.put(wsbuf.buf, wslen);
+        if(buf.empty()) return false;
+        packetbuf p(buf.length(), 0);
+        p.put(buf.getbuf(), buf.length());
+        buf.setsize(0);
+        sendpacket(ci.clientnum, 0, p.finalize());
+        return p.packet->referenceCount > 0;
+    }
+
+    /// Send a client its own set of positions instead of a view into the shared worldstate:
+    /// filtered through the relevance filter and/or delta compressed.
+    /// @return whether any packet got queued.
+    static bool sendclientpositions(clientinfo &ci, int mtu)
+    {
+        static vector<uchar> buf;
+        bool sent = false;
+        loopv(clients)
+        {
+            clientinfo &bi = *clients[i];
+            if(bi.position.empty() || bi.clientnum == ci.clientnum || bi.ownernum == ci.clientnum) continue;
+            if(relevancerange && !checkrelevance(ci, bi, totalmillis)) continue;
+            int len = ci.poscodec ? MAXPOSDELTALEN : bi.position.length();
+            if(buf.length() + len > mtu) sent |= flushclientpositions(ci, buf);
+            if(ci.poscodec) putcompressedposition(buf, ci, bi);
+            else buf.put(bi.position.getbuf(), bi.position.length());
+        }
+        sent |= flushclientpositions(ci, buf);
+        return sent;
+    }
+
+    /// Send the positions of this tick to everyone who does not use the shared worldstate.
+    /// If relevancerange is set that is everyone, so we need to record the positions for the demo ourselves.
+    static bool sendclientpositions(int mtu)
+    {
+        bool sent = false;
+        if(relevancerange)
+        {
+            static vector<uchar> buf;
+            loopv(clients) buf.put(clients[i]->position.getbuf(), clients[i]->position.length());
+            if(buf.empty()) return false;
+            recordpacket(0, buf.getbuf(), buf.length());
+            buf.setsize(0);
+        }
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
-            if(ci.state.aitype != AI_NONE) continue;
-            uchar *data = wsbuf.buf;
-            int size = wslen;
-            if(ci.wsdata >= wsbuf.buf) { data = ci.wsdata + ci.wslen; size -= ci.wslen; }
-            if(size <= 0) continue;
-            ENetPacket *packet = enet_packet_create(data, size, (reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0) | ENET_PACKET_FLAG_NO_ALLOCATE);
-            sendpacket(ci.clientnum, 1, packet);
-            if(packet->referenceCount) { ws.uses++; packet->freeCallback = cleanworldstate; }
-            else enet_packet_destroy(packet);
+            if(ci.state.aitype != AI_NONE || (!relevancerange && !ci.poscodec)) continue;
+            sent |= sendclientpositions(ci, mtu);
         }
-        wsbuf.offset(wsbuf.length());
+        if(relevancerange) loopv(clients) clients[i]->position.setsize(0);
+        return sent;
     }
 
+    static inline int messageflags() { return reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0; }
+
     static inline void addmessages(worldstate &ws, ucharbuf &wsbuf, int mtu, clientinfo &bi, clientinfo &ci)
     {
         if(bi.messages.empty()) return;
-        if(wsbuf.length() + 10 + bi.messages.length() > mtu) sendmessages(ws, wsbuf);
+        if(wsbuf.length() + 10 + bi.messages.length() > mtu) sendworldstate(ws, wsbuf, 1, messageflags());
         int offset = wsbuf.length();
         putint(wsbuf, N_CLIENT);
         putint(wsbuf, bi.clientnum);
@@ -692,19 +758,22 @@ extern int getservermtu();
             reliablemessages = false;
             return false;
         }
-        worldstate &ws = worldstates.add();
-        ws.setup(2*wsmax);
+        worldstate &ws = *newworldstate(2*wsmax);
         int mtu = getservermtu() - 100;
         if(mtu <= 0) mtu = ws.len;
         ucharbuf wsbuf(ws.data, ws.len);
-        loopv(clients)
+        bool flush = sendclientpositions(mtu);
+        if(!relevancerange)
         {
-            clientinfo &ci = *clients[i];
-            if(ci.state.aitype != AI_NONE) continue;
-            addposition(ws, wsbuf, mtu, ci, ci);
-            loopvj(ci.bots) addposition(ws, wsbuf, mtu, *ci.bots[j], ci);
+            loopv(clients)
+            {
+                clientinfo &ci = *clients[i];
+                if(ci.state.aitype != AI_NONE) continue;
+                addposition(ws, wsbuf, mtu, ci, ci);
+                loopvj(ci.bots) addposition(ws, wsbuf, mtu, *ci.bots[j], ci);
+            }
+            sendworldstate(ws, wsbuf, 0, 0);
         }
-        sendpositions(ws, wsbuf);
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
@@ -712,12 +781,16 @@ extern int getservermtu();
             addmessages(ws, wsbuf, mtu, ci, ci);
             loopvj(ci.bots) addmessages(ws, wsbuf, mtu, *ci.bots[j], ci);
         }
-        sendmessages(ws, wsbuf);
+        sendworldstate(ws, wsbuf, 1, messageflags());
         reliablemessages = false;
-        if(ws.uses) return true;
-        ws.cleanup();
-        worldstates.drop();
-        return false;
+        if(ws.uses)
+        {
+            ws.index = worldstates.length();
+            worldstates.add(&ws);
+            return true;
+        }
+        freeworldstate(&ws);
+        return flush;
     }
 
     bool sendpackets(bool force)
@@ -1279,18 +1352,16 @@ extern int getservermtu();
         if (m_lms) checklms();
     }
 
-    void suicideevent::process(clientinfo *ci)
-    {
-        suicide(ci);
-    }
-
-    void explodeevent::process(clientinfo *ci)
+    static void processexplode(clientinfo *ci, gameevent &e)
     {
         gamestate &gs = ci->state;
+        int gun = e.gun, id = e.id;
+        projectilelaunch launch;
         switch(gun)
         {
             case GUN_RL:
-                if(!gs.rockets.remove(id)) return;
+                if(!gs.rockets.remove(id, &launch)) return;
+                verifyexplosion(ci, e, launch);
                 break;
 
             case GUN_GL:
@@ -1309,14 +1380,14 @@ extern int getservermtu();
         }
         sendf(-1, 1, "ri4x", N_EXPLODEFX, ci->clientnum, gun, id, ci->ownernum);
         if(gun==GUN_BOMB && ci->state.ammo[GUN_BOMB] < itemstats[GUN_BOMB].max) ci->state.ammo[GUN_BOMB]++; // add a bomb if the bomb explodes
-        loopv(hits)
+        loopi(e.numhits)
         {
-            hitinfo &h = hits[i];
+            hitinfo &h = ci->events.hit(e, i);
             clientinfo *target = get_client_info(h.target);
             if(!target || target->state.state!=CS_ALIVE || h.lifesequence!=target->state.lifesequence || h.dist<0 || h.dist>guns[gun].exprad) continue;
 
             bool dup = false;
-            loopj(i) if(hits[j].target==h.target) { dup = true; break; }
+            loopj(i) if(ci->events.hit(e, j).target==h.target) { dup = true; break; }
             if(dup) continue;
 
             int damage = guns[gun].damage;
@@ -1327,9 +1398,11 @@ extern int getservermtu();
         }
     }
 
-    void shotevent::process(clientinfo *ci)
+    static void processshot(clientinfo *ci, gameevent &e)
     {
         gamestate &gs = ci->state;
+        int millis = e.millis, gun = e.gun, id = e.id;
+        const vec &from = e.from, &to = e.to;
         int wait = millis - gs.lastshot;
         if(gun!=GUN_SPLINTER &&
           (!gs.isalive(gamemillis) ||
@@ -1347,15 +1420,16 @@ extern int getservermtu();
         gs.shotdamage += guns[gun].damage*(gs.quadmillis ? 4 : 1)*guns[gun].rays;
         switch(gun)
         {
-            case GUN_RL: gs.rockets.add(id); break;
+            case GUN_RL: gs.rockets.add(id, {from, to, millis}); break;
             case GUN_GL: gs.grenades.add(id); break;
             case GUN_BOMB: gs.bombs.add(id); break;
             default:
             {
+                verifyhits(ci, e);
                 int totalrays = 0, maxrays = guns[gun].rays;
-                loopv(hits)
+                loopi(e.numhits)
                 {
-                    hitinfo &h = hits[i];
+                    hitinfo &h = ci->events.hit(e, i);
                     clientinfo *target = get_client_info(h.target);
                     if(!target || target->state.state!=CS_ALIVE || h.lifesequence!=target->state.lifesequence || h.rays<1 || h.dist > guns[gun].range + 1) continue;
 
@@ -1370,42 +1444,55 @@ extern int getservermtu();
         }
     }
 
-    void pickupevent::process(clientinfo *ci)
+    static void processpickup(clientinfo *ci, gameevent &e)
     {
         gamestate &gs = ci->state;
         if(!gs.isalive(gamemillis)) return;
-        pickup(ent, ci->clientnum);
-    }
-
-    bool gameevent::flush(clientinfo *ci, int fmillis)
-    {
-        process(ci);
-        return true;
+        pickup(e.id, ci->clientnum);
     }
 
-    bool timedevent::flush(clientinfo *ci, int fmillis)
+    /// Process the event if it is due.
+    /// @return false if it has to wait for later.
+    static bool flushevent(clientinfo *ci, gameevent &e, int fmillis)
     {
-        if(millis > fmillis) return false;
-        else if(millis >= ci->lastevent)
+        if(e.timed())
+        {
+            if(e.millis > fmillis) return false;
+            if(e.millis < ci->lastevent) return true;
+            ci->lastevent = e.millis;
+        }
+        switch(e.type)
         {
-            ci->lastevent = millis;
-            process(ci);
+            case EV_SHOT: processshot(ci, e); break;
+            case EV_EXPLODE: processexplode(ci, e); break;
+            case EV_SUICIDE: suicide(ci); break;
+            case EV_PICKUP: processpickup(ci, e); break;
         }
         return true;
     }
 
-    void clearevent(clientinfo *ci)
+    void flushevents(clientinfo *ci, int millis)
     {
-        delete ci->events.remove(0);
+        while(!ci->events.empty())
+        {
+            if(flushevent(ci, ci->events.first(), millis)) ci->events.removefirst();
+            else break;
+        }
     }
 
-    void flushevents(clientinfo *ci, int millis)
+    /// Warn about clients whose events did not fit into their queue, at most every ten seconds.
+    static void reportdroppedevents()
     {
-        while(ci->events.length())
+        static int lastreport = 0;
+        if(lastreport && totalmillis-lastreport < 10000) return;
+        loopv(clients)
         {
-            gameevent *ev = ci->events[0];
-            if(ev->flush(ci, millis)) clearevent(ci);
-            else break;
+            gameeventqueue &q = clients[i]->events;
+            if(!q.droppedevents && !q.droppedhits) continue;
+            Log.std->warn("client {} ({}) sent more events than its queue holds: dropped {} events and {} hits",
+                          clients[i]->clientnum, clients[i]->name, q.droppedevents, q.droppedhits);
+            q.droppedevents = q.droppedhits = 0;
+            lastreport = totalmillis;
         }
     }
 
@@ -1417,26 +1504,13 @@ extern int getservermtu();
             if(curtime>0 && ci->state.quadmillis) ci->state.quadmillis = max(ci->state.quadmillis-curtime, 0);
             flushevents(ci, gamemillis);
         }
+        reportdroppedevents();
+        hitverifytick();
     }
 
     void cleartimedevents(clientinfo *ci)
     {
-        int keep = 0;
-        loopv(ci->events)
-        {
-            if(ci->events[i]->keepable())
-            {
-                if(keep < i)
-                {
-                    for(int j = keep; j < i; j++) delete ci->events[j];
-                    ci->events.remove(keep, i - keep);
-                    i = keep;
-                }
-                keep = i+1;
-                continue;
-            }
-        }
-        while(ci->events.length() > keep) delete ci->events.pop();
+        ci->events.clearunkept();
         ci->timesync = false;
     }
 
@@ -1647,6 +1721,23 @@ extern int getservermtu();
     }
 
 
+    /// Read the hits of a shot or explosion into the event queue of ci, or skip them if ci is nullptr.
+    static void gethits(packetbuf &p, clientinfo *ci, gameevent &e)
+    {
+        int hits = getint(p);
+        loopk(hits)
+        {
+            if(p.overread()) break;
+            hitinfo skipped, *hit = ci ? ci->events.addhit(e) : nullptr;
+            if(!hit) hit = &skipped;
+            hit->target = getint(p);
+            hit->lifesequence = getint(p);
+            hit->dist = getint(p)/DMF;
+            hit->rays = getint(p);
+            loopk(3) hit->dir[k] = getint(p)/DNF;
+        }
+    }
+
     void parsepacket(int sender, int chan, packetbuf &p)     // has to parse exactly each byte of the packet
     {
         if(sender<0 || p.packet->flags&ENET_PACKET_FLAG_UNSEQUENCED || chan > 2) return;
@@ -1715,26 +1806,15 @@ extern int getservermtu();
         {
             case N_POS:
             {
-                int pcn = getuint(p); 
-                p.get(); 
-                uint flags = getuint(p);
-                clientinfo *cp = get_client_info(pcn);
-                if(cp && pcn != sender && cp->ownernum != sender) cp = nullptr;
+                positionstate ps;
+                getposition(p, ps);
+                clientinfo *cp = get_client_info(ps.cn);
+                if(cp && ps.cn != sender && cp->ownernum != sender) cp = nullptr;
                 vec pos;
-                loopk(3)
-                {
-                    int n = p.get(); n |= p.get()<<8; if(flags&(1<<k)) { n |= p.get()<<16; if(n&0x800000) n |= -1<<24; }
-                    pos[k] = n/DMF;
-                }
-                loopk(3) p.get();
-                int mag = p.get(); if(flags&(1<<3)) mag |= p.get()<<8;
-                int dir = p.get(); dir |= p.get()<<8;
+                loopk(3) pos[k] = ps[positionstate::O_X+k]/DMF;
+                int mag = ps[positionstate::VEL], dir = ps[positionstate::VELDIR];
                 vec vel = vec((dir%360)*RAD, (clamp(dir/360, 0, 180)-90)*RAD).mul(mag/DVELF);
-                if(flags&(1<<4))
-                {
-                    p.get(); if(flags&(1<<5)) p.get();
-                    if(flags&(1<<6)) loopk(2) p.get();
-                }
+                bool gameclip = (ps[positionstate::FLAGS]&0x80)!=0;
                 if(cp)
                 {
                     if(cp->state.state==CS_ALIVE || cp->state.state==CS_EDITING)
@@ -1743,14 +1823,20 @@ extern int getservermtu();
                             cp->setexceeded();
                         cp->position.setsize(0);
                         while(curmsg<p.length()) cp->position.add(p.buf[curmsg++]);
+                        cp->posstate = ps;
                     }
-                    if(smode && cp->state.state==CS_ALIVE) smode->moved(cp, cp->state.o, cp->gameclip, pos, (flags&0x80)!=0);
+                    if(smode && cp->state.state==CS_ALIVE) smode->moved(cp, cp->state.o, cp->gameclip, pos, gameclip);
                     cp->state.o = pos;
-                    cp->gameclip = (flags&0x80)!=0;
+                    cp->gameclip = gameclip;
+                    if(cp->state.state==CS_ALIVE) recordhitbox(cp);
                 }
                 break;
             }
 
+            case N_POSACK:
+                ackposframe(ci, getuint(p));
+                break;
+
             case N_TELEPORT:
             {
                 int pcn = getint(p), teleport = getint(p), teledest = getint(p);
@@ -1804,7 +1890,7 @@ extern int getservermtu();
                 {
                     ci->state.editstate = ci->state.state;
                     ci->state.state = CS_EDITING;
-                    ci->events.setsize(0);
+                    ci->events.clear();
                     ci->state.rockets.reset();
                     ci->state.grenades.reset();
                     ci->state.bombs.reset();
@@ -1889,6 +1975,7 @@ extern int getservermtu();
                 cq->state.state = CS_ALIVE;
                 cq->state.gunselect = gunselect >= GUN_FIST && gunselect <= GUN_PISTOL ? gunselect : GUN_FIST;
                 cq->exceeded = 0;
+                cq->hitboxes.reset();
                 if(smode) smode->spawned(cq);
                 QUEUE_AI;
                 QUEUE_BUF({
@@ -1900,58 +1987,42 @@ extern int getservermtu();
 
             case N_SUICIDE:
             {
-                ci->addevent(new suicideevent);
+                ci->addevent(EV_SUICIDE);
                 break;
             }
 
             case N_SHOOT:
             {
-                shotevent *shot = new shotevent;
-                shot->id = getint(p);
-                shot->millis = cq ? cq->geteventmillis(gamemillis, shot->id) : 0;
-                shot->gun = getint(p);
-                loopk(3) shot->from[k] = getint(p)/DMF;
-                loopk(3) shot->to[k] = getint(p)/DMF;
-                int hits = getint(p);
-                loopk(hits)
-                {
-                    if(p.overread()) break;
-                    hitinfo &hit = shot->hits.add();
-                    hit.target = getint(p);
-                    hit.lifesequence = getint(p);
-                    hit.dist = getint(p)/DMF;
-                    hit.rays = getint(p);
-                    loopk(3) hit.dir[k] = getint(p)/DNF;
-                }
-                if(cq) 
+                gameevent dummy, *shot = &dummy;
+                int id = getint(p), millis = cq ? cq->geteventmillis(gamemillis, id) : 0;
+                if(cq)
                 {
-                    cq->addevent(shot);
+                    gameevent *ev = cq->addevent(EV_SHOT);
+                    if(ev) shot = ev;
                     cq->setpushed();
                 }
-                else delete shot;
+                shot->id = id;
+                shot->millis = millis;
+                shot->gun = getint(p);
+                loopk(3) shot->from[k] = getint(p)/DMF;
+                loopk(3) shot->to[k] = getint(p)/DMF;
+                gethits(p, shot != &dummy ? cq : nullptr, *shot);
                 break;
             }
 
             case N_EXPLODE:
             {
-                explodeevent *exp = new explodeevent;
-                int cmillis = getint(p);
-                exp->millis = cq ? cq->geteventmillis(gamemillis, cmillis) : 0;
-                exp->gun = getint(p);
-                exp->id = getint(p);
-                int hits = getint(p);
-                loopk(hits)
+                gameevent dummy, *exp = &dummy;
+                int cmillis = getint(p), millis = cq ? cq->geteventmillis(gamemillis, cmillis) : 0;
+                if(cq)
                 {
-                    if(p.overread()) break;
-                    hitinfo &hit = exp->hits.add();
-                    hit.target = getint(p);
-                    hit.lifesequence = getint(p);
-                    hit.dist = getint(p)/DMF;
-                    hit.rays = getint(p);
-                    loopk(3) hit.dir[k] = getint(p)/DNF;
+                    gameevent *ev = cq->addevent(EV_EXPLODE);
+                    if(ev) exp = ev;
                 }
-                if(cq) cq->addevent(exp);
-                else delete exp;
+                exp->millis = millis;
+                exp->gun = getint(p);
+                exp->id = getint(p);
+                gethits(p, exp != &dummy ? cq : nullptr, *exp);
                 break;
             }
 
@@ -1959,9 +2030,8 @@ extern int getservermtu();
             {
                 int n = getint(p);
                 if(!cq) break;
-                pickupevent *pickup = new pickupevent;
-                pickup->ent = n;
-                cq->addevent(pickup);
+                gameevent *pickup = cq->addevent(EV_PICKUP);
+                if(pickup) pickup->id = n;
                 break;
             }
 
@@ -2219,6 +2289,22 @@ extern int getservermtu();
                 break;
             }
 
+            case N_GETDEMOFROM:
+            {
+                int n = getint(p), from = getint(p);
+                if(!ci->privilege && ci->state.state==CS_SPECTATOR) break;
+                senddemo(ci, n, from);
+                break;
+            }
+
+            case N_SEEKDEMO:
+            {
+                int millis = getint(p);
+                if(ci->privilege < (restrictdemos ? PRIV_ADMIN : PRIV_MASTER) || !m_demo) break;
+                seekdemo(millis);
+                break;
+            }
+
             case N_GETMAP:
                 if(!mapdata) sendf(sender, 1, "ris", N_SERVMSG, "no map to send");
                 else if(ci->getmap) sendf(sender, 1, "ris", N_SERVMSG, "already sending map");
@@ -2396,6 +2482,7 @@ extern int getservermtu();
 
             case N_SERVCMD:
                 getstring(text, p);
+                acceptposcodec(ci, text);
                 break;
 
             case -1:
@@ -278,6 +278,35 @@ namespace game
         }
     }
 
+    /// Move bnc for time milliseconds, returns whether it stopped and should explode or vanish.
+    static bool stepbouncer(bouncer &bnc, int time)
+    {
+        vec old(bnc.o);
+        bool stopped = false;
+        if(bnc.bouncetype==BNC_GRENADE) stopped = bounce(&bnc, 0.6f, 0.5f, 0.8f) || (bnc.lifetime -= time)<0;
+        else if(bnc.bouncetype==BNC_BOMB)
+        {
+            bounce(&bnc, 0.2f, 0.3f, 0.8f);
+            stopped = (bnc.lifetime -= time)<0;
+        }
+        else
+        {
+            // cheaper variable rate physics for debris, gibs, etc.
+            for(int rtime = time; rtime > 0;)
+            {
+                int qtime = min(30, rtime);
+                rtime -= qtime;
+                if((bnc.lifetime -= qtime)<0 || bounce(&bnc, qtime/1000.0f, 0.6f, 0.5f, 1)) { stopped = true; break; }
+            }
+        }
+        if(!stopped)
+        {
+            bnc.roll += old.sub(bnc.o).magnitude()/(4*RAD);
+            bnc.offsetmillis = max(bnc.offsetmillis-time, 0);
+        }
+        return stopped;
+    }
+
     void updatebouncers(int time)
     {
         loopv(bouncers)
@@ -296,62 +325,51 @@ namespace game
                 regular_particle_splash(PART_SMOKE, 2, 400, vec(pos.x, pos.y, pos.z + 9), 0x404040, 1.6f, 50, -2000);
 					particle_splash(PART_SPARK, 5, 50, vec(pos.x, pos.y, pos.z + 8), 0xFFFFFF, 0.24f, 300, 1);
             }
-            vec old(bnc.o);
-            bool stopped = false;
-            if(bnc.bouncetype==BNC_GRENADE) stopped = bounce(&bnc, 0.6f, 0.5f, 0.8f) || (bnc.lifetime -= time)<0;
-	        else if(bnc.bouncetype==BNC_BOMB)
-            {
-	            bounce(&bnc, 0.2f, 0.3f, 0.8f);
-                stopped = (bnc.lifetime -= time)<0;
-            }
-            else
+        }
+
+        // everything collides with bombs (see weaponcollide()), so they move on their own afterwards
+        static vector<uchar> stopped;
+        int num = bouncers.length();
+        stopped.setsize(0);
+        stopped.pad(num);
+        stepdynents(num, [&](int i) { if(bouncers[i]->bouncetype!=BNC_BOMB) stopped[i] = stepbouncer(*bouncers[i], time); });
+        loopi(num) if(bouncers[i]->bouncetype==BNC_BOMB) stopped[i] = stepbouncer(*bouncers[i], time);
+
+        // explosions may spawn new bouncers, which start moving next frame
+        for(int i = 0, k = 0; k < num; k++)
+        {
+            bouncer &bnc = *bouncers[i];
+            if(!stopped[k]) { i++; continue; }
+            if(bnc.bouncetype==BNC_GRENADE)
             {
-                // cheaper variable rate physics for debris, gibs, etc.
-                for(int rtime = time; rtime > 0;)
-                {
-                    int qtime = min(30, rtime);
-                    rtime -= qtime;
-                    if((bnc.lifetime -= qtime)<0 || bounce(&bnc, qtime/1000.0f, 0.6f, 0.5f, 1)) { stopped = true; break; }
-                }
+                int qdam = guns[GUN_GL].damage*(bnc.owner->quadmillis ? 4 : 1);
+                hits.setsize(0);
+                explode(bnc.local, bnc.owner, bnc.o, nullptr, qdam, GUN_GL);
+                adddecal(DECAL_SCORCH, bnc.o, vec(0, 0, 1), guns[GUN_GL].exprad/2);
+                if(bnc.local)
+                    addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_GL, bnc.id-maptime,
+                            hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
             }
-            if(stopped)
+            else if(bnc.bouncetype==BNC_BOMB)
             {
-                if(bnc.bouncetype==BNC_GRENADE)
-                {
-                    int qdam = guns[GUN_GL].damage*(bnc.owner->quadmillis ? 4 : 1);
-                    hits.setsize(0);
-                    explode(bnc.local, bnc.owner, bnc.o, nullptr, qdam, GUN_GL);
-                    adddecal(DECAL_SCORCH, bnc.o, vec(0, 0, 1), guns[GUN_GL].exprad/2);
-                    if(bnc.local)
-                        addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_GL, bnc.id-maptime,
-                                hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
-                }
-                else if(bnc.bouncetype==BNC_BOMB)
-                {
-                    hits.setsize(0);
-                    explode(bnc.local, bnc.owner, bnc.o, nullptr, guns[GUN_BOMB].damage, GUN_BOMB);
-                    adddecal(DECAL_SCORCH, bnc.o, vec(0, 0, 1), bnc.owner->bombradius*guns[GUN_BOMB].exprad);
-                    spawnsplinters(bnc.o, bnc.owner); // starts with 3+x generations
-                    if(bnc.local)
-                        addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_BOMB, bnc.id-maptime,
-                                hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
-                }
-                else if(bnc.bouncetype==BNC_SPLINTER)
-                {
-                    hits.setsize(0);
-                    explode(bnc.local, bnc.owner, bnc.o, nullptr, guns[GUN_SPLINTER].damage, GUN_SPLINTER);
-                    spawnnextsplinter(bnc.o, bnc.vel, bnc.owner, bnc.generation);
-                    if(bnc.local)
-                        addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_SPLINTER, bnc.id-maptime,
-                                hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
-                }
-                delete bouncers.remove(i--);
+                hits.setsize(0);
+                explode(bnc.local, bnc.owner, bnc.o, nullptr, guns[GUN_BOMB].damage, GUN_BOMB);
+                adddecal(DECAL_SCORCH, bnc.o, vec(0, 0, 1), bnc.owner->bombradius*guns[GUN_BOMB].exprad);
+                spawnsplinters(bnc.o, bnc.owner); // starts with 3+x generations
+                if(bnc.local)
+                    addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_BOMB, bnc.id-maptime,
+                            hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
             }
-            else
+            else if(bnc.bouncetype==BNC_SPLINTER)
             {
-                bnc.roll += old.sub(bnc.o).magnitude()/(4*RAD);
-                bnc.offsetmillis = max(bnc.offsetmillis-time, 0);
+                hits.setsize(0);
+                explode(bnc.local, bnc.owner, bnc.o, nullptr, guns[GUN_SPLINTER].damage, GUN_SPLINTER);
+                spawnnextsplinter(bnc.o, bnc.vel, bnc.owner, bnc.generation);
+                if(bnc.local)
+                    addmsg(N_EXPLODE, "rci3iv", bnc.owner, lastmillis-maptime, GUN_SPLINTER, bnc.id-maptime,
+                            hits.length(), hits.length()*sizeof(hitmsg)/sizeof(int), hits.getbuf());
             }
+            delete bouncers.remove(i);
         }
     }
 
@@ -557,10 +575,11 @@ namespace game
                 spawnbouncer(debrisorigin, debrisvel, owner, gun==GUN_BARREL ? BNC_BARRELDEBRIS : BNC_DEBRIS, &light);
         }
         if(!local && !m_obstacles) return;
-        int numdyn = numdynents();
-        loopi(numdyn)
+        vector<physent *> near; // not static, killing a barrel explodes it in turn
+        finddynents(v, guns[gun].exprad, near);
+        loopv(near)
         {
-            dynent *o = iterdynents(i);
+            dynent *o = (dynent *)near[i];
             if(o->o.reject(v, o->radius + guns[gun].exprad) || o==safe) continue;
             radialeffect(o, v, damage, owner, gun);
         }
@@ -687,9 +706,12 @@ namespace game
             {
                 vec halfdv = vec(dv).mul(0.5f), bo = vec(p.o).add(halfdv);
                 float br = max(fabs(halfdv.x), fabs(halfdv.y)) + 1;
-                loopj(numdynents())
+                static vector<physent *> near;
+                near.setsize(0);
+                finddynents(bo, br, near);
+                loopvj(near)
                 {
-                    dynent *o = iterdynents(j);
+                    dynent *o = (dynent *)near[j];
                     if(p.owner==o || o->o.reject(bo, o->radius + br)) continue;
                     if(projdamage(o, p, v, qdam)) { exploded = true; break; }
                 }
@@ -878,9 +900,12 @@ namespace game
     {
         dynent *best = nullptr;
         bestdist = 1e16f;
-        loopi(numdynents())
+        static vector<physent *> near;
+        near.setsize(0);
+        finddynents(from, to, near);
+        loopv(near)
         {
-            dynent *o = iterdynents(i);
+            dynent *o = (dynent *)near[i];
             if(o==at || o->state!=CS_ALIVE) continue;
             float dist;
             if(!intersect(o, from, to, dist)) continue;
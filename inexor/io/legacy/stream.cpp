@@ -1,6 +1,9 @@
 #include <stdarg.h>                                   // for va_end, va_start
 #include <algorithm>                                  // for min, max
+#include <condition_variable>                         // for condition_variable
 #include <memory>                                     // for __shared_ptr
+#include <mutex>                                      // for mutex, lock_guard
+#include <thread>                                     // for thread
 
 #include "inexor/io/Logging.hpp"                      // for Log, Logger
 #include "inexor/io/legacy/stream.hpp"
@@ -17,8 +20,10 @@
 
 #ifdef WIN32
 #include <shlobj.h>
+#include <io.h>                                       // for _get_osfhandle
 #else
 #include <dirent.h>                                   // for dirent, closedir
+#include <sys/mman.h>                                 // for mmap, munmap
 #include <sys/stat.h>                                 // for mkdir
 #include <unistd.h>                                   // for access, R_OK, W_OK
 #endif
@@ -195,7 +200,7 @@ const char *addpackagedir(const char *dir)
 ///         Otherwise it returns the inital filename.
 const char *findfile(const char *filename, const char *mode)
 {
-    static string s;
+    static thread_local string s; // textures get loaded on worker threads too
     if(homedir[0])
     {
         formatstring(s, "%s%s", homedir, filename);
@@ -415,6 +420,34 @@ struct filestream : stream
     size_t read(void *buf, size_t len) override { return fread(buf, 1, len, file); }
     size_t write(const void *buf, size_t len) override { return fwrite(buf, 1, len, file); }
     bool flush() override { return !fflush(file); }
+
+    void *map(size_t &len) override
+    {
+        if(!file || fflush(file)) return nullptr;
+        offset filesize = size();
+        if(filesize <= 0 || offset(size_t(filesize)) != filesize) return nullptr;
+        len = size_t(filesize);
+#ifdef WIN32
+        HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(file)), nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping) return nullptr;
+        void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, len);
+        CloseHandle(mapping); // the view keeps the mapping alive
+        return data;
+#else
+        void *data = mmap(nullptr, len, PROT_READ, MAP_SHARED, fileno(file), 0);
+        return data != MAP_FAILED ? data : nullptr;
+#endif
+    }
+
+    void unmap(void *data, size_t len) override
+    {
+        if(!data) return;
+#ifdef WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(data, len);
+#endif
+    }
     int getchar() override { return fgetc(file); }
     bool putchar(int c) override { return fputc(c, file)!=EOF; }
     bool getline(char *str, size_t len) override { return fgets(str, len, file)!=nullptr; }
@@ -895,6 +928,214 @@ struct utf8stream : stream
     bool flush() override { return file->flush(); }
 };
 
+/// Reads its source on a background thread, so e.g. inflating a map overlaps with parsing it.
+/// The source is read in blocks of a fixed size into a ring of numblocks buffers.
+struct readaheadstream : stream
+{
+    stream *source;
+    size_t blocksize;
+    int numblocks;
+    uchar **blocks;
+    size_t *blocklens;
+    int first, count;           // the queued blocks, the one at first is being consumed if curlen is set
+    size_t curpos, curlen;
+    offset pos;
+    bool hascur, done, stopping;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable filled, consumed;
+
+    readaheadstream(stream *source, size_t blocksize, int numblocks)
+      : source(source), blocksize(blocksize), numblocks(numblocks), first(0), count(0),
+        curpos(0), curlen(0), pos(0), hascur(false), done(false), stopping(false)
+    {
+        blocks = new uchar *[numblocks];
+        blocklens = new size_t[numblocks];
+        loopi(numblocks) blocks[i] = new uchar[blocksize];
+        thread = std::thread([this] { run(); });
+    }
+
+    ~readaheadstream() override { close(); }
+
+    void run()
+    {
+        for(;;)
+        {
+            int slot;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                consumed.wait(guard, [this] { return count < numblocks || stopping; });
+                if(stopping) break;
+                slot = (first + count) % numblocks;
+            }
+            // the slot is neither queued nor consumed, so it can be filled without holding the lock
+            size_t n = source->read(blocks[slot], blocksize);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                blocklens[slot] = n;
+                count++;
+                if(n < blocksize) done = true;
+            }
+            filled.notify_one();
+            if(n < blocksize) break;
+        }
+    }
+
+    /// Hand the current block back to the reader thread and wait for the next one.
+    bool nextblock()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        do
+        {
+            if(hascur)
+            {
+                first = (first + 1) % numblocks;
+                count--;
+                hascur = false;
+                curpos = curlen = 0;
+                consumed.notify_one();
+            }
+            filled.wait(guard, [this] { return count > 0 || done || stopping; });
+            if(!count) return false;
+            hascur = true;
+            curlen = blocklens[first];
+        }
+        while(!curlen);
+        return true;
+    }
+
+    void close() override
+    {
+        if(!blocks) return;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        consumed.notify_one();
+        if(thread.joinable()) thread.join();
+        loopi(numblocks) delete[] blocks[i];
+        DELETEA(blocks);
+        DELETEA(blocklens);
+        DELETEP(source);
+    }
+
+    bool end() override { return curpos >= curlen && !nextblock(); }
+    offset tell() override { return pos; }
+    offset size() override { return -1; }
+
+    size_t read(void *buf, size_t len) override
+    {
+        if(!blocks) return 0;
+        size_t next = 0;
+        while(next < len)
+        {
+            if(curpos >= curlen) { if(nextblock()) continue; break; }
+            size_t n = min(len - next, curlen - curpos);
+            memcpy(&((uchar *)buf)[next], &blocks[first][curpos], n);
+            next += n;
+            curpos += n;
+        }
+        pos += next;
+        return next;
+    }
+
+    int getchar() override
+    {
+        if(curpos < curlen) { pos++; return blocks[first][curpos++]; }
+        uchar c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    /// Only skipping forward is supported.
+    bool seek(offset off, int whence) override
+    {
+        if(whence == SEEK_END)
+        {
+            uchar skip[512];
+            while(read(skip, sizeof(skip)) == sizeof(skip));
+            return !off;
+        }
+        if(whence == SEEK_SET) off -= pos;
+        if(off < 0) return false;
+        while(off > 0)
+        {
+            if(curpos >= curlen) { if(nextblock()) continue; return false; }
+            size_t n = size_t(min(off, offset(curlen - curpos)));
+            curpos += n;
+            pos += n;
+            off -= n;
+        }
+        return true;
+    }
+
+    /// The checksum of the source, which only is complete once it has been read to its end.
+    uint getcrc() override
+    {
+        seek(0, SEEK_END);
+        return source ? source->getcrc() : 0;
+    }
+};
+
+stream *openreadahead(stream *source, size_t blocksize, int numblocks)
+{
+    if(!source) return nullptr;
+    return new readaheadstream(source, max(blocksize, size_t(1)), max(numblocks, 2));
+}
+
+/// Reads a file through a read-only memory mapping of it, starting at a fixed offset.
+struct mappedstream : stream
+{
+    stream *file;
+    uchar *data;
+    size_t maplen, start, pos;
+
+    mappedstream(stream *file, uchar *data, size_t maplen, size_t start)
+      : file(file), data(data), maplen(maplen), start(start), pos(start)
+    {
+    }
+
+    ~mappedstream() override { close(); }
+
+    void close() override
+    {
+        if(data) { file->unmap(data, maplen); data = nullptr; }
+        DELETEP(file);
+    }
+
+    bool end() override { return pos >= maplen; }
+    offset tell() override { return offset(pos - start); }
+    offset size() override { return offset(maplen - start); }
+
+    bool seek(offset off, int whence) override
+    {
+        if(whence == SEEK_CUR) off += pos - start;
+        else if(whence == SEEK_END) off += maplen - start;
+        if(off < 0 || off > offset(maplen - start)) return false;
+        pos = start + size_t(off);
+        return true;
+    }
+
+    size_t read(void *buf, size_t len) override
+    {
+        if(!data) return 0;
+        len = min(len, maplen - pos);
+        memcpy(buf, &data[pos], len);
+        pos += len;
+        return len;
+    }
+
+    int getchar() override { return data && pos < maplen ? data[pos++] : -1; }
+};
+
+stream *openmapped(stream *file, size_t start)
+{
+    size_t len = 0;
+    uchar *data = file ? (uchar *)file->map(len) : nullptr;
+    if(!data) return nullptr;
+    if(start > len) { file->unmap(data, len); return nullptr; }
+    return new mappedstream(file, data, len, start);
+}
+
 stream *openrawfile(const char *filename, const char *mode)
 {
     const char *found = findfile(filename, mode);
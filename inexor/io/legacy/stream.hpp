@@ -49,6 +49,10 @@ struct stream
     virtual bool putline(const char *str) { return putstring(str) && putchar('\n'); }
     virtual size_t printf(const char *fmt, ...) PRINTFARGS(2, 3);
     virtual uint getcrc() { return 0; }
+    /// Map the whole file read-only into memory, nullptr if the stream does not support it.
+    /// Pending writes get flushed first. Release the mapping with unmap().
+    virtual void *map(size_t &len) { return nullptr; }
+    virtual void unmap(void *data, size_t len) {}
 
     template<class T> size_t put(const T *v, size_t n) { return write(v, n*sizeof(T))/sizeof(T); }
     template<class T> bool put(T n) { return write(&n, sizeof(n)) == sizeof(n); }
@@ -91,6 +95,10 @@ extern stream *openfile(const char *filename, const char *mode);
 extern stream *opentempfile(const char *filename, const char *mode);
 extern stream *opengzfile(const char *filename, const char *mode, stream *file = nullptr, int level = Z_BEST_COMPRESSION);
 extern stream *openutf8file(const char *filename, const char *mode, stream *file = nullptr);
+/// Read source ahead on a background thread, the returned stream takes ownership of it.
+extern stream *openreadahead(stream *source, size_t blocksize = 1<<16, int numblocks = 8);
+/// Read file through a memory mapping from offset start on, takes ownership of file if it succeeds.
+extern stream *openmapped(stream *file, size_t start = 0);
 extern char *loadfile(const char *fn, size_t *size, bool utf8 = true);
 extern bool listdir(const char *dir, bool rel, const char *ext, vector<char *> &files);
 extern int listfiles(const char *dir, const char *ext, vector<char *> &files);
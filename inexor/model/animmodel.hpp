@@ -502,6 +502,8 @@ struct animmodel : model
         virtual void cleanup() {}
         virtual void preload(part *p) {}
         virtual void render(const animstate *as, float pitch, const vec &axis, const vec &forward, dynent *d, part *p) {}
+        /// Called instead of render() while preparing (see animmodel::preparing).
+        virtual void prepare(const animstate *as, float pitch, const vec &axis, const vec &forward, dynent *d, part *p) {}
 
         void bindpos(GLuint ebuf, GLuint vbuf, void *v, int stride)
         {
@@ -879,7 +881,7 @@ struct animmodel : model
             }
             matrixstack[matrixpos].transposedtransformnormal(forward, oforward);
 
-            if(!(anim&ANIM_NORENDER))
+            if(!(anim&ANIM_NORENDER) && !preparing)
             {
                 matrix4 modelmatrix;
                 modelmatrix.mul(shadowmapping ? shadowmatrix : camprojmatrix, matrixstack[matrixpos]);
@@ -900,9 +902,10 @@ struct animmodel : model
                 }
             }
 
-            meshes->render(as, pitch, oaxis, oforward, d, this);
+            if(preparing) meshes->prepare(as, pitch, oaxis, oforward, d, this);
+            else meshes->render(as, pitch, oaxis, oforward, d, this);
 
-            if(!(anim&ANIM_REUSE)) 
+            if(!(anim&ANIM_REUSE) && !preparing)
             {
                 loopv(links)
                 {
@@ -1052,6 +1055,14 @@ struct animmodel : model
         }
         else pitch = 0;
 
+        if(preparing)
+        {
+            // attachments and linked parts get posed relative to tags of this one, so they wait for rendering
+            animstate as[MAXANIMPARTS];
+            parts[0]->render(anim, basetime, basetime2, pitch, axis, forward, d, as);
+            return;
+        }
+
         if(anim&ANIM_NORENDER)
         {
             render(anim, basetime, basetime2, pitch, axis, forward, d, a);
@@ -1309,6 +1320,9 @@ struct animmodel : model
     static Texture *lasttex, *lastmasks, *lastnormalmap;
     static int matrixpos;
     static matrix4 matrixstack[64];
+    /// Set while the animations of a frame get prepared: render() then only caches the poses of the models
+    /// without drawing anything, so they can be computed all at once before drawing (see prepareanims()).
+    static bool preparing;
 
     void startrender() override
     {
@@ -1377,6 +1391,7 @@ GLuint animmodel::lastvbuf = 0, animmodel::lasttcbuf = 0, animmodel::lastnbuf =
 Texture *animmodel::lasttex = nullptr, *animmodel::lastmasks = nullptr, *animmodel::lastnormalmap = nullptr;
 int animmodel::matrixpos = 0;
 matrix4 animmodel::matrixstack[64];
+bool animmodel::preparing = false;
 
 static inline uint hthash(const animmodel::shaderparams &k)
 {
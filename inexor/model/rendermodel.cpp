@@ -3,6 +3,7 @@
 #include <math.h>                                     // for fabs, sqrtf
 #include <string.h>                                   // for strchr, strlen
 #include <algorithm>                                  // for max, min
+#include <chrono>                                     // for duration, steady_...
 #include <memory>                                     // for __shared_ptr
 #include <string>                                     // for string
 
@@ -30,6 +31,7 @@
 #include "inexor/io/legacy/stream.hpp"                // for makerelpath
 #include "inexor/model/model.hpp"                     // for model, modelattach
 #include "inexor/model/rendermodel.hpp"
+#include "inexor/model/skinning.hpp"                  // for skinmesh, skinpath
 #include "inexor/network/SharedVar.hpp"               // for SharedVar
 #include "inexor/physics/physics.hpp"                 // for rotatebb
 #include "inexor/shared/command.hpp"                  // for COMMAND, VAR
@@ -52,6 +54,8 @@ void preloadmodelshaders(bool force);
 
 VAR(oqdynent, 0, 1, 1);
 VAR(animationinterpolationtime, 0, 150, 1000);
+/// Pose the skeletons of all batched models in parallel before rendering them.
+VARP(animjobs, 0, 1, 1);
 
 model *loadingmodel = nullptr;
 
@@ -660,8 +664,28 @@ static inline bool sorttransparentmodels(const transparentmodel &x, const transp
     return x.dist < y.dist;
 }
 
+/// Pose all models of the batches that get rendered below, computing the bones of distinct poses in parallel.
+/// Rendering then finds the poses in the skeleton caches and only uploads them.
+static void prepareanims()
+{
+    animmodel::preparing = true;
+    loopi(numbatches)
+    {
+        modelbatch &b = *batches[i];
+        loopvj(b.batched)
+        {
+            batchedmodel &bm = b.batched[j];
+            if(bm.flags&MDL_CULL_VFC || (bm.flags&MDL_GHOST && bm.query)) continue;
+            renderbatchedmodel(b.m, bm);
+        }
+    }
+    animmodel::preparing = false;
+    skelmodel::evalpendingbones();
+}
+
 void endmodelbatches()
 {
+    if(animjobs) prepareanims();
     vector<transparentmodel> transparent;
     loopi(numbatches)
     {
@@ -1188,3 +1212,93 @@ void setbbfrommodel(dynent *d, const char *mdl)
     d->aboveeye  = radius.z*2*(1.0f-m->eyeheight);
 }
 
+
+/// Time the cpu skinning of the skeletal model name in its base pose with every kernel up to skinsimd.
+static void skinbench(char *name, int *iterations)
+{
+    const char *mdl = name[0] ? name : "player/mrfixit2";
+    model *m = loadmodel(mdl);
+    if(!m || (m->type() != MDL_MD5 && m->type() != MDL_SMD && m->type() != MDL_IQM))
+    {
+        Log.std->error("skinbench: {} is no skeletal model", mdl);
+        return;
+    }
+    int num = *iterations > 0 ? *iterations : 1000;
+    loopv(((skelmodel *)m)->parts)
+    {
+        skelmodel::skelmeshgroup *g = (skelmodel::skelmeshgroup *)((skelmodel *)m)->parts[i]->meshes;
+        if(!g || !g->skel->numbones) continue;
+        skelmodel::skeleton *skel = g->skel;
+
+        // the layout skelmeshgroup::genvbo() uses for cpu skinning, without touching the model
+        vector<int> remap;
+        int numblends = 0;
+        loopvj(g->blendcombos)
+        {
+            const skelmodel::blendcombo &c = g->blendcombos[j];
+            remap.add(c.weights[1] ? skel->numgpubones + numblends++ : c.interpbones[0]);
+        }
+        dualquat *bdata = new dualquat[max(skel->numinterpbones, 1)], *blends = new dualquat[max(numblends, 1)];
+        loopj(skel->numbones) if(skel->bones[j].interpindex >= 0) bdata[skel->bones[j].interpindex] = skel->bones[j].base;
+        const dualquat *bdata2 = blends - skel->numgpubones;
+
+        vector<skinverts *> soas;
+        int numverts = 0, maxverts = 1;
+        loopvj(g->meshes)
+        {
+            skelmodel::skelmesh &sm = *(skelmodel::skelmesh *)g->meshes[j];
+            skinverts *v = soas.add(new skinverts);
+            v->alloc(sm.numverts);
+            loopk(sm.numverts) v->set(k, sm.verts[k].pos, sm.verts[k].norm, remap[sm.verts[k].blend]);
+            numverts += sm.numverts;
+            maxverts = max(maxverts, sm.numverts);
+        }
+        skelmodel::vvertn *vdata = new skelmodel::vvertn[maxverts];
+        int normoffset = int((uchar *)&vdata->norm - (uchar *)vdata);
+
+        for(int path = SKIN_SCALAR; path <= skinpath(); path++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            loopk(num)
+            {
+                loopvj(g->blendcombos)
+                {
+                    const skelmodel::blendcombo &c = g->blendcombos[j];
+                    if(!c.weights[1]) continue;
+                    dualquat &d = blends[remap[j] - skel->numgpubones];
+                    if(path > SKIN_SCALAR) blendskinbones(path, d, bdata, c.weights, c.interpbones, true);
+                    else
+                    {
+                        skelmodel::skelmeshgroup::blendbones(d, bdata, c);
+                        d.normalize();
+                    }
+                }
+                loopvj(g->meshes)
+                {
+                    skelmodel::skelmesh &sm = *(skelmodel::skelmesh *)g->meshes[j];
+                    if(path > SKIN_SCALAR)
+                    {
+                        skinmesh(path, *soas[j], bdata, bdata2, skel->numgpubones, (uchar *)vdata, sizeof(skelmodel::vvertn), normoffset);
+                        continue;
+                    }
+                    loopl(sm.numverts)
+                    {
+                        int bone = remap[sm.verts[l].blend];
+                        const dualquat &b = (bone < skel->numgpubones ? bdata : bdata2)[bone];
+                        vdata[l].pos = b.transform(sm.verts[l].pos);
+                        vdata[l].norm = b.transformnormal(sm.verts[l].norm);
+                    }
+                }
+            }
+            std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+            Log.std->info("skinbench: {} part {}, {} verts, {} blends: {:.4f} ms per skin with {}",
+                          mdl, i, numverts, numblends, ms.count() / num, skinpathname(path));
+        }
+
+        soas.deletecontents();
+        delete[] vdata;
+        delete[] bdata;
+        delete[] blends;
+    }
+}
+COMMAND(skinbench, "si");
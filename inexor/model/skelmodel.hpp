@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include "inexor/model/skinning.hpp"
 #include "inexor/shared/command.hpp"
+#include "inexor/util/JobSystem.hpp"
 #define BONEMASK_NOT  0x8000
 #define BONEMASK_END  0xFFFF
 #define BONEMASK_BONE 0x7FFF
@@ -177,6 +179,8 @@ struct skelmodel : animmodel
         int voffset, eoffset, elen;
         ushort minvert, maxvert;
 
+        skinverts soa; ///< verts regrouped for the SIMD skinning kernels, built on the first CPU skinning
+
         skelmesh() : verts(nullptr), bumpverts(nullptr), tris(nullptr), numverts(0), numtris(0), maxweights(0)
         {
         }
@@ -314,7 +318,9 @@ struct skelmodel : animmodel
         int genvbo(vector<ushort> &idxs, int offset)
         {
             loopi(numverts) verts[i].interpindex = ((skelmeshgroup *)group)->remapblend(verts[i].blend);
-            
+
+            soa.clear(); // the blend indices may have changed
+
             voffset = offset;
             eoffset = idxs.length();
             loopi(numtris)
@@ -342,10 +348,38 @@ struct skelmodel : animmodel
         }
 
         void interpverts(const dualquat * RESTRICT bdata1, const dualquat * RESTRICT bdata2, bool tangents, void * RESTRICT vdata, skin &s)
+        {
+            interpverts(skinpath(), bdata1, bdata2, tangents, vdata, s);
+        }
+
+        void interpverts(int path, const dualquat * RESTRICT bdata1, const dualquat * RESTRICT bdata2, bool tangents, void * RESTRICT vdata, skin &s)
         {
             const int blendoffset = ((skelmeshgroup *)group)->skel->numgpubones;
             bdata2 -= blendoffset;
 
+            if(path > SKIN_SCALAR && numverts)
+            {
+                if(soa.numverts != numverts)
+                {
+                    soa.alloc(numverts);
+                    loopi(numverts) soa.set(i, verts[i].pos, verts[i].norm, verts[i].interpindex);
+                }
+                // the kernels do positions and normals, tangents stay scalar since they need fixqtangent()
+                if(tangents)
+                {
+                    skinmesh(path, soa, bdata1, bdata2, blendoffset, (uchar *)vdata, sizeof(vvertbump), -1);
+                    loopi(numverts)
+                    {
+                        const dualquat &b = (verts[i].interpindex < blendoffset ? bdata1 : bdata2)[verts[i].interpindex];
+                        quat q = b.transform(bumpverts[i].tangent);
+                        fixqtangent(q, bumpverts[i].tangent.w);
+                        ((vvertbump * RESTRICT)vdata)[i].tangent = q;
+                    }
+                }
+                else skinmesh(path, soa, bdata1, bdata2, blendoffset, (uchar *)vdata, sizeof(vvertn), int((uchar *)&((vvertn *)vdata)->norm - (uchar *)vdata));
+                return;
+            }
+
             #define IPLOOP(type, dosetup, dotransform) \
                 loopi(numverts) \
                 { \
@@ -450,16 +484,16 @@ struct skelmodel : animmodel
     struct pitchtarget
     {
         int bone, frame, corrects, deps;
-        float pitchmin, pitchmax, deviated;
+        float pitchmin, pitchmax;
         dualquat pose;
     };
 
     struct pitchcorrect
     {
         int bone, target, parent;
-        float pitchmin, pitchmax, pitchscale, pitchangle, pitchtotal;
+        float pitchmin, pitchmax, pitchscale;
 
-        pitchcorrect() : parent(-1), pitchangle(0), pitchtotal(0) {}
+        pitchcorrect() : parent(-1) {}
     };
 
     struct skeleton
@@ -807,7 +841,7 @@ struct skelmodel : animmodel
         int availgpubones() const { return min(maxvsuniforms - reservevpparams - 10, maxskelanimdata) / 2; }
         bool gpuaccelerate() const { return numframes && gpuskel && numgpubones<=availgpubones(); }
 
-        float calcdeviation(const vec &axis, const vec &forward, const dualquat &pose1, const dualquat &pose2)
+        float calcdeviation(const vec &axis, const vec &forward, const dualquat &pose1, const dualquat &pose2) const
         {
             vec forward1 = pose1.transformnormal(forward).project(axis).normalize(),
                 forward2 = pose2.transformnormal(forward).project(axis).normalize(),
@@ -817,30 +851,22 @@ struct skelmodel : animmodel
             return atan2f(dy, dx)/RAD;
         }
 
-        void calcpitchcorrects(float pitch, const vec &axis, const vec &forward)
+        /// Fill angles (and totals) of all pitchcorrects given the current poses of the pitchdeps.
+        void calcpitchcorrects(float pitch, const vec &axis, const vec &forward, const dualquat *poses, float *angles, float *totals) const
         {
-            loopv(pitchtargets)
-            {
-                pitchtarget &t = pitchtargets[i];
-                t.deviated = calcdeviation(axis, forward, t.pose, pitchdeps[t.deps].pose);
-            }
-            loopv(pitchcorrects)
-            {
-                pitchcorrect &c = pitchcorrects[i];
-                c.pitchangle = c.pitchtotal = 0;
-            }
+            loopv(pitchcorrects) angles[i] = totals[i] = 0;
             loopvj(pitchtargets)
             {
-                pitchtarget &t = pitchtargets[j];
-                float tpitch = pitch - t.deviated;
+                const pitchtarget &t = pitchtargets[j];
+                float tpitch = pitch - calcdeviation(axis, forward, t.pose, poses[t.deps]);
                 for(int parent = t.corrects; parent >= 0; parent = pitchcorrects[parent].parent)
-                    tpitch -= pitchcorrects[parent].pitchangle;
+                    tpitch -= angles[parent];
                 if(t.pitchmin || t.pitchmax) tpitch = clamp(tpitch, t.pitchmin, t.pitchmax);
                 loopv(pitchcorrects)
                 {
-                    pitchcorrect &c = pitchcorrects[i];
+                    const pitchcorrect &c = pitchcorrects[i];
                     if(c.target != j) continue;
-                    float total = c.parent >= 0 ? pitchcorrects[c.parent].pitchtotal : 0, 
+                    float total = c.parent >= 0 ? totals[c.parent] : 0, 
                           avail = tpitch - total, 
                           used = tpitch*c.pitchscale;
                     if(c.pitchmin || c.pitchmax)
@@ -850,8 +876,8 @@ struct skelmodel : animmodel
                     }
                     if(used < 0) used = clamp(avail, used, 0.0f);
                     else used = clamp(avail, 0.0f, used);
-                    c.pitchangle = used;
-                    c.pitchtotal = used + total;
+                    angles[i] = used;
+                    totals[i] = used + total;
                 }
             }
         }
@@ -868,10 +894,16 @@ struct skelmodel : animmodel
                 d.accumulate(f.pfr2[bone], s.prev.t*(1-s.interp)); \
             }
 
-        void interpbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc)
+        /// Pose all bones for the animation state as; only writes sc.bdata, so it may run on any thread.
+        void interpbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc) const
         {
-            if(!sc.bdata) sc.bdata = new dualquat[numinterpbones];
-            sc.nextversion();
+            // pitch corrections get scratch space per thread, so models sharing this skeleton can be posed at once
+            static thread_local vector<dualquat> depposes;
+            static thread_local vector<float> correctangles;
+            depposes.growbuf(pitchdeps.length());
+            correctangles.growbuf(2*pitchcorrects.length());
+            dualquat *poses = depposes.getbuf();
+            float *angles = correctangles.getbuf(), *totals = angles + pitchcorrects.length();
             struct framedata
             {
                 const dualquat *fr1, *fr2, *pfr1, *pfr2;
@@ -888,13 +920,13 @@ struct skelmodel : animmodel
             }
             loopv(pitchdeps)
             {
-                pitchdep &p = pitchdeps[i];
+                const pitchdep &p = pitchdeps[i];
                 INTERPBONE(p.bone);
                 d.normalize();
-                if(p.parent >= 0) p.pose.mul(pitchdeps[p.parent].pose, d);
-                else p.pose = d;
+                if(p.parent >= 0) poses[i].mul(poses[p.parent], d);
+                else poses[i] = d;
             }
-            calcpitchcorrects(pitch, axis, forward);
+            calcpitchcorrects(pitch, axis, forward, poses, angles, totals);
             loopi(numbones) if(bones[i].interpindex>=0)
             {
                 INTERPBONE(i);
@@ -904,7 +936,7 @@ struct skelmodel : animmodel
                 else sc.bdata[b.interpindex].mul(sc.bdata[b.interpparent], d);
                 float angle;
                 if(b.pitchscale) { angle = b.pitchscale*pitch + b.pitchoffset; if(b.pitchmin || b.pitchmax) angle = clamp(angle, b.pitchmin, b.pitchmax); }
-                else if(b.correctindex >= 0) angle = pitchcorrects[b.correctindex].pitchangle;
+                else if(b.correctindex >= 0) angle = angles[b.correctindex];
                 else continue;
                 if(as->cur.anim&ANIM_NOPITCH || (as->interp < 1 && as->prev.anim&ANIM_NOPITCH))
                     angle *= (as->cur.anim&ANIM_NOPITCH ? 0 : as->interp) + (as->interp < 1 && as->prev.anim&ANIM_NOPITCH ? 0 : 1-as->interp);
@@ -949,10 +981,9 @@ struct skelmodel : animmodel
             }
         }
 
-        void genragdollbones(ragdolldata &d, skelcacheentry &sc, part *p)
+        /// Pose all bones after the ragdoll d; like interpbones() it may run on any thread.
+        void genragdollbones(const ragdolldata &d, skelcacheentry &sc, const part *p) const
         {
-            if(!sc.bdata) sc.bdata = new dualquat[numinterpbones];
-            sc.nextversion();
             loopv(ragdoll->joints)
             {
                 const ragdollskel::joint &j = ragdoll->joints[i];
@@ -1022,7 +1053,9 @@ struct skelmodel : animmodel
             }
         }
 
-        skelcacheentry &checkskelcache(part *p, const animstate *as, float pitch, const vec &axis, const vec &forward, ragdolldata *rdata)
+        /// Find or claim the cache entry for this pose and compute its bones.
+        /// With defer the bones are queued to pendingbones instead, to be computed by evalpendingbones().
+        skelcacheentry &checkskelcache(part *p, const animstate *as, float pitch, const vec &axis, const vec &forward, ragdolldata *rdata, bool defer = false)
         {
             if(skelcache.empty()) 
             {
@@ -1051,7 +1084,18 @@ struct skelmodel : animmodel
                 sc->pitch = pitch;
                 sc->partmask = partmask;
                 sc->ragdoll = rdata;
-                if(rdata) genragdollbones(*rdata, *sc, p);
+                if(!sc->bdata) sc->bdata = new dualquat[numinterpbones];
+                sc->nextversion();
+                if(defer)
+                {
+                    pendingbone &b = pendingbones.add();
+                    b.skel = this;
+                    b.p = p;
+                    b.entry = sc - skelcache.getbuf();
+                    b.axis = axis;
+                    b.forward = forward;
+                }
+                else if(rdata) genragdollbones(*rdata, *sc, p);
                 else interpbones(as, pitch, axis, forward, numanimparts, partmask, *sc);
             }
             sc->millis = lastmillis;
@@ -1096,6 +1140,33 @@ struct skelmodel : animmodel
         }
     };
 
+    /// A skelcache entry whose bones checkskelcache() deferred while the models of a frame got prepared.
+    struct pendingbone
+    {
+        skeleton *skel;
+        part *p;
+        int entry;
+        vec axis, forward;
+
+        void eval() const
+        {
+            skelcacheentry &sc = skel->skelcache[entry];
+            if(sc.ragdoll) skel->genragdollbones(*sc.ragdoll, sc, p);
+            else skel->interpbones(sc.as, sc.pitch, axis, forward, ((skelpart *)sc.as->owner)->numanimparts, sc.partmask, sc);
+        }
+    };
+    static vector<pendingbone> pendingbones;
+
+    /// Compute all deferred bones, spread over the job system if it is running.
+    static void evalpendingbones()
+    {
+        if(pendingbones.empty()) return;
+        inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+        if(jobs && pendingbones.length() > 1) jobs->parallel_for(pendingbones.length(), [](int i) { pendingbones[i].eval(); });
+        else loopv(pendingbones) pendingbones[i].eval();
+        pendingbones.setsize(0);
+    }
+
     struct skelmeshgroup : meshgroup
     {
         skeleton *skel;
@@ -1357,7 +1428,7 @@ struct skelmodel : animmodel
             }
         }
 
-        void blendbones(const skelcacheentry &sc, blendcacheentry &bc)
+        void blendbones(const skelcacheentry &sc, blendcacheentry &bc, int path = skinpath())
         {
             bc.nextversion();
             if(!bc.bdata) bc.bdata = new dualquat[vblends];
@@ -1368,8 +1439,12 @@ struct skelmodel : animmodel
                 const blendcombo &c = blendcombos[i];
                 if(c.interpindex<0) break;
                 dualquat &d = dst[c.interpindex];
-                blendbones(d, sc.bdata, c);
-                if(normalize) d.normalize();
+                if(path > SKIN_SCALAR) blendskinbones(path, d, sc.bdata, c.weights, c.interpbones, normalize);
+                else
+                {
+                    blendbones(d, sc.bdata, c);
+                    if(normalize) d.normalize();
+                }
             }
         }
 
@@ -1431,6 +1506,18 @@ struct skelmodel : animmodel
             if(!vbocache->vbuf) genvbo(tangents, *vbocache);
         }
 
+        ragdolldata *getragdoll(const animstate *as, dynent *d) const
+        {
+            return as->cur.anim&ANIM_RAGDOLL || !d || !d->ragdoll || d->ragdoll->skel != skel->ragdoll ? nullptr : d->ragdoll;
+        }
+
+        void prepare(const animstate *as, float pitch, const vec &axis, const vec &forward, dynent *d, part *p) override
+        {
+            // render() starts over with an empty cache in this case anyway
+            if(!skel->numframes || skel->shouldcleanup()) return;
+            skel->checkskelcache(p, as, pitch, axis, forward, getragdoll(as, d), true);
+        }
+
         void render(const animstate *as, float pitch, const vec &axis, const vec &forward, dynent *d, part *p) override
         {
             bool tangents = false;
@@ -1455,7 +1542,7 @@ struct skelmodel : animmodel
                 return;
             }
 
-            skelcacheentry &sc = skel->checkskelcache(p, as, pitch, axis, forward, as->cur.anim&ANIM_RAGDOLL || !d || !d->ragdoll || d->ragdoll->skel != skel->ragdoll ? nullptr : d->ragdoll);
+            skelcacheentry &sc = skel->checkskelcache(p, as, pitch, axis, forward, getragdoll(as, d));
             if(!(as->cur.anim&ANIM_NORENDER))
             {
                 int owner = &sc-&skel->skelcache[0];
@@ -1607,6 +1694,8 @@ struct skelmodel : animmodel
     }
 };
 
+vector<skelmodel::pendingbone> skelmodel::pendingbones;
+
 struct skeladjustment
 {
     float yaw, pitch, roll;
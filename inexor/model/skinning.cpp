@@ -0,0 +1,223 @@
+#include <string.h>                                   // for memcpy
+
+#include "inexor/model/skinning.hpp"
+#include "inexor/network/SharedVar.hpp"               // for SharedVar
+#include "inexor/shared/command.hpp"                  // for VARP
+#include "inexor/shared/cube_loops.hpp"               // for loopi, loopj
+#include "inexor/shared/cube_tools.hpp"               // for DELETEA
+#include "inexor/shared/simd.hpp"                     // for cpusimd, SIMD_X86
+#include "inexor/shared/tools.hpp"                    // for min
+
+/// Highest instruction set used to skin models on the CPU: 0 scalar, 1 SSE2, 2 AVX2.
+VARP(skinsimd, 0, 2, 2);
+
+void skinverts::clear()
+{
+    DELETEA(coords);
+    DELETEA(bones);
+    numverts = numblocks = 0;
+}
+
+void skinverts::alloc(int n)
+{
+    clear();
+    numverts = n;
+    numblocks = (n + SKINBLOCK-1)/SKINBLOCK;
+    coords = new float[numblocks*NUMCOORDS*SKINBLOCK];
+    bones = new int[numblocks*SKINBLOCK];
+}
+
+void skinverts::set(int i, const vec &pos, const vec &norm, int bone)
+{
+    // the padding of the last block repeats the last vertex, so the kernels need no tail loop
+    for(int j = i; j < (i == numverts-1 ? numblocks*SKINBLOCK : i+1); j++)
+    {
+        float *c = &coords[(j/SKINBLOCK)*NUMCOORDS*SKINBLOCK + j%SKINBLOCK];
+        c[POS_X*SKINBLOCK] = pos.x;
+        c[POS_Y*SKINBLOCK] = pos.y;
+        c[POS_Z*SKINBLOCK] = pos.z;
+        c[NORM_X*SKINBLOCK] = norm.x;
+        c[NORM_Y*SKINBLOCK] = norm.y;
+        c[NORM_Z*SKINBLOCK] = norm.z;
+        bones[j] = bone;
+    }
+}
+
+int skinpath()
+{
+    return min(int(skinsimd), cpusimd());
+}
+
+const char *skinpathname(int path)
+{
+    return simdname(path);
+}
+
+/// The dual quaternion transform of dualquat::transform() and dualquat::transformnormal() on
+/// vectors of vertices: rx..dw hold the bones, px..nz the vertices; op..on receive the result.
+#define SKINTRANSFORM(V, ADD, SUB, MUL) \
+    { \
+        V ax = ADD(ADD(SUB(MUL(ry, pz), MUL(rz, py)), MUL(px, rw)), dx), \
+          ay = ADD(ADD(SUB(MUL(rz, px), MUL(rx, pz)), MUL(py, rw)), dy), \
+          az = ADD(ADD(SUB(MUL(rx, py), MUL(ry, px)), MUL(pz, rw)), dz); \
+        V bx = SUB(ADD(SUB(MUL(ry, az), MUL(rz, ay)), MUL(dx, rw)), MUL(rx, dw)), \
+          by = SUB(ADD(SUB(MUL(rz, ax), MUL(rx, az)), MUL(dy, rw)), MUL(ry, dw)), \
+          bz = SUB(ADD(SUB(MUL(rx, ay), MUL(ry, ax)), MUL(dz, rw)), MUL(rz, dw)); \
+        opx = ADD(ADD(bx, bx), px); \
+        opy = ADD(ADD(by, by), py); \
+        opz = ADD(ADD(bz, bz), pz); \
+        if(normals) \
+        { \
+            V cx = ADD(SUB(MUL(ry, nz), MUL(rz, ny)), MUL(nx, rw)), \
+              cy = ADD(SUB(MUL(rz, nx), MUL(rx, nz)), MUL(ny, rw)), \
+              cz = ADD(SUB(MUL(rx, ny), MUL(ry, nx)), MUL(nz, rw)); \
+            V ex = SUB(MUL(ry, cz), MUL(rz, cy)), \
+              ey = SUB(MUL(rz, cx), MUL(rx, cz)), \
+              ez = SUB(MUL(rx, cy), MUL(ry, cx)); \
+            onx = ADD(ADD(ex, ex), nx); \
+            ony = ADD(ADD(ey, ey), ny); \
+            onz = ADD(ADD(ez, ez), nz); \
+        } \
+    }
+
+/// Write the lanes of a block back into the interleaved vertex array.
+static inline void storeskinned(const float out[skinverts::NUMCOORDS][SKINBLOCK], int num, uchar *dst, int stride, int normoffset)
+{
+    loopi(num)
+    {
+        float *pos = (float *)(dst + i*stride);
+        pos[0] = out[0][i];
+        pos[1] = out[1][i];
+        pos[2] = out[2][i];
+        if(normoffset < 0) continue;
+        float *norm = (float *)(dst + i*stride + normoffset);
+        norm[0] = out[3][i];
+        norm[1] = out[4][i];
+        norm[2] = out[5][i];
+    }
+}
+
+#ifdef SIMD_X86
+static void skinmeshsse2(const skinverts &v, const dualquat *bdata1, const dualquat *bdata2, int blendoffset, uchar *dst, int stride, int normoffset)
+{
+    bool normals = normoffset >= 0;
+    float out[skinverts::NUMCOORDS][SKINBLOCK];
+    loopi(v.numblocks)
+    {
+        const float *c = v.block(i);
+        const int *bones = &v.bones[i*SKINBLOCK];
+        for(int half = 0; half < SKINBLOCK; half += 4)
+        {
+            const dualquat *b[4];
+            loopj(4) b[j] = &(bones[half+j] < blendoffset ? bdata1 : bdata2)[bones[half+j]];
+            __m128 rx = _mm_loadu_ps(&b[0]->real.x), ry = _mm_loadu_ps(&b[1]->real.x),
+                   rz = _mm_loadu_ps(&b[2]->real.x), rw = _mm_loadu_ps(&b[3]->real.x),
+                   dx = _mm_loadu_ps(&b[0]->dual.x), dy = _mm_loadu_ps(&b[1]->dual.x),
+                   dz = _mm_loadu_ps(&b[2]->dual.x), dw = _mm_loadu_ps(&b[3]->dual.x);
+            _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+            _MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+            __m128 px = _mm_loadu_ps(&c[skinverts::POS_X*SKINBLOCK + half]),
+                   py = _mm_loadu_ps(&c[skinverts::POS_Y*SKINBLOCK + half]),
+                   pz = _mm_loadu_ps(&c[skinverts::POS_Z*SKINBLOCK + half]),
+                   nx = _mm_loadu_ps(&c[skinverts::NORM_X*SKINBLOCK + half]),
+                   ny = _mm_loadu_ps(&c[skinverts::NORM_Y*SKINBLOCK + half]),
+                   nz = _mm_loadu_ps(&c[skinverts::NORM_Z*SKINBLOCK + half]);
+            __m128 opx, opy, opz, onx = nx, ony = ny, onz = nz;
+            SKINTRANSFORM(__m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps);
+            _mm_storeu_ps(&out[0][half], opx);
+            _mm_storeu_ps(&out[1][half], opy);
+            _mm_storeu_ps(&out[2][half], opz);
+            _mm_storeu_ps(&out[3][half], onx);
+            _mm_storeu_ps(&out[4][half], ony);
+            _mm_storeu_ps(&out[5][half], onz);
+        }
+        storeskinned(out, min(SKINBLOCK, v.numverts - i*SKINBLOCK), dst + i*SKINBLOCK*stride, stride, normoffset);
+    }
+}
+
+SIMD_TARGET_AVX2
+static void skinmeshavx2(const skinverts &v, const dualquat *bdata1, const dualquat *bdata2, int blendoffset, uchar *dst, int stride, int normoffset)
+{
+    bool normals = normoffset >= 0;
+    float out[skinverts::NUMCOORDS][SKINBLOCK];
+    loopi(v.numblocks)
+    {
+        const float *c = v.block(i);
+        const int *bones = &v.bones[i*SKINBLOCK];
+        // a dual quaternion is eight floats, so the bones of a block transpose into one vector per component
+        __m256 q[8];
+        loopj(8) q[j] = _mm256_loadu_ps(&(bones[j] < blendoffset ? bdata1 : bdata2)[bones[j]].real.x);
+        __m256 t0 = _mm256_unpacklo_ps(q[0], q[1]), t1 = _mm256_unpackhi_ps(q[0], q[1]),
+               t2 = _mm256_unpacklo_ps(q[2], q[3]), t3 = _mm256_unpackhi_ps(q[2], q[3]),
+               t4 = _mm256_unpacklo_ps(q[4], q[5]), t5 = _mm256_unpackhi_ps(q[4], q[5]),
+               t6 = _mm256_unpacklo_ps(q[6], q[7]), t7 = _mm256_unpackhi_ps(q[6], q[7]);
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+               s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+               s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2)),
+               s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 rx = _mm256_permute2f128_ps(s0, s4, 0x20), ry = _mm256_permute2f128_ps(s1, s5, 0x20),
+               rz = _mm256_permute2f128_ps(s2, s6, 0x20), rw = _mm256_permute2f128_ps(s3, s7, 0x20),
+               dx = _mm256_permute2f128_ps(s0, s4, 0x31), dy = _mm256_permute2f128_ps(s1, s5, 0x31),
+               dz = _mm256_permute2f128_ps(s2, s6, 0x31), dw = _mm256_permute2f128_ps(s3, s7, 0x31);
+        __m256 px = _mm256_loadu_ps(&c[skinverts::POS_X*SKINBLOCK]),
+               py = _mm256_loadu_ps(&c[skinverts::POS_Y*SKINBLOCK]),
+               pz = _mm256_loadu_ps(&c[skinverts::POS_Z*SKINBLOCK]),
+               nx = _mm256_loadu_ps(&c[skinverts::NORM_X*SKINBLOCK]),
+               ny = _mm256_loadu_ps(&c[skinverts::NORM_Y*SKINBLOCK]),
+               nz = _mm256_loadu_ps(&c[skinverts::NORM_Z*SKINBLOCK]);
+        __m256 opx, opy, opz, onx = nx, ony = ny, onz = nz;
+        SKINTRANSFORM(__m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps);
+        _mm256_storeu_ps(out[0], opx);
+        _mm256_storeu_ps(out[1], opy);
+        _mm256_storeu_ps(out[2], opz);
+        _mm256_storeu_ps(out[3], onx);
+        _mm256_storeu_ps(out[4], ony);
+        _mm256_storeu_ps(out[5], onz);
+        storeskinned(out, min(SKINBLOCK, v.numverts - i*SKINBLOCK), dst + i*SKINBLOCK*stride, stride, normoffset);
+    }
+}
+#endif
+
+void skinmesh(int path, const skinverts &v, const dualquat *bdata1, const dualquat *bdata2, int blendoffset, uchar *dst, int stride, int normoffset)
+{
+#ifdef SIMD_X86
+    if(path >= SKIN_AVX2) skinmeshavx2(v, bdata1, bdata2, blendoffset, dst, stride, normoffset);
+    else skinmeshsse2(v, bdata1, bdata2, blendoffset, dst, stride, normoffset);
+#endif
+}
+
+#ifdef SIMD_X86
+/// Sum of all four lanes in every lane.
+static inline __m128 hsum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+#endif
+
+void blendskinbones(int path, dualquat &d, const dualquat *bdata, const float *weights, const uchar *bones, bool normalize)
+{
+#ifdef SIMD_X86
+    const dualquat &b0 = bdata[bones[0]];
+    __m128 w = _mm_set1_ps(weights[0]);
+    __m128 real = _mm_mul_ps(_mm_loadu_ps(&b0.real.x), w), dual = _mm_mul_ps(_mm_loadu_ps(&b0.dual.x), w);
+    for(int k = 1; k < 4 && weights[k]; k++)
+    {
+        const dualquat &b = bdata[bones[k]];
+        __m128 breal = _mm_loadu_ps(&b.real.x);
+        // flip antipodal bones, like dualquat::accumulate()
+        __m128 sign = _mm_and_ps(_mm_cmplt_ps(hsum(_mm_mul_ps(real, breal)), _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+        w = _mm_xor_ps(_mm_set1_ps(weights[k]), sign);
+        real = _mm_add_ps(real, _mm_mul_ps(breal, w));
+        dual = _mm_add_ps(dual, _mm_mul_ps(_mm_loadu_ps(&b.dual.x), w));
+    }
+    if(normalize)
+    {
+        __m128 invlen = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(hsum(_mm_mul_ps(real, real))));
+        real = _mm_mul_ps(real, invlen);
+        dual = _mm_mul_ps(dual, invlen);
+    }
+    _mm_storeu_ps(&d.real.x, real);
+    _mm_storeu_ps(&d.dual.x, dual);
+#endif
+}
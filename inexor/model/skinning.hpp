@@ -0,0 +1,47 @@
+/// SIMD kernels to skin skeletal models on the CPU, used if GPU skinning is not available or disabled.
+
+#pragma once
+
+#include "inexor/shared/cube_types.hpp"  // for uchar
+#include "inexor/shared/geom.hpp"        // for dualquat, vec
+#include "inexor/shared/simd.hpp"        // for SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2
+
+/// Vertices are skinned in blocks of this many, the width of the AVX2 kernel.
+#define SKINBLOCK 8
+
+enum { SKIN_SCALAR = SIMD_SCALAR, SKIN_SSE2 = SIMD_SSE2, SKIN_AVX2 = SIMD_AVX2, NUMSKINPATHS };
+
+/// Positions and normals of a skeletal mesh in blocks of SKINBLOCK vertices.
+/// Every coordinate of a block has its own run of floats (x of all positions, then y, ...),
+/// so the kernels load them as whole vectors.
+struct skinverts
+{
+    enum { POS_X = 0, POS_Y, POS_Z, NORM_X, NORM_Y, NORM_Z, NUMCOORDS };
+
+    int numverts, numblocks;
+    float *coords;
+    int *bones; ///< index of the (blended) bone of every vertex
+
+    skinverts() : numverts(0), numblocks(0), coords(nullptr), bones(nullptr) {}
+    ~skinverts() { clear(); }
+
+    void clear();
+    /// Make room for n vertices; the last block gets padded with copies of vertex n-1 by set().
+    void alloc(int n);
+    void set(int i, const vec &pos, const vec &norm, int bone);
+
+    const float *block(int b) const { return &coords[b*NUMCOORDS*SKINBLOCK]; }
+};
+
+/// The fastest kernel this cpu supports, but none faster than the skinsimd variable allows.
+extern int skinpath();
+extern const char *skinpathname(int path);
+
+/// Transform the positions (and unless normoffset is negative the normals) of v with their bones and
+/// write them to the vertex array dst with stride bytes per vertex.
+/// Bones below blendoffset come from bdata1, all others from bdata2 (see skelmesh::interpverts()).
+extern void skinmesh(int path, const skinverts &v, const dualquat *bdata1, const dualquat *bdata2, int blendoffset,
+                     uchar *dst, int stride, int normoffset);
+
+/// Blend up to four weighted bones into d, the SIMD counterpart of skelmeshgroup::blendbones().
+extern void blendskinbones(int path, dualquat &d, const dualquat *bdata, const float *weights, const uchar *bones, bool normalize);
@@ -79,7 +79,7 @@ void set_on_change_functions()
         {
             {{namespace}}::TreeEvent val;
             val.set_{{name_unique}}(newvalue);
-            inexor::rpc::RpcServer<{{namespace}}::TreeEvent, {{namespace}}::TreeService::AsyncService>::send_msg(std::move(val));
+            inexor::rpc::RpcServer<{{namespace}}::TreeEvent, {{namespace}}::TreeService::AsyncService>::send_var(std::move(val));
         }
     );
 {{/shared_vars}}
@@ -10,6 +10,9 @@
 #include <functional>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
 
 #include <grpc/grpc.h>
 #include <grpc++/grpc++.h>
@@ -39,6 +42,57 @@ bool handle_index(int index, const MSG_TYPE &tree_event);
 
 #define MAX_RPC_EVENT_CHECKS_PER_TICK 100
 #define MAX_RPC_CLIENTS 128 // possible highest value is 255, see encode_signal()
+#define RPC_POLL_MS 2 // how long the network thread waits for grpc events before it looks for new changes to send
+
+/// Hands batches of items from one thread to another without locking.
+/// Any thread may push, one thread takes everything pushed so far at once, in the order it got pushed.
+template<typename T>
+class lockfree_handoff
+{
+    struct node
+    {
+        std::vector<T> items;
+        node *next;
+    };
+    std::atomic<node *> head{nullptr};
+
+public:
+    ~lockfree_handoff()
+    {
+        std::vector<T> rest;
+        take(rest);
+    }
+
+    void push(std::vector<T> &&items)
+    {
+        if(items.empty()) return;
+        node *n = new node{std::move(items), head.load(std::memory_order_relaxed)};
+        while(!head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /// Append all batches pushed so far to out.
+    /// @return whether there were any.
+    bool take(std::vector<T> &out)
+    {
+        node *n = head.exchange(nullptr, std::memory_order_acquire), *ordered = nullptr;
+        while(n) // the newest batch is on top, reverse into push order
+        {
+            node *next = n->next;
+            n->next = ordered;
+            ordered = n;
+            n = next;
+        }
+        if(!ordered) return false;
+        while(ordered)
+        {
+            for(T &item : ordered->items) out.push_back(std::move(item));
+            node *next = ordered->next;
+            delete ordered;
+            ordered = next;
+        }
+        return true;
+    }
+};
 
 /// The events we request GRPC to do.
 enum EVENT_TYPE
@@ -111,6 +165,7 @@ public:
 
         /// Add message to the queue of to-be-sent messages.
         void write(const MSG_TYPE &msg)        { outstanding_writes.push(msg); }
+        void write(MSG_TYPE &&msg)             { outstanding_writes.push(std::move(msg)); }
 
         /// Whether or not writes are outstanding.
         bool has_writes()                { return !outstanding_writes.size(); }
@@ -131,31 +186,65 @@ public:
 private:
     /// Client which isn't connected yet, a buffer caused by the async API.
     std::unique_ptr<stream_type> connect_slot;
+
+    /// Changes made by the game during the current tick, sent as one batch by flush_changes().
+    static std::vector<MSG_TYPE> pending_changes;
+    /// Position of the queued change of each global variable in pending_changes, by its index in the tree.
+    static std::unordered_map<int64, size_t> pending_var_changes;
+
+    /// Batches of changes from the game thread to the network thread.
+    static lockfree_handoff<MSG_TYPE> outgoing;
+    /// Changes clients made, from the network thread to the game thread.
+    lockfree_handoff<MSG_TYPE> incoming;
+
+    /// Once initialized the completion queue gets handled by this thread.
+    std::thread network_thread;
+    std::atomic<bool> stop_network_thread{false};
 public:
     std::string server_address;
 
     RpcServer(const char *address);
     ~RpcServer();
 
-    /// This is essentially doing the sending/receiving.
-    /// Quits if there are no more values to send and we don't receive anything anymore or if MAX_RPC_EVENT_CHECKS_PER_TICK is reached.
-    /// In case of errors it throws a std::exception (TODO).
+    /// Called every tick on the game thread: applies the changes clients made and hands the changes of this tick to the network thread.
     void process_queue();
 
-    /// This is used during the startup, we process_queue() until we receive a special event.
+    /// This is used during the startup, we handle the completion queue until we receive a special event.
     /// After 10 seconds of not receiving this event it throws a runtime error.
     void block_until_initialized();
 
-    /// Send any variable changes in the core to all clients.
-    /// For broadcasting purpose param excluded_id is given: you don't want to send back a change you just received from a client.
-    static void send_msg(const MSG_TYPE &msg, int excluded_id = -1)
+    /// Handle the completion queue on the network thread from now on, see network_loop().
+    void start_network_thread();
+
+    /// Queue a message for all clients, it gets sent together with the other changes of this tick.
+    /// Only to be called from the game thread.
+    static void send_msg(MSG_TYPE &&msg)
     {
-        for(clienthandler &ci: clients)
+        pending_changes.push_back(std::move(msg));
+    }
+
+    /// Queue the new value of a global variable, replacing any value of it queued earlier in this tick.
+    /// Only to be called from the game thread.
+    static void send_var(MSG_TYPE &&msg)
+    {
+        auto queued = pending_var_changes.find(msg.key_case());
+        if(queued != pending_var_changes.end()) pending_changes[queued->second] = std::move(msg);
+        else
         {
-            if(ci.id != excluded_id) ci.write(msg);
+            pending_var_changes.emplace(msg.key_case(), pending_changes.size());
+            pending_changes.push_back(std::move(msg));
         }
     }
 
+    /// Hand the changes of this tick to the network thread.
+    static void flush_changes()
+    {
+        if(pending_changes.empty()) return;
+        outgoing.push(std::move(pending_changes));
+        pending_changes.clear();
+        pending_var_changes.clear();
+    }
+
 
 private:
 
@@ -176,6 +265,16 @@ private:
 
     void kickoff_writes();
 
+    /// Send a change from one client to all others.
+    void broadcast(const MSG_TYPE &msg, int excluded_id)
+    {
+        for(clienthandler &ci: clients)
+            if(ci.id != excluded_id) ci.write(msg);
+    }
+
+    /// The network thread: sends the batches of changes the game made and waits for grpc events meanwhile.
+    void network_loop();
+
     void handle_queue_event(callback_event *encoded_callback, bool broadcast, std::function<void(const MSG_TYPE &)> receive_handler);
 
     int pick_unused_id();
@@ -204,7 +303,10 @@ void RpcServer<MSG_TYPE, U>::clienthandler::request_send_one()
     if(writer_busy || has_writes()) return;
     writer_busy = true;
     const void* cq_id = encode_signal(EVENT_TYPE::E_WRITE, id);
-    stream->Write(outstanding_writes.front(), (void *)cq_id);
+    // let grpc put the messages of a batch into as few network packets as possible, the last one flushes
+    grpc::WriteOptions options;
+    if(outstanding_writes.size() > 1) options.set_buffer_hint();
+    stream->Write(outstanding_writes.front(), options, (void *)cq_id);
     outstanding_writes.pop();
 }
 
@@ -245,6 +347,11 @@ RpcServer<MSG_TYPE, U>::RpcServer(const char *address) : server_address(address)
 template<typename MSG_TYPE, typename U> inline
 RpcServer<MSG_TYPE, U>::~RpcServer()
 {
+    if(network_thread.joinable())
+    {
+        stop_network_thread = true;
+        network_thread.join();
+    }
 	// TODO we should also receive whether disconnect was successfully
     for(auto &client : clients) client.request_disconnect();
     grpc_server->Shutdown();
@@ -313,34 +420,57 @@ void RpcServer<MSG_TYPE, U>::kickoff_writes()
 template<typename MSG_TYPE, typename U> inline
 void RpcServer<MSG_TYPE, U>::process_queue()
 {
-    kickoff_writes();
+    std::vector<MSG_TYPE> received;
+    if(incoming.take(received))
+        for(const MSG_TYPE &msg : received) change_variable(msg);
+    flush_changes();
+}
+
+template<typename MSG_TYPE, typename U> inline
+void RpcServer<MSG_TYPE, U>::start_network_thread()
+{
+    if(!network_thread.joinable()) network_thread = std::thread([this] { network_loop(); });
+}
 
+template<typename MSG_TYPE, typename U> inline
+void RpcServer<MSG_TYPE, U>::network_loop()
+{
     using grpc::CompletionQueue;
 
-    for(int i = 0; i < MAX_RPC_EVENT_CHECKS_PER_TICK; i++)
+    std::vector<MSG_TYPE> sending, received;
+    while(!stop_network_thread)
     {
-        callback_event *callback_value;
-        bool no_internal_grpc_error = false;
-
-        // read the next event from the completion queue (in nonblocking fashion)
-        // TODO: adapt blocking time to the time budget and whether or not writes are outstanding
-        CompletionQueue::NextStatus stat = cq->AsyncNext((void **)(&callback_value), &no_internal_grpc_error, gpr_inf_past(GPR_CLOCK_REALTIME));
-
-        //if(!) break;// throw std::runtime_error("GRPC had an internal error: Shutting down.");
-
-        if(no_internal_grpc_error && stat == CompletionQueue::NextStatus::GOT_EVENT)
-            handle_queue_event(callback_value, true, [=](const MSG_TYPE &msg) {
-                    this->change_variable(msg);
-                });
-        else if(stat == CompletionQueue::NextStatus::TIMEOUT)
+        if(outgoing.take(sending))
         {
-            if(!any_writes_outstanding()) break;
+            for(clienthandler &ci : clients)
+                for(const MSG_TYPE &msg : sending) ci.write(msg);
+            sending.clear();
         }
-        else if(stat == CompletionQueue::NextStatus::SHUTDOWN)
+        kickoff_writes();
+
+        for(int i = 0; i < MAX_RPC_EVENT_CHECKS_PER_TICK; i++)
         {
-            std::string error_message("[GRPC Server] Completion Queue Shutdown status received..");
-            throw std::runtime_error(error_message);
+            callback_event *callback_value;
+            bool no_internal_grpc_error = false;
+
+            // only the first check waits, so new changes of the game get picked up soon
+            gpr_timespec deadline = i ? gpr_inf_past(GPR_CLOCK_REALTIME) :
+                gpr_time_add(gpr_now(GPR_CLOCK_REALTIME), gpr_time_from_millis(RPC_POLL_MS, GPR_TIMESPAN));
+            CompletionQueue::NextStatus stat = cq->AsyncNext((void **)(&callback_value), &no_internal_grpc_error, deadline);
+
+            if(no_internal_grpc_error && stat == CompletionQueue::NextStatus::GOT_EVENT)
+                handle_queue_event(callback_value, true, [&](const MSG_TYPE &msg) {
+                        received.push_back(msg);
+                    });
+            else if(stat == CompletionQueue::NextStatus::TIMEOUT) break;
+            else if(stat == CompletionQueue::NextStatus::SHUTDOWN)
+            {
+                Log.sync->error("[GRPC Server] Completion Queue Shutdown status received..");
+                return;
+            }
         }
+        incoming.push(std::move(received));
+        received.clear();
     }
 }
 
@@ -394,7 +524,7 @@ void RpcServer<MSG_TYPE, U>::handle_queue_event(callback_event *encoded_callback
         const MSG_TYPE msg = ci->get_read_result();
         ci->request_read();
         receive_handler(msg);
-        if(broadcast) send_msg(msg, ci->id); //broadcast changes from one client to other clients.
+        if(broadcast) this->broadcast(msg, ci->id); //broadcast changes from one client to other clients.
         break;
     }
     case E_WRITE:
@@ -452,5 +582,14 @@ bool RpcServer<MSG_TYPE, U>::change_variable(const MSG_TYPE &receivedval)
 }
 
 
+template<typename MSG_TYPE, typename U>
+std::vector<MSG_TYPE> RpcServer<MSG_TYPE, U>::pending_changes;
+
+template<typename MSG_TYPE, typename U>
+std::unordered_map<int64, size_t> RpcServer<MSG_TYPE, U>::pending_var_changes;
+
+template<typename MSG_TYPE, typename U>
+lockfree_handoff<MSG_TYPE> RpcServer<MSG_TYPE, U>::outgoing;
+
 } // namespace inexor
 } // namespace rpc
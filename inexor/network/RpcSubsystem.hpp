@@ -41,6 +41,7 @@ public:
         Log.sync->info("RPC server listening on {0}", serv->server_address);
         set_on_change_functions();
         serv->block_until_initialized();
+        serv->start_network_thread();
     }
 
     virtual void tick() override
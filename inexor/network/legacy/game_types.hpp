@@ -12,8 +12,9 @@
 #define MAX_POSSIBLE_PORT 65535 /// The max port possible for UDP
 
 #define PROTOCOL_VERSION 303            // bump when protocol changes last sauerbraten protocol was 259
-#define DEMO_VERSION 1                  // bump when demo format changes
+#define DEMO_VERSION 2                  // bump when demo format changes
 #define DEMO_MAGIC "INEXOR_DEMO"
+#define DEMO_INDEX_MAGIC "DIDX"
 
 
 inline int lan_info_port() { return INEXOR_LANINFO_PORT; }
@@ -165,6 +166,14 @@ enum
     N_SERVCMD,              /// S2C      servers could send advanced messages to clients. standard clients do not interpret this custom message
     N_DEMOPACKET,           /// S2C      send a requested demo packet
     N_SPAWNLOC,             /// S2C      BOMBERMAN spawn location?
+
+                            // delta compressed positions (only used if negotiated, see position_codec.hpp)
+    N_POSFRAME,             /// S2C      frame number of the following N_POSDELTA messages
+    N_POSDELTA,             /// S2C      delta compressed player position
+    N_POSACK,               /// C2S      acknowledge the last received position frame
+
+    N_SEEKDEMO,             /// C2S      jump to a time in the demo being played back
+    N_GETDEMOFROM,          /// C2S      a client requests to download a demo starting at a given time
     NUMMSG
 };
 
@@ -197,6 +206,8 @@ static const int msgsizes[] =
     N_SERVCMD, 0,
     N_DEMOPACKET, 0,
     N_SPAWNLOC, 0,
+    N_POSFRAME, 2, N_POSDELTA, 0, N_POSACK, 2,
+    N_SEEKDEMO, 2, N_GETDEMOFROM, 3,
     -1
 };
 
@@ -219,6 +230,21 @@ struct demoheader
     int version, protocol;
 };
 
+/// Demos are a chain of gzip members: the first one only holds the demoheader,
+/// every following one starts with a keyframe (a full state snapshot) so it can be decoded on its own.
+/// An uncompressed index of all keyframes is appended after the last member:
+/// numkeyframes demokeyframe entries followed by a demoindexfooter.
+struct demokeyframe
+{
+    int millis, offset; ///< game time of the snapshot and file offset of its gzip member
+};
+
+struct demoindexfooter
+{
+    int numkeyframes;
+    char magic[4];
+};
+
 
 enum { DISC_NONE = 0, DISC_EOP, DISC_KICK, DISC_MSGERR, DISC_IPBAN, DISC_PRIVATE, DISC_MAXCLIENTS, DISC_TIMEOUT, DISC_OVERFLOW, DISC_PASSWORD, DISC_NUM };
 
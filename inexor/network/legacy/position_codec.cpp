@@ -0,0 +1,155 @@
+#include "inexor/network/legacy/cube_network.hpp"     // for putint, getuint
+#include "inexor/network/legacy/game_types.hpp"       // for ::N_POSDELTA
+#include "inexor/network/legacy/position_codec.hpp"
+#include "inexor/shared/cube_loops.hpp"               // for loopi, loopk
+#include "inexor/shared/tools.hpp"                    // for min
+
+bool getposition(ucharbuf &p, positionstate &s)
+{
+    s.cn = getuint(p);
+    s[positionstate::PHYSSTATE] = p.get();
+    uint flags = getuint(p);
+    s[positionstate::FLAGS] = flags;
+    loopk(3)
+    {
+        int n = p.get();
+        n |= p.get()<<8;
+        if(flags&(1<<k))
+        {
+            n |= p.get()<<16;
+            if(n&0x800000) n |= -1<<24;
+        }
+        s[positionstate::O_X+k] = n;
+    }
+    int dir = p.get(); dir |= p.get()<<8;
+    s[positionstate::DIR] = dir;
+    s[positionstate::ROLL] = p.get();
+    int vel = p.get(); if(flags&(1<<3)) vel |= p.get()<<8;
+    s[positionstate::VEL] = vel;
+    int veldir = p.get(); veldir |= p.get()<<8;
+    s[positionstate::VELDIR] = veldir;
+    int fall = 0, falldir = 0;
+    if(flags&(1<<4))
+    {
+        fall = p.get(); if(flags&(1<<5)) fall |= p.get()<<8;
+        if(flags&(1<<6)) { falldir = p.get(); falldir |= p.get()<<8; }
+    }
+    s[positionstate::FALL] = fall;
+    s[positionstate::FALLDIR] = falldir;
+    return !p.overread();
+}
+
+namespace {
+
+/// Packs values of arbitrary bit width into bytes, lowest bits first.
+struct bitwriter
+{
+    vector<uchar> &buf;
+    uint bits;
+    int numbits;
+
+    bitwriter(vector<uchar> &buf) : buf(buf), bits(0), numbits(0) {}
+
+    void put(uint val, int n)
+    {
+        loopi(n)
+        {
+            bits |= ((val>>i)&1) << numbits;
+            if(++numbits == 8) flush();
+        }
+    }
+
+    void flush()
+    {
+        if(!numbits) return;
+        buf.add(uchar(bits));
+        bits = 0;
+        numbits = 0;
+    }
+};
+
+struct bitreader
+{
+    ucharbuf &buf;
+    uint bits;
+    int numbits;
+
+    bitreader(ucharbuf &buf) : buf(buf), bits(0), numbits(0) {}
+
+    uint get(int n)
+    {
+        uint val = 0;
+        loopi(n)
+        {
+            if(!numbits) { bits = buf.get(); numbits = 8; }
+            val |= (bits&1) << i;
+            bits >>= 1;
+            numbits--;
+        }
+        return val;
+    }
+};
+
+/// Fields are sent as: changed bit, 5 bit width, zigzag encoded difference of that width.
+void putfield(bitwriter &w, int val, int base)
+{
+    if(val == base) { w.put(0, 1); return; }
+    int diff = val - base;
+    uint zigzag = (uint(diff) << 1) ^ uint(diff >> 31);
+    int width = 1;
+    while(width < 32 && zigzag >> width) width++;
+    w.put(1, 1);
+    w.put(width-1, 5);
+    w.put(zigzag, width);
+}
+
+int getfield(bitreader &r, int base)
+{
+    if(!r.get(1)) return base;
+    int width = r.get(5) + 1;
+    uint zigzag = r.get(width);
+    return base + int((zigzag >> 1) ^ (0U - (zigzag & 1)));
+}
+
+const positionstate nullstate;
+
+} // anonymous namespace
+
+bool putpositiondelta(vector<uchar> &p, positionhistory &h, const positionstate &s, int frame, const positionacks &acks, int keyframeinterval)
+{
+    const positionstate *base = nullptr;
+    int age = 0;
+    if(h.keyframe >= 0 && (keyframeinterval <= 0 || frame - h.keyframe < keyframeinterval))
+    {
+        for(int f = min(acks.newest, frame-1); f > frame - POSHISTORY && f >= h.keyframe; f--)
+        {
+            if(!acks.has(f)) continue;
+            base = h.find(f);
+            if(base) { age = frame - f; break; }
+        }
+    }
+    if(!base)
+    {
+        base = &nullstate;
+        h.keyframe = frame;
+    }
+    putint(p, N_POSDELTA);
+    putuint(p, s.cn);
+    p.add(uchar(age));
+    bitwriter w(p);
+    loopi(positionstate::NUMFIELDS) putfield(w, s[i], (*base)[i]);
+    w.flush();
+    h.add(frame, s);
+    return !age;
+}
+
+bool getpositiondelta(ucharbuf &p, positionhistory &h, int frame, positionstate &s)
+{
+    int age = p.get();
+    const positionstate *base = age ? h.find(frame - age) : &nullstate;
+    bitreader r(p);
+    loopi(positionstate::NUMFIELDS) s[i] = getfield(r, base ? (*base)[i] : 0);
+    if(!base || p.overread()) return false;
+    h.add(frame, s);
+    return true;
+}
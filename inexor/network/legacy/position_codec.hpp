@@ -0,0 +1,109 @@
+#pragma once
+/// Delta compression of player positions (N_POS).
+///
+/// Instead of relaying the absolute position of every player every tick, the server can send clients
+/// which opted in (see "poscodec" below) bit-packed deltas against the last state they acknowledged.
+/// Every packet starts with N_POSFRAME (the frame number), followed by N_POSDELTA messages.
+/// The client acks the last frame it received with N_POSACK. Only acked frames serve as baselines, since
+/// several frames go out between two acks and any of them may have been lost. If there is none (new player, packet loss for too long) a keyframe is sent, which is
+/// a delta against the all zero state.
+///
+/// The protocol is negotiated: the server offers it via N_SERVCMD "poscodec <version>" right after
+/// N_SERVINFO and clients accept by sending the same string back. Legacy clients ignore N_SERVCMD.
+
+#include "inexor/network/legacy/buffer_types.hpp"  // for ucharbuf
+#include "inexor/shared/cube_loops.hpp"            // for loopi
+#include "inexor/shared/cube_types.hpp"            // for uchar, uint
+#include "inexor/shared/cube_vector.hpp"           // for vector
+
+#define POSCODEC_VERSION 1
+/// How many frames of sent positions we remember. Older baselines cause a keyframe.
+#define POSHISTORY 16
+/// Upper bound for the size of a N_POSDELTA message (11 fields with 38 bits each, plus header).
+#define MAXPOSDELTALEN 64
+
+/// The (quantized) contents of a N_POS message.
+struct positionstate
+{
+    enum
+    {
+        O_X = 0, O_Y, O_Z,  /// position, multiplied by DMF
+        PHYSSTATE,          /// phys state, life sequence bit, move and strafe
+        FLAGS,              /// N_POS flags, only the material and the falling direction bits are relevant
+        DIR,                /// yaw + pitch*360
+        ROLL,
+        VEL,                /// velocity magnitude and direction
+        VELDIR,
+        FALL,               /// falling magnitude and direction
+        FALLDIR,
+        NUMFIELDS
+    };
+
+    int cn;
+    int fields[NUMFIELDS];
+
+    positionstate() : cn(-1) { loopi(NUMFIELDS) fields[i] = 0; }
+
+    int &operator[](int i) { return fields[i]; }
+    int operator[](int i) const { return fields[i]; }
+};
+
+/// The last positions of a single player we sent to (or received from) someone, indexed by frame.
+struct positionhistory
+{
+    positionstate states[POSHISTORY];
+    int frames[POSHISTORY];
+    int keyframe;
+
+    positionhistory() : keyframe(-1) { loopi(POSHISTORY) frames[i] = -1; }
+
+    const positionstate *find(int frame) const
+    {
+        return frame >= 0 && frames[frame%POSHISTORY] == frame ? &states[frame%POSHISTORY] : nullptr;
+    }
+
+    void add(int frame, const positionstate &s)
+    {
+        frames[frame%POSHISTORY] = frame;
+        states[frame%POSHISTORY] = s;
+    }
+};
+
+/// The frames a client acknowledged: the newest one and a bit for each of the 31 frames before it.
+struct positionacks
+{
+    int newest;
+    uint mask; ///< bit i stands for frame newest-i
+
+    positionacks() : newest(-1), mask(0) {}
+
+    void add(int frame)
+    {
+        if(frame < 0) return;
+        if(frame > newest)
+        {
+            mask = newest >= 0 && frame - newest < 32 ? mask << (frame - newest) : 0;
+            newest = frame;
+        }
+        if(newest - frame < 32) mask |= 1U << (newest - frame);
+    }
+
+    bool has(int frame) const { return frame >= 0 && frame <= newest && newest - frame < 32 && mask&(1U << (newest - frame)); }
+};
+
+/// Parse a legacy N_POS message (without the message type).
+/// @return false if the message was truncated.
+extern bool getposition(ucharbuf &p, positionstate &s);
+
+/// Append a N_POSDELTA message for s to p.
+/// The baseline is the newest state in h of a frame in acks which is younger than POSHISTORY frames.
+/// A keyframe is sent if there is none or the last one is keyframeinterval frames ago.
+/// @return whether a keyframe was written.
+extern bool putpositiondelta(vector<uchar> &p, positionhistory &h, const positionstate &s, int frame, const positionacks &acks, int keyframeinterval);
+
+/// Parse a N_POSDELTA message (after the clientnumber) and remember the result in h.
+/// @return false if the baseline is unknown (the message is skipped then).
+extern bool getpositiondelta(ucharbuf &p, positionhistory &h, int frame, positionstate &s);
+
+/// Frames get transmitted as single byte, this restores the full frame number closest to (below) reference.
+inline int unwrapframe(int frame, int reference) { return reference - ((reference - frame) & 0xFF); }
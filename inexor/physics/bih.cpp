@@ -1,21 +1,55 @@
 #include <boost/algorithm/clamp.hpp>      // for clamp
 #include <limits.h>                       // for INT_MAX, INT_MIN, SHRT_MAX
 #include <string.h>                       // for memcpy
-#include <algorithm>                      // for max, min, swap
+#include <algorithm>                      // for max, min, swap, nth_element
+#include <chrono>                         // for steady_clock
 
 #include "inexor/engine/lightmap.hpp"     // for lightmapping
+#include "inexor/io/Logging.hpp"          // for Log, Logger
 #include "inexor/model/model.hpp"         // for model
-#include "inexor/model/rendermodel.hpp"   // for loadmapmodel
+#include "inexor/model/rendermodel.hpp"   // for loadmapmodel, getmminfo
+#include "inexor/network/SharedVar.hpp"   // for SharedVar
 #include "inexor/physics/bih.hpp"         // for BIH::mesh, BIH, BIH::node
 #include "inexor/physics/physics.hpp"     // for ::RAY_SHADOW, ::RAY_ALPHAPOLY
+#include "inexor/shared/command.hpp"      // for VARP, COMMAND
 #include "inexor/shared/cube_loops.hpp"   // for i, loopi, k, j, loopj, loopk
 #include "inexor/shared/cube_types.hpp"   // for ushort, uchar
 #include "inexor/shared/cube_vector.hpp"  // for vector
 #include "inexor/shared/ents.hpp"         // for extentity, ::EF_NOCOLLIDE
 #include "inexor/shared/geom.hpp"         // for vec, ivec, vec::(anonymous ...
+#include "inexor/shared/simd.hpp"         // for cpusimd, SIMD_X86
 #include "inexor/shared/tools.hpp"        // for max, min, clamp, swap
 #include "inexor/texture/texture.hpp"     // for Texture, loadalphamask
 
+/// Tree and kernel for ray tests against mapmodels: 0 binary tree, 1 wide tree, 2 wide tree with SSE2.
+/// Mapmodels only build the tree picked when they get loaded and keep using it after changes.
+VARP(bihwide, 0, 2, 2);
+
+/// The fastest wide kernel the cpu supports.
+static int widepath()
+{
+#ifdef SIMD_X86
+    if(cpusimd() >= SIMD_SSE2) return BIH_WIDE_SSE2;
+#endif
+    return BIH_WIDE_SCALAR;
+}
+
+int bihpath()
+{
+    return min(int(bihwide), widepath());
+}
+
+bool BIH::alphatest(const mesh &m, int tidx, float v, float w, int mode)
+{
+    if(!(m.flags&MESH_ALPHA) || (mode&RAY_ALPHAPOLY)!=RAY_ALPHAPOLY || !(m.tex->alphamask || (lightmapping <= 1 && loadalphamask(m.tex)))) return true;
+    const tri &t = m.tris[tidx];
+    vec2 at = m.gettc(t.vert[0]), bt = m.gettc(t.vert[1]).sub(at).mul(v), ct = m.gettc(t.vert[2]).sub(at).mul(w);
+    at.add(bt).add(ct);
+    int si = clamp(int(m.tex->xs * at.x), 0, m.tex->xs-1),
+        ti = clamp(int(m.tex->ys * at.y), 0, m.tex->ys-1);
+    return (m.tex->alphamask[ti*((m.tex->xs+7)/8) + si/8] & (1<<(si%8))) != 0;
+}
+
 bool BIH::triintersect(const mesh &m, int tidx, const vec &mo, const vec &mray, float maxdist, float &dist, int mode)
 {
     const tri &t = m.tris[tidx];
@@ -42,14 +76,7 @@ bool BIH::triintersect(const mesh &m, int tidx, const vec &mo, const vec &mray,
         if(f > 0 || f < maxdist*det) return false;
     }
     float invdet = 1/det;
-    if(m.flags&MESH_ALPHA && (mode&RAY_ALPHAPOLY)==RAY_ALPHAPOLY && (m.tex->alphamask || (lightmapping <= 1 && loadalphamask(m.tex))))
-    {
-        vec2 at = m.gettc(t.vert[0]), bt = m.gettc(t.vert[1]).sub(at).mul(v*invdet), ct = m.gettc(t.vert[2]).sub(at).mul(w*invdet);
-        at.add(bt).add(ct);
-        int si = clamp(int(m.tex->xs * at.x), 0, m.tex->xs-1),
-            ti = clamp(int(m.tex->ys * at.y), 0, m.tex->ys-1);
-        if(!(m.tex->alphamask[ti*((m.tex->xs+7)/8) + si/8] & (1<<(si%8)))) return false;
-    }
+    if(!alphatest(m, tidx, v*invdet, w*invdet, mode)) return false;
     dist = f*invdet;
     return true;
 }
@@ -135,9 +162,200 @@ inline bool BIH::traverse(const mesh &m, const vec &o, const vec &ray, const vec
     }
 }
 
+/// Box and triangle tests of the wide trees, one lane after the other.
+struct widekernelscalar
+{
+    vec o, ray, invray;
+
+    widekernelscalar(const vec &o, const vec &ray, const vec &invray) : o(o), ray(ray), invray(invray) {}
+
+    /// Bit i of the result is set if the ray enters child i of n before tmax, at tnear[i].
+    int boxes(const BIH::widenode &n, float tmax, float tnear[BVHWIDTH]) const
+    {
+        int mask = 0;
+        loopi(n.numchildren)
+        {
+            float lo = 0, hi = tmax;
+            loopk(3)
+            {
+                float t1 = (n.bbmin[k][i] - o[k])*invray[k], t2 = (n.bbmax[k][i] - o[k])*invray[k];
+                lo = max(lo, min(t1, t2));
+                hi = min(hi, max(t1, t2));
+            }
+            tnear[i] = lo;
+            if(lo <= hi) mask |= 1<<i;
+        }
+        return mask;
+    }
+
+    /// Bit i of the result is set if the ray hits triangle i of b before tmax, at t[i] with the barycentrics v[i] and w[i].
+    /// Triangles facing away from the ray are skipped if cull is positive, the ones facing it if it is negative.
+    int tris(const BIH::triblock &b, float tmax, float cull, float t[BVHWIDTH], float v[BVHWIDTH], float w[BVHWIDTH]) const
+    {
+        int mask = 0;
+        loopi(BVHWIDTH)
+        {
+            vec a(b.a[0][i], b.a[1][i], b.a[2][i]), e1(b.b[0][i], b.b[1][i], b.b[2][i]), e2(b.c[0][i], b.c[1][i], b.c[2][i]),
+                n = vec().cross(e1, e2), r = vec(a).sub(o), e = vec().cross(r, ray);
+            float det = ray.dot(n);
+            if(!det || cull*det > 0) continue;
+            float sign = det < 0 ? -1 : 1, absdet = det*sign, lv = e.dot(e2)*sign, lw = -e.dot(e1)*sign, f = r.dot(n)*sign;
+            if(lv < 0 || lw < 0 || lv + lw > absdet || f < 0 || f > tmax*absdet) continue;
+            float invdet = 1/absdet;
+            t[i] = f*invdet;
+            v[i] = lv*invdet;
+            w[i] = lw*invdet;
+            mask |= 1<<i;
+        }
+        return mask;
+    }
+};
+
+#ifdef SIMD_X86
+/// The tests of widekernelscalar on all lanes at once.
+struct widekernelsse2
+{
+    __m128 o[3], ray[3], invray[3];
+
+    widekernelsse2(const vec &ro, const vec &rray, const vec &rinvray)
+    {
+        loopk(3)
+        {
+            o[k] = _mm_set1_ps(ro[k]);
+            ray[k] = _mm_set1_ps(rray[k]);
+            invray[k] = _mm_set1_ps(rinvray[k]);
+        }
+    }
+
+    int boxes(const BIH::widenode &n, float tmax, float tnear[BVHWIDTH]) const
+    {
+        __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(tmax);
+        loopk(3)
+        {
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.bbmin[k]), o[k]), invray[k]),
+                   t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.bbmax[k]), o[k]), invray[k]);
+            lo = _mm_max_ps(lo, _mm_min_ps(t1, t2));
+            hi = _mm_min_ps(hi, _mm_max_ps(t1, t2));
+        }
+        _mm_storeu_ps(tnear, lo);
+        return _mm_movemask_ps(_mm_cmple_ps(lo, hi)) & ((1<<n.numchildren)-1);
+    }
+
+    int tris(const BIH::triblock &b, float tmax, float cull, float t[BVHWIDTH], float v[BVHWIDTH], float w[BVHWIDTH]) const
+    {
+        __m128 ax = _mm_loadu_ps(b.a[0]), ay = _mm_loadu_ps(b.a[1]), az = _mm_loadu_ps(b.a[2]),
+               e1x = _mm_loadu_ps(b.b[0]), e1y = _mm_loadu_ps(b.b[1]), e1z = _mm_loadu_ps(b.b[2]),
+               e2x = _mm_loadu_ps(b.c[0]), e2y = _mm_loadu_ps(b.c[1]), e2z = _mm_loadu_ps(b.c[2]);
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y)),
+               ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z)),
+               nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+        __m128 rx = _mm_sub_ps(ax, o[0]), ry = _mm_sub_ps(ay, o[1]), rz = _mm_sub_ps(az, o[2]);
+        __m128 ex = _mm_sub_ps(_mm_mul_ps(ry, ray[2]), _mm_mul_ps(rz, ray[1])),
+               ey = _mm_sub_ps(_mm_mul_ps(rz, ray[0]), _mm_mul_ps(rx, ray[2])),
+               ez = _mm_sub_ps(_mm_mul_ps(rx, ray[1]), _mm_mul_ps(ry, ray[0]));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ray[0], nx), _mm_mul_ps(ray[1], ny)), _mm_mul_ps(ray[2], nz));
+        // flip everything to a positive determinant instead of testing both signs
+        __m128 sign = _mm_and_ps(det, _mm_set1_ps(-0.0f)), absdet = _mm_xor_ps(det, sign);
+        __m128 lv = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, e2x), _mm_mul_ps(ey, e2y)), _mm_mul_ps(ez, e2z)), sign),
+               lw = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, e1x), _mm_mul_ps(ey, e1y)), _mm_mul_ps(ez, e1z)), _mm_xor_ps(sign, _mm_set1_ps(-0.0f))),
+               f = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, nx), _mm_mul_ps(ry, ny)), _mm_mul_ps(rz, nz)), sign);
+        __m128 zero = _mm_setzero_ps(),
+               hit = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(absdet, zero), _mm_cmpge_ps(lv, zero)),
+                                _mm_and_ps(_mm_cmpge_ps(lw, zero), _mm_cmple_ps(_mm_add_ps(lv, lw), absdet)));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(f, zero), _mm_cmple_ps(f, _mm_mul_ps(_mm_set1_ps(tmax), absdet))));
+        hit = _mm_andnot_ps(_mm_cmpgt_ps(_mm_mul_ps(det, _mm_set1_ps(cull)), zero), hit);
+        int mask = _mm_movemask_ps(hit);
+        if(!mask) return 0;
+        __m128 invdet = _mm_div_ps(_mm_set1_ps(1), absdet);
+        _mm_storeu_ps(t, _mm_mul_ps(f, invdet));
+        _mm_storeu_ps(v, _mm_mul_ps(lv, invdet));
+        _mm_storeu_ps(w, _mm_mul_ps(lw, invdet));
+        return mask;
+    }
+};
+#endif
+
+/// Closest hit (any hit for shadow rays) of the ray in the kernel k with the wide tree of m, front to back.
+template<class K>
+static bool traversewide(const BIH::mesh &m, const K &k, float maxdist, float &dist, int mode)
+{
+    // median splits keep the trees balanced: 16 levels hold 4^16 triangles, more than a mesh may have
+    struct traversestate { int child; float tnear; } stack[16*(BVHWIDTH-1) + 1];
+    int stacksize = 0;
+    stack[stacksize++] = { 0, 0 };
+    float cull = 0;
+    if(!(mode&RAY_SHADOW) && m.flags&BIH::MESH_CULLFACE) cull = vec().cross(m.xform.a, m.xform.b).dot(m.xform.c) < 0 ? -1 : 1;
+    bool hit = false;
+    while(stacksize > 0)
+    {
+        traversestate cur = stack[--stacksize];
+        if(cur.tnear > maxdist) continue;
+        if(cur.child >= 0)
+        {
+            const BIH::widenode &n = m.widenodes[cur.child];
+            float tnear[BVHWIDTH];
+            int mask = k.boxes(n, maxdist, tnear), order[BVHWIDTH], numhit = 0;
+            // far children go on the stack first so the near ones get popped first
+            loopi(n.numchildren) if(mask&(1<<i))
+            {
+                int j = numhit++;
+                for(; j > 0 && tnear[order[j-1]] < tnear[i]; j--) order[j] = order[j-1];
+                order[j] = i;
+            }
+            loopi(numhit) stack[stacksize++] = { n.child[order[i]], tnear[order[i]] };
+        }
+        else
+        {
+            const BIH::triblock &b = m.triblocks[~cur.child];
+            float t[BVHWIDTH], v[BVHWIDTH], w[BVHWIDTH];
+            int mask = k.tris(b, maxdist, cull, t, v, w);
+            if(mask) loopi(BVHWIDTH) if(mask&(1<<i) && t[i] <= maxdist && BIH::alphatest(m, b.tri[i], v[i], w[i], mode))
+            {
+                dist = maxdist = t[i];
+                if(mode&RAY_SHADOW) return true;
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+template<class K>
+static bool traversewide(const BIH &bih, const K &k, float maxdist, float &dist, int mode)
+{
+    bool hit = false;
+    loopi(bih.nummeshes)
+    {
+        const BIH::mesh &m = bih.meshes[i];
+        if(!(mode&RAY_SHADOW) && m.flags&BIH::MESH_NOCLIP) continue;
+        if(traversewide(m, k, maxdist, dist, mode))
+        {
+            if(mode&RAY_SHADOW) return true;
+            maxdist = dist;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
 inline bool BIH::traverse(const vec &o, const vec &ray, float maxdist, float &dist, int mode)
 {
+    return traverse(bihpath(), o, ray, maxdist, dist, mode);
+}
+
+bool BIH::traverse(int path, const vec &o, const vec &ray, float maxdist, float &dist, int mode)
+{
+    if(!hastree(path)) path = nodes ? int(BIH_BINARY) : widepath();
     vec invray(ray.x ? 1/ray.x : 1e16f, ray.y ? 1/ray.y : 1e16f, ray.z ? 1/ray.z : 1e16f);
+    switch(path)
+    {
+        case BIH_WIDE_SSE2:
+#ifdef SIMD_X86
+            return traversewide(*this, widekernelsse2(o, ray, invray), maxdist, dist, mode);
+#endif
+            // without SSE2 support compiled in, the scalar kernel walks the same tree
+        case BIH_WIDE_SCALAR: return traversewide(*this, widekernelscalar(o, ray, invray), maxdist, dist, mode);
+    }
     loopi(nummeshes)
     {
         mesh &m = meshes[i];
@@ -244,6 +462,106 @@ void BIH::build(mesh &m, ushort *indices, int numindices, const ivec &vmin, cons
     }
 }
 
+/// Where to cut num triangles in two for the wide tree: at full leaves near the middle.
+static inline int widesplit(int num)
+{
+    return num <= 2*BVHWIDTH ? BVHWIDTH : min(num-1, (num/2 + BVHWIDTH-1)/BVHWIDTH*BVHWIDTH);
+}
+
+/// Moves the left triangles with the lowest centers along the longest axis of all of them to the front.
+static void widepartition(ushort *indices, int numindices, int left, const vec *trimin, const vec *trimax)
+{
+    vec cmin(1e16f, 1e16f, 1e16f), cmax(-1e16f, -1e16f, -1e16f);
+    loopi(numindices)
+    {
+        vec c = vec(trimin[indices[i]]).add(trimax[indices[i]]);
+        cmin.min(c);
+        cmax.max(c);
+    }
+    int axis = 0;
+    loopk(3) if(cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+    std::nth_element(indices, indices + left, indices + numindices, [&](ushort a, ushort b)
+    {
+        return trimin[a][axis] + trimax[a][axis] < trimin[b][axis] + trimax[b][axis];
+    });
+}
+
+int BIH::buildwide(const mesh &m, ushort *indices, int numindices, const vec *trimin, const vec *trimax)
+{
+    // two levels of median splits give up to BVHWIDTH groups below the node
+    ushort *groups[BVHWIDTH];
+    int groupsizes[BVHWIDTH], numgroups = 0, halves[2] = { numindices, 0 };
+    if(numindices > BVHWIDTH)
+    {
+        halves[0] = widesplit(numindices);
+        halves[1] = numindices - halves[0];
+        widepartition(indices, numindices, halves[0], trimin, trimax);
+    }
+    ushort *half = indices;
+    loopi(2)
+    {
+        if(halves[i] > BVHWIDTH)
+        {
+            int left = widesplit(halves[i]);
+            widepartition(half, halves[i], left, trimin, trimax);
+            groups[numgroups] = half;
+            groupsizes[numgroups++] = left;
+            groups[numgroups] = half + left;
+            groupsizes[numgroups++] = halves[i] - left;
+        }
+        else if(halves[i] > 0)
+        {
+            groups[numgroups] = half;
+            groupsizes[numgroups++] = halves[i];
+        }
+        half += halves[i];
+    }
+
+    int offset = widenodes.length();
+    memset(&widenodes.add(), 0, sizeof(widenode));
+    loopi(numgroups)
+    {
+        vec gmin(1e16f, 1e16f, 1e16f), gmax(-1e16f, -1e16f, -1e16f);
+        loopj(groupsizes[i])
+        {
+            gmin.min(trimin[groups[i][j]]);
+            gmax.max(trimax[groups[i][j]]);
+        }
+        int child;
+        if(groupsizes[i] > BVHWIDTH) child = buildwide(m, groups[i], groupsizes[i], trimin, trimax);
+        else
+        {
+            child = ~triblocks.length();
+            triblock &b = triblocks.add();
+            memset(&b, 0, sizeof(b));
+            loopj(BVHWIDTH)
+            {
+                b.tri[j] = j < groupsizes[i] ? groups[i][j] : -1;
+                if(b.tri[j] < 0) continue;
+                const tri &t = m.tris[b.tri[j]];
+                vec a = m.xform.transform(m.getpos(t.vert[0])),
+                    e1 = m.xform.transform(m.getpos(t.vert[1])).sub(a),
+                    e2 = m.xform.transform(m.getpos(t.vert[2])).sub(a);
+                loopk(3)
+                {
+                    b.a[k][j] = a[k];
+                    b.b[k][j] = e1[k];
+                    b.c[k][j] = e2[k];
+                }
+            }
+        }
+        widenode &n = widenodes[offset];
+        loopk(3)
+        {
+            n.bbmin[k][i] = gmin[k];
+            n.bbmax[k][i] = gmax[k];
+        }
+        n.child[i] = child;
+        n.numchildren = i+1;
+    }
+    return offset;
+}
+
 BIH::BIH(vector<mesh> &buildmeshes)
   : meshes(nullptr), nummeshes(0), nodes(nullptr), numnodes(0), tribbs(nullptr), numtris(0), bbmin(1e16f, 1e16f, 1e16f), bbmax(-1e16f, -1e16f, -1e16f), center(0, 0, 0), radius(0), entradius(0)
 {
@@ -293,19 +611,66 @@ BIH::BIH(vector<mesh> &buildmeshes)
     radius = vec(bbmax).sub(bbmin).mul(0.5f).magnitude();
     entradius = max(bbmin.squaredlen(), bbmax.squaredlen());
 
-    nodes = new node[numtris];
-    node *curnode = nodes;
+    buildtree(bihpath());
+}
+
+bool BIH::hastree(int path) const
+{
+    return path == BIH_BINARY ? nodes != nullptr : !widenodes.empty();
+}
+
+void BIH::buildtree(int path)
+{
+    if(!numtris || hastree(path)) return;
     ushort *indices = new ushort[numtris];
-    loopi(nummeshes)
+    if(path == BIH_BINARY)
     {
-        mesh &m = meshes[i];
-        m.nodes = curnode;
-        loopj(m.numtris) indices[j] = j;
-        build(m, indices, m.numtris, ivec::floor(m.bbmin), ivec::ceil(m.bbmax));
-        curnode += m.numnodes;
+        nodes = new node[numtris];
+        node *curnode = nodes;
+        loopi(nummeshes)
+        {
+            mesh &m = meshes[i];
+            m.nodes = curnode;
+            loopj(m.numtris) indices[j] = j;
+            build(m, indices, m.numtris, ivec::floor(m.bbmin), ivec::ceil(m.bbmax));
+            curnode += m.numnodes;
+        }
+        numnodes = int(curnode - nodes);
+    }
+    else
+    {
+        vector<vec> trimin, trimax;
+        vector<ivec2> widebases;
+        loopi(nummeshes)
+        {
+            mesh &m = meshes[i];
+            trimin.setsize(0);
+            trimax.setsize(0);
+            loopj(m.numtris)
+            {
+                const tri &t = m.tris[j];
+                vec v0 = m.xform.transform(m.getpos(t.vert[0])), v1 = m.xform.transform(m.getpos(t.vert[1])), v2 = m.xform.transform(m.getpos(t.vert[2]));
+                trimin.add(vec(v0).min(v1).min(v2));
+                trimax.add(vec(v0).max(v1).max(v2));
+            }
+            loopj(m.numtris) indices[j] = j;
+            ivec2 base(widenodes.length(), triblocks.length());
+            widebases.add(base);
+            buildwide(m, indices, m.numtris, trimin.getbuf(), trimax.getbuf());
+            // the children of the wide tree of a mesh count from its own root and first leaf
+            for(int j = base.x; j < widenodes.length(); j++)
+            {
+                widenode &n = widenodes[j];
+                loopk(n.numchildren) n.child[k] = n.child[k] >= 0 ? n.child[k] - base.x : ~(~n.child[k] - base.y);
+            }
+        }
+        loopi(nummeshes)
+        {
+            meshes[i].widenodes = widenodes.getbuf() + widebases[i].x;
+            meshes[i].triblocks = triblocks.getbuf() + widebases[i].y;
+        }
     }
     delete[] indices;
-    numnodes = int(curnode - nodes);
 }
 
 BIH::~BIH()
@@ -338,3 +703,71 @@ bool mmintersect(const extentity &e, const vec &o, const vec &ray, float maxdist
     return m->bih->traverse(mo, mray, maxdist ? maxdist : 1e16f, dist, mode);
 }
 
+/// Cast num random rays at the loaded mapmodels with every tree and kernel, as shadow and as collision rays.
+static void bihbench(int *num)
+{
+    int n = *num > 0 ? *num : 100000;
+    vector<BIH *> bihs;
+    for(int i = 0; getmminfo(i); i++)
+    {
+        model *m = loadmapmodel(i);
+        if(m && (m->bih || m->setBIH()) && m->bih->numtris) bihs.add(m->bih);
+    }
+    if(bihs.empty())
+    {
+        Log.std->info("bihbench: no mapmodels loaded");
+        return;
+    }
+    struct benchray
+    {
+        BIH *bih;
+        vec o, ray;
+    };
+    vector<benchray> rays;
+    long numtris = 0;
+    loopv(bihs) numtris += bihs[i]->numtris;
+    loopi(n)
+    {
+        benchray &r = rays.add();
+        r.bih = bihs[i%bihs.length()];
+        vec dir(rndscale(2)-1, rndscale(2)-1, rndscale(2)-1), target;
+        if(dir.iszero()) dir = vec(0, 0, 1);
+        r.o = vec(dir).normalize().mul(2*r.bih->radius).add(r.bih->center);
+        loopk(3) target[k] = r.bih->bbmin[k] + rndscale(r.bih->bbmax[k] - r.bih->bbmin[k]);
+        r.ray = vec(target).sub(r.o).normalize();
+    }
+    static const char * const pathnames[NUMBIHPATHS] = { "binary tree", "wide tree", "wide tree with sse2" };
+    static const int modes[2] = { RAY_SHADOW|RAY_ALPHAPOLY, RAY_ALPHAPOLY };
+    int numpaths = widepath() + 1;
+    loopv(bihs) loopk(numpaths) bihs[i]->buildtree(k);
+    vector<uchar> hits;
+    vector<float> dists;
+    hits.pad(n);
+    dists.pad(n);
+    loopj(2)
+    {
+        loopk(numpaths)
+        {
+            int numhits = 0, differ = 0, distdiffer = 0;
+            auto start = std::chrono::steady_clock::now();
+            loopv(rays)
+            {
+                float dist = 1e16f;
+                bool hit = rays[i].bih->traverse(k, rays[i].o, rays[i].ray, 1e16f, dist, modes[j]);
+                numhits += hit;
+                if(k == BIH_BINARY) { hits[i] = hit; dists[i] = dist; continue; }
+                if(hits[i] != hit) differ++;
+                // shadow rays stop at any hit, only the nearest hit of collision rays is the same for all trees
+                else if(hit && !(modes[j]&RAY_SHADOW) && fabs(dist - dists[i]) > 1e-3f*max(1.0f, dists[i]))
+                {
+                    if(!distdiffer) Log.std->warn("bihbench: the {} hits at distance {} instead of {}", pathnames[k], dist, dists[i]);
+                    distdiffer++;
+                }
+            }
+            std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+            Log.std->info("bihbench: {} rays at {} mapmodels ({} triangles), {}: {:.3f} us per ray with the {} ({} hits, {} differ, {} at another distance)",
+                          n, bihs.length(), numtris, j ? "collision" : "shadow", time.count()/n, pathnames[k], numhits, differ, distdiffer);
+        }
+    }
+}
+COMMAND(bihbench, "i");
@@ -13,6 +13,9 @@
 struct Texture;
 struct extentity;
 
+/// Children per node of the wide mesh trees, and triangles per leaf.
+#define BVHWIDTH 4
+
 struct BIH
 {
     struct node
@@ -53,6 +56,22 @@ struct BIH
         }
     };
 
+    /// Node of the wide tree of a mesh, with the bounds of its children as one run of floats per
+    /// coordinate, so all of them get tested against a ray at once.
+    struct widenode
+    {
+        float bbmin[3][BVHWIDTH], bbmax[3][BVHWIDTH];
+        int child[BVHWIDTH]; ///< index of a node, or ~index of a leaf triblock
+        int numchildren;
+    };
+
+    /// Up to BVHWIDTH triangles of a wide tree leaf, transformed into model space and laid out like widenode.
+    struct triblock
+    {
+        float a[3][BVHWIDTH], b[3][BVHWIDTH], c[3][BVHWIDTH]; ///< first vertex and the edges to the other two
+        int tri[BVHWIDTH];                                    ///< index into mesh::tris, -1 for padding
+    };
+
     enum { MESH_NOCLIP = 1<<0, MESH_ALPHA = 1<<1, MESH_CULLFACE = 1<<2 };
 
     struct mesh
@@ -70,8 +89,10 @@ struct BIH
         Texture *tex;
         int flags;
         vec bbmin, bbmax;
+        const widenode *widenodes;
+        const triblock *triblocks;
 
-        mesh() : numnodes(0), numtris(0), tex(nullptr), flags(0) {}
+        mesh() : numnodes(0), numtris(0), tex(nullptr), flags(0), widenodes(nullptr), triblocks(nullptr) {}
 
         vec getpos(int i) const { return *(const vec *)(pos + i*posstride); }
         vec2 gettc(int i) const { return *(const vec2 *)(tc + i*tcstride); }
@@ -85,19 +106,33 @@ struct BIH
     int numtris;
     vec bbmin, bbmax, center;
     float radius, entradius;
+    vector<widenode> widenodes;
+    vector<triblock> triblocks;
 
     BIH(vector<mesh> &buildmeshes);
 
     ~BIH();
 
+    /// Whether the tree path (see bihpath()) walks exists, only the one picked on load gets built.
+    bool hastree(int path) const;
+    void buildtree(int path);
     void build(mesh &m, ushort *indices, int numindices, const ivec &vmin, const ivec &vmax);
+    int buildwide(const mesh &m, ushort *indices, int numindices, const vec *trimin, const vec *trimax);
 
+    /// Walks the tree bihpath() picks, or the one which got built if that is missing.
     bool traverse(const vec &o, const vec &ray, float maxdist, float &dist, int mode);
+    bool traverse(int path, const vec &o, const vec &ray, float maxdist, float &dist, int mode);
     bool traverse(const mesh &m, const vec &o, const vec &ray, const vec &invray, float maxdist, float &dist, int mode, node *curnode, float tmin, float tmax);
     bool triintersect(const mesh &m, int tidx, const vec &mo, const vec &mray, float maxdist, float &dist, int mode);
+    static bool alphatest(const mesh &m, int tidx, float v, float w, int mode);
     
     void preload();
 };
 
+enum { BIH_BINARY = 0, BIH_WIDE_SCALAR, BIH_WIDE_SSE2, NUMBIHPATHS };
+
+/// The tree and kernel mapmodel rays use: the bihwide variable, limited to what the cpu supports.
+extern int bihpath();
+
 extern bool mmintersect(const extentity &e, const vec &o, const vec &ray, float maxdist, int mode, float &dist);
 
@@ -8,6 +8,7 @@
 #include <stdio.h>                                    // for printf, NULL
 #include <string.h>                                   // for memset
 #include <algorithm>                                  // for min, max
+#include <chrono>                                     // for steady_clock
 #include <memory>                                     // for __shared_ptr
 
 #include "inexor/engine/material.hpp"                 // for ::MATF_VOLUME
@@ -34,15 +35,32 @@
 #include "inexor/shared/ents.hpp"                     // for physent, dynent
 #include "inexor/shared/geom.hpp"                     // for vec, vec::(anon...
 #include "inexor/shared/tools.hpp"                    // for min, max, rnd
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem
 #include "inexor/util/legacy_time.hpp"                // for scaletime, last...
 
 const int MAXCLIPPLANES = 1024;
-static clipplanes clipcache[MAXCLIPPLANES];
-static int clipcacheversion = -2;
+static int clipcacheversion = -2, clipcacheclears = 0;
+
+/// Every thread gets its own clip plane cache, so collision queries can run on the job system.
+struct clipplanecache
+{
+    clipplanes planes[MAXCLIPPLANES];
+    int clears;
+};
+
+static inline clipplanes *threadclipcache()
+{
+    static thread_local std::unique_ptr<clipplanecache> cache;
+    if(!cache) cache.reset(new clipplanecache());
+    else if(cache->clears != clipcacheclears) memset(cache->planes, 0, sizeof(cache->planes));
+    else return cache->planes;
+    cache->clears = clipcacheclears;
+    return cache->planes;
+}
 
 static inline clipplanes &getclipplanes(const cube &c, const ivec &o, int size, bool collide = true, int offset = 0)
 {
-    clipplanes &p = clipcache[int(&c - worldroot)&(MAXCLIPPLANES-1)];
+    clipplanes &p = threadclipcache()[int(&c - worldroot)&(MAXCLIPPLANES-1)];
     if(p.owner != &c || p.version != clipcacheversion+offset) 
     {
         p.owner = &c;
@@ -57,7 +75,7 @@ void resetclipplanes()
     clipcacheversion += 2;
     if(!clipcacheversion)
     {
-        memset(clipcache, 0, sizeof(clipcache));
+        clipcacheclears++; // every thread clears its cache on next use
         clipcacheversion = 2;
     }
 }
@@ -129,7 +147,7 @@ bool pointincube(const clipplanes &p, const vec &v)
          else if(v[i] < p.o[i]-p.r[i] || v[i] > p.o[i]+p.r[i]) exit; \
     }
 
-vec hitsurface;
+thread_local vec hitsurface;
 
 static inline bool raycubeintersect(const clipplanes &p, const cube &c, const vec &v, const vec &ray, const vec &invray, float &dist)
 {
@@ -144,8 +162,8 @@ static inline bool raycubeintersect(const clipplanes &p, const cube &c, const ve
 }
 
 extern void entselectionbox(const entity &e, vec &eo, vec &es);
-float hitentdist;
-int hitent, hitorient;
+static thread_local float hitentdist;
+static thread_local int hitent, hitorient;
 
 static float disttoent(octaentities *oc, const vec &o, const vec &ray, float radius, int mode, extentity *t)
 {
@@ -399,6 +417,13 @@ void resetshadowraycache(ShadowRayCache *cache)
     }
 }
 
+static inline clipplanes &getshadowclipplanes(ShadowRayCache *cache, const cube &c, const ivec &lo, int size)
+{
+    clipplanes &p = cache->clipcache[int(&c - worldroot)&(MAXCLIPPLANES-1)];
+    if(p.owner != &c || p.version != cache->version) { p.owner = &c; p.version = cache->version; genclipplanes(c, lo, size, p, false); }
+    return p;
+}
+
 float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radius, int mode, extentity *t)
 {
     INITRAYCUBE;
@@ -415,8 +440,79 @@ float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radiu
         if(!isempty(c) && !(c.material&MAT_ALPHA))
         {
             if(isentirelysolid(c)) return c.texture[side]==DEFAULT_SKY && mode&RAY_SKIPSKY ? radius : dist;
-            clipplanes &p = cache->clipcache[int(&c - worldroot)&(MAXCLIPPLANES-1)];
-            if(p.owner != &c || p.version != cache->version) { p.owner = &c; p.version = cache->version; genclipplanes(c, lo, 1<<lshift, p, false); }
+            const clipplanes &p = getshadowclipplanes(cache, c, lo, 1<<lshift);
+            INTERSECTPLANES(side = p.side[i], goto nextcube);
+            INTERSECTBOX(side = (i<<1) + 1 - lsizemask[i], goto nextcube);
+            if(exitdist >= 0) return c.texture[side]==DEFAULT_SKY && mode&RAY_SKIPSKY ? radius : dist+max(enterdist+0.1f, 0.0f);
+        }
+
+    nextcube:
+        FINDCLOSEST(side = O_RIGHT - lsizemask.x, side = O_FRONT - lsizemask.y, side = O_TOP - lsizemask.z);
+
+        if(dist>=radius) return dist;
+
+        UPOCTREE(return radius);
+    }
+}
+
+/// The cube the previous ray of shadowrayssamestart() started in, rays starting in it again skip the descent from the root.
+struct raystart
+{
+    cube *levels[20], *leaf;
+    ivec lo;
+    int lshift;
+};
+
+static inline float shadowray(ShadowRayCache *cache, raystart &start, const vec &o, const vec &ray, float radius, int mode, extentity *t)
+{
+    INITRAYCUBE;
+    CHECKINSIDEWORLD;
+
+    int side = O_BOTTOM, x = int(v.x), y = int(v.y), z = int(v.z);
+    cube *shared = nullptr;
+    if(start.leaf && !dist && !((uint(x^start.lo.x)|uint(y^start.lo.y)|uint(z^start.lo.z))>>start.lshift))
+    {
+        shared = start.leaf;
+        lshift = start.lshift;
+        memcpy(&levels[lshift+1], &start.levels[lshift+1], (worldscale-lshift)*sizeof(cube *));
+    }
+    else start.leaf = nullptr;
+    bool first = !shared && !dist;
+    for(;;)
+    {
+        cube *leaf = shared;
+        if(shared) shared = nullptr;
+        else
+        {
+            DOWNOCTREE(shadowent, );
+            leaf = lc;
+            if(first)
+            {
+                // only remember descents that did not pass any mapmodels
+                first = false;
+                bool ents = false;
+                for(int l = worldscale-1; l >= lshift; l--)
+                {
+                    const cube &n = levels[l+1][octastep(x, y, z, l)];
+                    if(n.ext && n.ext->ents && l < (mode&RAY_BB ? worldscale : 0)) { ents = true; break; }
+                }
+                if(!ents)
+                {
+                    start.leaf = lc;
+                    start.lshift = lshift;
+                    start.lo = ivec(x&(~0<<lshift), y&(~0<<lshift), z&(~0<<lshift));
+                    memcpy(&start.levels[lshift+1], &levels[lshift+1], (worldscale-lshift)*sizeof(cube *));
+                }
+            }
+        }
+
+        cube &c = *leaf;
+        ivec lo(x&(~0<<lshift), y&(~0<<lshift), z&(~0<<lshift));
+
+        if(!isempty(c) && !(c.material&MAT_ALPHA))
+        {
+            if(isentirelysolid(c)) return c.texture[side]==DEFAULT_SKY && mode&RAY_SKIPSKY ? radius : dist;
+            const clipplanes &p = getshadowclipplanes(cache, c, lo, 1<<lshift);
             INTERSECTPLANES(side = p.side[i], goto nextcube);
             INTERSECTBOX(side = (i<<1) + 1 - lsizemask[i], goto nextcube);
             if(exitdist >= 0) return c.texture[side]==DEFAULT_SKY && mode&RAY_SKIPSKY ? radius : dist+max(enterdist+0.1f, 0.0f);
@@ -431,6 +527,48 @@ float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radiu
     }
 }
 
+void shadowrayssamestart(ShadowRayCache *cache, int numrays, const vec *origins, const vec *rays, float *dists, float radius, int mode, extentity *t)
+{
+    raystart start;
+    start.leaf = nullptr;
+    loopi(numrays) dists[i] = shadowray(cache, start, origins[i], rays[i], radius, mode, t);
+}
+
+/// Time shadow rays cast like the sky light of a lumel at n random spots, one by one and sharing their start cube.
+static void raybench(int *num)
+{
+    const int RAYS = 16;
+    int n = *num > 0 ? *num : 10000, total = n*RAYS;
+    vector<vec> origins, rays;
+    loopi(n)
+    {
+        vec o(rndscale(worldsize), rndscale(worldsize), rndscale(worldsize));
+        loopj(RAYS)
+        {
+            vec &ray = rays.add(vec(rndscale(2)-1, rndscale(2)-1, rndscale(1)+0.01f).normalize());
+            origins.add(vec(ray).mul(0.1f).add(o));
+        }
+    }
+    vector<float> single, shared;
+    single.pad(total);
+    shared.pad(total);
+    int mode = RAY_ALPHAPOLY|RAY_SHADOW;
+    ShadowRayCache *cache = newshadowraycache();
+    auto start = std::chrono::steady_clock::now();
+    loopi(total) single[i] = shadowray(cache, origins[i], rays[i], 1e16f, mode);
+    auto singledone = std::chrono::steady_clock::now();
+    resetshadowraycache(cache);
+    for(int i = 0; i < total; i += RAYS) shadowrayssamestart(cache, RAYS, &origins[i], &rays[i], &shared[i], 1e16f, mode);
+    auto shareddone = std::chrono::steady_clock::now();
+    freeshadowraycache(cache);
+    int differ = 0;
+    loopi(total) if(single[i] != shared[i]) differ++;
+    std::chrono::duration<double, std::micro> singletime = singledone - start, sharedtime = shareddone - singledone;
+    Log.std->info("raybench: {} rays, {:.3f} us per ray one by one, {:.3f} us per ray sharing the start of {}, {} differ",
+                  total, singletime.count()/total, sharedtime.count()/total, RAYS, differ);
+}
+COMMAND(raybench, "i");
+
 float rayent(const vec &o, const vec &ray, float radius, int mode, int size, int &orient, int &ent)
 {
     hitent = -1;
@@ -479,9 +617,9 @@ float rayfloor(const vec &o, vec &floor, int mode, float radius)
 /////////////////////////  entity collision  ///////////////////////////////////////////////
 
 // info about collisions
-bool collideinside; // whether an internal collision happened
-physent *collideplayer; // whether the collection hit a player
-vec collidewall; // just the normal vectors.
+thread_local bool collideinside; // whether an internal collision happened
+thread_local physent *collideplayer; // whether the collection hit a player
+thread_local vec collidewall; // just the normal vectors.
 
 const float STAIRHEIGHT = 4.1f;
 const float FLOORZ = 0.867f;
@@ -584,68 +722,212 @@ bool ellipsecollide(physent *d, const vec &dir, const vec &o, const vec &center,
     return false;
 }
 
-#define DYNENTCACHESIZE 1024
+VARF(dynentsize, 4, 7, 12, cleardynentcache());
 
-static uint dynentframe = 0;
+static inline uint hthash(const physent *d) { return uint(size_t(d)>>5); }
+static inline bool htcmp(const physent *x, const physent *y) { return x == y; }
 
-static struct dynentcacheentry
+/// Cell of a coordinate, anything outside of the world is kept in its border cells.
+static inline int dynentcell(float c)
 {
-    int x, y;
-    uint frame;
-    vector<physent *> dynents;
-} dynentcache[DYNENTCACHESIZE];
+    return clamp(int(c), 0, worldsize-1)>>dynentsize;
+}
 
-void cleardynentcache()
+#define loopdynentcells(curx, cury, o, radius) \
+    for(int curx = dynentcell(o.x-radius), endx = dynentcell(o.x+radius); curx <= endx; curx++) \
+    for(int cury = dynentcell(o.y-radius), endy = dynentcell(o.y+radius); cury <= endy; cury++)
+
+static const vector<physent *> nodynents;
+
+/// Broadphase for dynamic entities: a uniform grid of 1<<dynentsize sized cells, hashed by cell.
+/// Every entity is registered in all cells its bounding square overlaps and only relinked when
+/// that range of cells changes, so syncing the grid to the entity list is linear in entities.
+struct dynentgrid
 {
-    dynentframe++;
-    if(!dynentframe || dynentframe == 1) loopi(DYNENTCACHESIZE) dynentcache[i].frame = 0;
-    if(!dynentframe) dynentframe = 1;
+    struct slot
+    {
+        physent *d; // nullptr for the unused indices of the entity list
+        ivec2 lo, hi; // registered cells, none if lo.x > hi.x
+    };
+
+    hashtable<ivec2, vector<physent *>> cells;
+    hashtable<physent *, int> slotindex;
+    vector<slot> slots;
+    int cellbits = -1;
+    bool dirty = true;
+
+    const vector<physent *> &cell(int x, int y)
+    {
+        const vector<physent *> *c = cells.access(ivec2(x, y));
+        return c ? *c : nodynents;
+    }
+
+    void unlink(const slot &s)
+    {
+        for(int x = s.lo.x; x <= s.hi.x; x++) for(int y = s.lo.y; y <= s.hi.y; y++)
+        {
+            vector<physent *> *c = cells.access(ivec2(x, y));
+            if(c) c->removeobj(s.d);
+        }
+    }
+
+    void relink(slot &s)
+    {
+        physent *d = s.d;
+        ivec2 lo(0, 0), hi(-1, -1);
+        if(d && d->state == CS_ALIVE)
+        {
+            lo = ivec2(dynentcell(d->o.x-d->radius), dynentcell(d->o.y-d->radius));
+            hi = ivec2(dynentcell(d->o.x+d->radius), dynentcell(d->o.y+d->radius));
+        }
+        if(lo == s.lo && hi == s.hi) return;
+        unlink(s);
+        s.lo = lo;
+        s.hi = hi;
+        for(int x = lo.x; x <= hi.x; x++) for(int y = lo.y; y <= hi.y; y++) cells[ivec2(x, y)].add(d);
+    }
+
+    /// Bring the grid up to date with the num entities returned by get(i).
+    template<class F> void sync(int num, F get)
+    {
+        bool rebuild = cellbits != dynentsize || num != slots.length();
+        if(!rebuild) loopi(num) if(slots[i].d != get(i)) { rebuild = true; break; }
+        if(rebuild)
+        {
+            // only compares the old pointers, entities may be gone by now
+            loopv(slots) unlink(slots[i]);
+            slots.setsize(0);
+            slotindex.clear();
+            cellbits = dynentsize;
+            loopi(num)
+            {
+                // unused indices keep their slot, so slots stay in step with the indices of get()
+                physent *d = get(i);
+                slot &s = slots.add();
+                s.d = d;
+                s.lo = ivec2(0, 0);
+                s.hi = ivec2(-1, -1);
+                if(d) slotindex[d] = i;
+            }
+        }
+        loopv(slots) relink(slots[i]);
+        dirty = false;
+    }
+
+    /// Relink d after it moved, if it is in the grid at all.
+    void update(physent *d)
+    {
+        int *i = slotindex.access(d);
+        if(i) relink(slots[*i]);
+        else dirty = true;
+    }
+};
+
+/// While entities are moved in parallel collisions are checked against a copy of all dynents
+/// taken before the batch, so no thread reads an entity another thread is moving.
+static dynentgrid livegrid, frozengrid;
+static vector<physent> frozendynents;
+static vector<physent *> frozenowners;
+static bool dynentsfrozen = false;
+
+static inline physent *dynentowner(physent *d)
+{
+    return dynentsfrozen ? frozenowners[int(d - frozendynents.getbuf())] : d;
 }
 
-VARF(dynentsize, 4, 7, 12, cleardynentcache());
+/// Game callbacks raised while an entity is moved on a worker are recorded here and replayed
+/// on the main thread once the batch has finished.
+struct physicsevent
+{
+    enum { TRIGGER = 0, COLLIDE, SUICIDE, BOUNCED };
 
-#define DYNENTHASH(x, y) (((((x)^(y))<<5) + (((x)^(y))>>5)) & (DYNENTCACHESIZE - 1))
+    int type;
+    physent *d, *o;
+    bool local;
+    int floorlevel, waterlevel, material;
+    vec dir;
+};
+static thread_local vector<physicsevent> *deferredevents = nullptr;
 
-const vector<physent *> &checkdynentcache(int x, int y)
+static void physicstrigger(physent *d, bool local, int floorlevel, int waterlevel, int material = 0)
 {
-    dynentcacheentry &dec = dynentcache[DYNENTHASH(x, y)];
-    if(dec.x == x && dec.y == y && dec.frame == dynentframe) return dec.dynents;
-    dec.x = x;
-    dec.y = y;
-    dec.frame = dynentframe;
-    dec.dynents.shrink(0);
-    int numdyns = game::numdynents(), dsize = 1<<dynentsize, dx = x<<dynentsize, dy = y<<dynentsize;
-    loopi(numdyns)
+    if(!deferredevents) { game::physicstrigger(d, local, floorlevel, waterlevel, material); return; }
+    physicsevent &e = deferredevents->add();
+    e.type = physicsevent::TRIGGER;
+    e.d = d;
+    e.local = local;
+    e.floorlevel = floorlevel;
+    e.waterlevel = waterlevel;
+    e.material = material;
+}
+
+static void dynentcollide(physent *d, physent *o, const vec &dir)
+{
+    if(!deferredevents) { game::dynentcollide(d, o, dir); return; }
+    physicsevent &e = deferredevents->add();
+    e.type = physicsevent::COLLIDE;
+    e.d = d;
+    e.o = o;
+    e.dir = dir;
+}
+
+static void suicide(physent *d)
+{
+    if(!deferredevents) { game::suicide(d); return; }
+    physicsevent &e = deferredevents->add();
+    e.type = physicsevent::SUICIDE;
+    e.d = d;
+}
+
+static void bounced(physent *d, const vec &surface)
+{
+    if(!deferredevents) { game::bounced(d, surface); return; }
+    physicsevent &e = deferredevents->add();
+    e.type = physicsevent::BOUNCED;
+    e.d = d;
+    e.dir = surface;
+}
+
+static void replayphysicsevents(const vector<physicsevent> &events)
+{
+    loopv(events)
     {
-        dynent *d = game::iterdynents(i);
-        if(d->state != CS_ALIVE ||
-           d->o.x+d->radius <= dx || d->o.x-d->radius >= dx+dsize ||
-           d->o.y+d->radius <= dy || d->o.y-d->radius >= dy+dsize)
-            continue;
-        dec.dynents.add(d);
+        const physicsevent &e = events[i];
+        switch(e.type)
+        {
+            case physicsevent::TRIGGER: game::physicstrigger(e.d, e.local, e.floorlevel, e.waterlevel, e.material); break;
+            case physicsevent::COLLIDE: game::dynentcollide(e.d, e.o, e.dir); break;
+            case physicsevent::SUICIDE: game::suicide(e.d); break;
+            case physicsevent::BOUNCED: game::bounced(e.d, e.dir); break;
+        }
     }
-    return dec.dynents;
 }
 
-#define loopdynentcache(curx, cury, o, radius) \
-    for(int curx = max(int(o.x-radius), 0)>>dynentsize, endx = min(int(o.x+radius), worldsize-1)>>dynentsize; curx <= endx; curx++) \
-    for(int cury = max(int(o.y-radius), 0)>>dynentsize, endy = min(int(o.y+radius), worldsize-1)>>dynentsize; cury <= endy; cury++)
+/// Entities may have moved or been added or removed outside of physics, resync the grid on next use.
+void cleardynentcache()
+{
+    livegrid.dirty = true;
+}
+
+static inline dynentgrid &dynentcells()
+{
+    if(dynentsfrozen) return frozengrid;
+    if(livegrid.dirty) livegrid.sync(game::numdynents(), [](int i) -> physent * { return game::iterdynents(i); });
+    return livegrid;
+}
 
 void updatedynentcache(physent *d)
 {
-    loopdynentcache(x, y, d->o, d->radius)
-    {
-        dynentcacheentry &dec = dynentcache[DYNENTHASH(x, y)];
-        if(dec.x != x || dec.y != y || dec.frame != dynentframe || dec.dynents.find(d) >= 0) continue;
-        dec.dynents.add(d);
-    }
+    // while frozen others keep seeing the position d had before the batch
+    if(!dynentsfrozen && !livegrid.dirty) livegrid.update(d);
 }
 
 bool overlapsdynent(const vec &o, float radius)
 {
-    loopdynentcache(x, y, o, radius)
+    dynentgrid &grid = dynentcells();
+    loopdynentcells(x, y, o, radius)
     {
-        const vector<physent *> &dynents = checkdynentcache(x, y);
+        const vector<physent *> &dynents = grid.cell(x, y);
         loopv(dynents)
         {
             physent *d = dynents[i];
@@ -655,6 +937,137 @@ bool overlapsdynent(const vec &o, float radius)
     return false;
 }
 
+static inline void adddynents(const vector<physent *> &dynents, vector<physent *> &found)
+{
+    loopv(dynents)
+    {
+        physent *d = dynentowner(dynents[i]);
+        if(found.find(d) < 0) found.add(d);
+    }
+}
+
+void finddynents(const vec &o, float radius, vector<physent *> &found)
+{
+    dynentgrid &grid = dynentcells();
+    loopdynentcells(x, y, o, radius) adddynents(grid.cell(x, y), found);
+}
+
+void finddynents(const vec &from, const vec &to, vector<physent *> &found)
+{
+    // clip the segment to the world and one cell around it, then walk the cells it passes
+    float size = 1<<dynentsize, lo = -size, hi = worldsize+size, tmin = 0, tmax = 1;
+    vec2 o(from.x, from.y), ray(to.x-from.x, to.y-from.y);
+    loopi(2)
+    {
+        if(ray[i] == 0)
+        {
+            if(o[i] < lo || o[i] > hi) return;
+            continue;
+        }
+        float t1 = (lo-o[i])/ray[i], t2 = (hi-o[i])/ray[i];
+        if(t1 > t2) swap(t1, t2);
+        tmin = max(tmin, t1);
+        tmax = min(tmax, t2);
+    }
+    if(tmin > tmax) return;
+    vec2 start = vec2(ray).mul(tmin).add(o), end = vec2(ray).mul(tmax).add(o);
+    int x = int(floor(start.x/size)), y = int(floor(start.y/size)),
+        ex = int(floor(end.x/size)), ey = int(floor(end.y/size)),
+        stepx = ex > x ? 1 : -1, stepy = ey > y ? 1 : -1,
+        maxcell = (worldsize-1)>>dynentsize;
+    float dx = fabs(end.x-start.x), dy = fabs(end.y-start.y),
+          tx = dx > 0 ? fabs((stepx > 0 ? x+1 : x)*size - start.x)/dx : 1e16f,
+          ty = dy > 0 ? fabs((stepy > 0 ? y+1 : y)*size - start.y)/dy : 1e16f,
+          dtx = dx > 0 ? size/dx : 1e16f, dty = dy > 0 ? size/dy : 1e16f;
+    dynentgrid &grid = dynentcells();
+    for(int steps = abs(ex-x) + abs(ey-y);; steps--)
+    {
+        adddynents(grid.cell(clamp(x, 0, maxcell), clamp(y, 0, maxcell)), found);
+        if(steps <= 0) break;
+        if(x != ex && (y == ey || tx < ty)) { x += stepx; tx += dtx; }
+        else { y += stepy; ty += dty; }
+    }
+}
+
+/// Time n entities walking around the map for a few frames, each looking for the others it touches,
+/// once scanning all entities for every cell touched in a frame like before the grid, once with the grid.
+static void dynentbench(int *num)
+{
+    const int FRAMES = 100;
+    int n = *num > 0 ? *num : 256;
+    vector<physent> ents;
+    loopi(n)
+    {
+        physent &d = ents.add();
+        d.o = vec(rndscale(worldsize), rndscale(worldsize), worldsize/2);
+        d.radius = 4 + rndscale(6);
+        d.vel = vec(rndscale(2)-1, rndscale(2)-1, 0).mul(8);
+    }
+    struct scancell
+    {
+        int frame = -1;
+        vector<physent *> ents;
+    };
+    hashtable<ivec2, scancell> scancells;
+    dynentgrid grid;
+    long scancontacts = 0, gridcontacts = 0;
+    std::chrono::duration<double, std::micro> scantime(0), gridtime(0);
+    for(int frame = 0; frame < FRAMES; frame++)
+    {
+        loopv(ents)
+        {
+            physent &d = ents[i];
+            d.o.add(d.vel);
+            loopj(2) if(d.o[j] < 0 || d.o[j] >= worldsize)
+            {
+                d.vel[j] = -d.vel[j];
+                d.o[j] = clamp(d.o[j], 0.0f, worldsize-1.0f);
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        loopv(ents)
+        {
+            physent &d = ents[i];
+            loopdynentcells(x, y, d.o, d.radius)
+            {
+                scancell &c = scancells[ivec2(x, y)];
+                if(c.frame != frame)
+                {
+                    c.frame = frame;
+                    c.ents.setsize(0);
+                    int dsize = 1<<dynentsize, dx = x<<dynentsize, dy = y<<dynentsize;
+                    loopvj(ents)
+                    {
+                        physent &o = ents[j];
+                        if(o.o.x+o.radius <= dx || o.o.x-o.radius >= dx+dsize ||
+                           o.o.y+o.radius <= dy || o.o.y-o.radius >= dy+dsize)
+                            continue;
+                        c.ents.add(&o);
+                    }
+                }
+                loopvj(c.ents) if(c.ents[j] != &d && !d.o.reject(c.ents[j]->o, d.radius+c.ents[j]->radius)) scancontacts++;
+            }
+        }
+        auto scandone = std::chrono::steady_clock::now();
+        grid.sync(ents.length(), [&](int i) { return &ents[i]; });
+        loopv(ents)
+        {
+            physent &d = ents[i];
+            loopdynentcells(x, y, d.o, d.radius)
+            {
+                const vector<physent *> &c = grid.cell(x, y);
+                loopvj(c) if(c[j] != &d && !d.o.reject(c[j]->o, d.radius+c[j]->radius)) gridcontacts++;
+            }
+        }
+        auto griddone = std::chrono::steady_clock::now();
+        scantime += scandone - start;
+        gridtime += griddone - scandone;
+    }
+    Log.std->info("dynentbench: {} entities, {:.1f} us per frame scanning cells, {:.1f} us per frame with the grid ({} and {} contacts)",
+                  n, scantime.count()/FRAMES, gridtime.count()/FRAMES, scancontacts, gridcontacts);
+}
+COMMAND(dynentbench, "i");
+
 template<class E, class O>
 static inline bool plcollide(physent *d, const vec &dir, physent *o)
 {
@@ -674,13 +1087,14 @@ static inline bool plcollide(physent *d, const vec &dir, physent *o)
 bool plcollide(physent *d, const vec &dir)    // collide with player or monster
 {
     if(d->type==ENT_CAMERA || d->state!=CS_ALIVE) return false;
-    loopdynentcache(x, y, d->o, d->radius)
+    dynentgrid &grid = dynentcells();
+    loopdynentcells(x, y, d->o, d->radius)
     {
-        const vector<physent *> &dynents = checkdynentcache(x, y);
+        const vector<physent *> &dynents = grid.cell(x, y);
         loopv(dynents)
         {
             physent *o = dynents[i];
-            if(o==d || d->o.reject(o->o, d->radius+o->radius)) continue;
+            if(d->o.reject(o->o, d->radius+o->radius) || dynentowner(o)==d) continue;
             switch(d->collidetype)
             {
                 case COLLIDE_ELLIPSE:
@@ -700,8 +1114,8 @@ bool plcollide(physent *d, const vec &dir)    // collide with player or monster
                     break;
                 default: continue;
             }
-            collideplayer = o;
-            game::dynentcollide(d, o, collidewall);
+            collideplayer = dynentowner(o);
+            dynentcollide(d, collideplayer, collidewall);
             return true;
         }
     }
@@ -1430,7 +1844,7 @@ bool bounce(physent *d, float secs, float elasticity, float waterfric, float gra
         }
         else if(collideplayer) break;
         d->o = old;
-        game::bounced(d, collidewall);
+        bounced(d, collidewall);
         float c = collidewall.dot(d->vel),
               k = 1.0f + (1.0f-elasticity)*c/d->vel.magnitude();
         d->vel.mul(k);
@@ -1609,7 +2023,7 @@ void modifyvelocity(physent *pl, bool local, bool water, bool floating, int curt
             pl->vel.z = max(pl->vel.z, JUMPVEL); // physics impulse upwards
             if(water) { pl->vel.x /= 8.0f; pl->vel.y /= 8.0f; } // dampen velocity change even harder, gives correct water feel
 
-            game::physicstrigger(pl, local, 1, 0);
+            physicstrigger(pl, local, 1, 0);
         }
     }
     if(!floating && pl->physstate == PHYS_FALL) pl->timeinair += curtime;
@@ -1719,7 +2133,7 @@ bool moveplayer(physent *pl, int moveres, bool local, int curtime)
         loopi(moveres) if(!move(pl, d) && ++collisions<5) i--; // discrete steps collision detection & sliding
         if(timeinair > 800 && !pl->timeinair && !water) // if we land after long time must have been a high jump, make thud sound
         {
-            game::physicstrigger(pl, local, -1, 0);
+            physicstrigger(pl, local, -1, 0);
         }
     }
 
@@ -1737,11 +2151,11 @@ bool moveplayer(physent *pl, int moveres, bool local, int curtime)
         material = lookupmaterial(vec(pl->o.x, pl->o.y, pl->o.z + (pl->aboveeye - pl->eyeheight)/2));
         water = isliquid(material&MATF_VOLUME);
     }
-    if(!pl->inwater && water) game::physicstrigger(pl, local, 0, -1, material&MATF_VOLUME);
-    else if(pl->inwater && !water) game::physicstrigger(pl, local, 0, 1, pl->inwater);
+    if(!pl->inwater && water) physicstrigger(pl, local, 0, -1, material&MATF_VOLUME);
+    else if(pl->inwater && !water) physicstrigger(pl, local, 0, 1, pl->inwater);
     pl->inwater = water ? material&MATF_VOLUME : MAT_AIR;
 
-    if(pl->state==CS_ALIVE && (pl->o.z < 0 || material&MAT_DEATH)) game::suicide(pl);
+    if(pl->state==CS_ALIVE && (pl->o.z < 0 || material&MAT_DEATH)) suicide(pl);
 
     return true;
 }
@@ -1795,6 +2209,64 @@ void moveplayer(physent *pl, int moveres, bool local)
     }
 }
 
+VAR(physicsjobs, 0, 1, 1);
+
+/// Mapmodels load and size their collision boxes lazily, do that here rather than on a worker.
+static void preparemapmodelcollide()
+{
+    const vector<extentity *> &ents = entities::getents();
+    loopv(ents) if(ents[i]->type == ET_MAPMODEL && !(ents[i]->flags&EF_NOCOLLIDE))
+    {
+        model *m = loadmapmodel(ents[i]->attr2);
+        vec center, radius;
+        if(m && m->collide) m->collisionbox(center, radius);
+    }
+}
+
+void stepdynents(int num, const std::function<void(int)> &step)
+{
+    inexor::util::JobSystem *jobs = inexor::util::JobSystem::running();
+    if(!jobs || !physicsjobs || num < 2)
+    {
+        loopi(num) step(i);
+        return;
+    }
+
+    preparemapmodelcollide();
+    int numdyns = game::numdynents();
+    frozendynents.setsize(0);
+    frozenowners.setsize(0);
+    loopi(numdyns)
+    {
+        physent *d = game::iterdynents(i);
+        if(!d) continue;
+        frozendynents.add(*d);
+        frozenowners.add(d);
+    }
+    frozengrid.sync(frozendynents.length(), [](int i) { return &frozendynents[i]; });
+    dynentsfrozen = true;
+
+    static vector<vector<physicsevent>> events;
+    while(events.length() < num) events.add();
+    loopi(num) events[i].setsize(0);
+    jobs->parallel_for(num, [&](int i)
+    {
+        deferredevents = &events[i];
+        step(i);
+        deferredevents = nullptr;
+    });
+
+    dynentsfrozen = false;
+    cleardynentcache();
+    loopi(num) replayphysicsevents(events[i]);
+}
+
+void moveplayers(physent **ents, int num, int moveres, bool local)
+{
+    if(physsteps <= 0) loopi(num) moveplayer(ents[i], moveres, local); // just interpolates
+    else stepdynents(num, [&](int i) { moveplayer(ents[i], moveres, local); });
+}
+
 bool bounce(physent *d, float elasticity, float waterfric, float grav)
 {
     if(physsteps <= 0)
@@ -1916,10 +2388,11 @@ bool moveplatform(physent *p, const vec &dir)
 
     static vector<platforment> ents;
     ents.setsize(0);
+    dynentgrid &grid = dynentcells();
     for(int x = int(max(p->o.x-p->radius-PLATFORMBORDER, 0.0f))>>dynentsize, ex = int(min(p->o.x+p->radius+PLATFORMBORDER, worldsize-1.0f))>>dynentsize; x <= ex; x++)
     for(int y = int(max(p->o.y-p->radius-PLATFORMBORDER, 0.0f))>>dynentsize, ey = int(min(p->o.y+p->radius+PLATFORMBORDER, worldsize-1.0f))>>dynentsize; y <= ey; y++)
     {
-        const vector<physent *> &dynents = checkdynentcache(x, y);
+        const vector<physent *> &dynents = grid.cell(x, y);
         loopv(dynents)
         {
             physent *d = dynents[i];
@@ -1,6 +1,9 @@
 #pragma once
 
-#include "inexor/shared/geom.hpp"  // for vec
+#include <functional>                     // for function
+
+#include "inexor/shared/cube_vector.hpp"  // for vector
+#include "inexor/shared/geom.hpp"         // for vec
 
 struct clipplanes;
 struct dynent;
@@ -19,6 +22,9 @@ extern ShadowRayCache *newshadowraycache();
 extern void freeshadowraycache(ShadowRayCache *&cache);
 extern void resetshadowraycache(ShadowRayCache *cache);
 extern float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radius, int mode, extentity *t = nullptr);
+/// Trace rays which mostly start in the same cube, like the ones of a lumel. Returns the same as shadowray() per ray:
+/// each ray is still traced on its own, only the descent from the root to the start cube is shared.
+extern void shadowrayssamestart(ShadowRayCache *cache, int numrays, const vec *origins, const vec *rays, float *dists, float radius, int mode, extentity *t = nullptr);
 
 enum { RAY_BB = 1, RAY_POLY = 3, RAY_ALPHAPOLY = 7, RAY_ENTS = 9, RAY_CLIPMAT = 16, RAY_SKIPFIRST = 32, RAY_EDITMAT = 64, RAY_SHADOW = 128, RAY_PASS = 256, RAY_SKIPSKY = 512 };
 
@@ -28,11 +34,17 @@ extern float rayfloor  (const vec &o, vec &floor, int mode = 0, float radius = 0
 extern bool  raycubelos(const vec &o, const vec &dest, vec &hitpos);
 
 
-extern vec collidewall;
-extern bool collideinside;
-extern physent *collideplayer;
+/// Results of the last collide() call on this thread.
+extern thread_local vec collidewall;
+extern thread_local bool collideinside;
+extern thread_local physent *collideplayer;
 
 extern void moveplayer(physent *pl, int moveres, bool local);
+/// Run step(i) for every i < num, spread over the job system. Each step may move and collide its own entity:
+/// collisions see the dynents where they were before the batch, game callbacks are run afterwards in order.
+extern void stepdynents(int num, const std::function<void(int)> &step);
+/// moveplayer() for all ents, see stepdynents().
+extern void moveplayers(physent **ents, int num, int moveres, bool local);
 extern bool moveplayer(physent *pl, int moveres, bool local, int curtime);
 extern bool ellipseboxcollide(physent *d, const vec &dir, const vec &o, const vec &center, float yaw, float xr, float yr, float hi, float lo);
 extern bool ellipsecollide(physent *d, const vec &dir, const vec &o, const vec &center, float yaw, float xr, float yr, float hi, float lo);
@@ -51,6 +63,9 @@ extern bool moveplatform(physent *p, const vec &dir);
 extern void updatephysstate(physent *d);
 extern void cleardynentcache();
 extern void updatedynentcache(physent *d);
+/// Add every living dynent near the square of radius around o, or near the segment from-to, to found once.
+extern void finddynents(const vec &o, float radius, vector<physent *> &found);
+extern void finddynents(const vec &from, const vec &to, vector<physent *> &found);
 extern bool entinmap(dynent *d, bool avoidplayers = false);
 extern void findplayerspawn(dynent *d, int forceent = -1, int tag = 0);
 
@@ -15,6 +15,7 @@
 #include "inexor/server/gamemode/gamemode_server.hpp"  // for smode, servmode
 #include "inexor/server/map_management.hpp"            // for changemap
 #include "inexor/server/network_send.hpp"              // for sendf, sendser...
+#include "inexor/server/position_compression.hpp"      // for offerposcodec
 #include "inexor/shared/command.hpp"                   // for VARF, SVAR
 #include "inexor/shared/cube_formatting.hpp"           // for formatstring
 #include "inexor/shared/cube_tools.hpp"                // for copystring
@@ -29,7 +30,7 @@ extern void checkpausegame();
 
 VARF(maxclients, 0, DEFAULTCLIENTS, MAXCLIENTS, {if(!maxclients) maxclients = DEFAULTCLIENTS;});
 /// Max clients from same peer.
-VARF(maxdupclients, 0, 0, MAXCLIENTS, {if(serverhost) serverhost->duplicatePeers = maxdupclients ? maxdupclients : MAXCLIENTS;});
+VARF(maxdupclients, 0, 0, MAXCLIENTS, {if(serverhost) setduplicatepeers(maxdupclients ? maxdupclients : MAXCLIENTS);});
 
 /// The amount of people who can connect more than the actual specified max clients limit.
 /// E.g. for people connecting as admin or with the password.
@@ -427,6 +428,7 @@ extern SharedVar<char*> servermotd;
 void sendservinfo(clientinfo *ci)
 {
     sendf(ci->clientnum, 1, "ri5s", N_SERVINFO, ci->clientnum, PROTOCOL_VERSION, ci->sessionid, serverpass[0] ? 1 : 0, *serverdesc);
+    offerposcodec(ci);
 }
 
 
@@ -559,7 +561,8 @@ int clientconnect(int n, uint ip)
 void disconnect_client(int n, int reason)
 {
     if(!client_connections.inrange(n)) return;
-    enet_peer_disconnect(client_connections[n]->peer, reason);
+    client &c = *client_connections[n];
+    if(c.connected && c.peer) disconnectpeer(c.peer, c.connection, reason);
 
     clientinfo *ci = get_client_info(n);
     if(!ci) return;
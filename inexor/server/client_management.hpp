@@ -7,6 +7,10 @@
 #include "inexor/fpsgame/fpsstate.hpp"               // for fpsstate
 #include "inexor/network/SharedVar.hpp"              // for SharedVar
 #include "inexor/network/legacy/administration.hpp"  // for ::PRIV_NONE, ::M...
+#include "inexor/network/legacy/position_codec.hpp"  // for positionstate
+#include "inexor/server/gameevents.hpp"              // for gameeventqueue
+#include "inexor/server/hitverify.hpp"               // for hitboxhistory
+#include "inexor/server/network_send.hpp"            // for releasepacket
 #include "inexor/shared/cube_loops.hpp"              // for i, loopi
 #include "inexor/shared/cube_types.hpp"              // for string, uchar, uint
 #include "inexor/shared/cube_vector.hpp"             // for vector
@@ -33,11 +37,16 @@ struct client
     bool connected;
     int num;
     ENetPeer *peer;
+    uint connection; ///< the peerconnection() of peer when it connected
     string hostname;
     void *info;
 };
 extern vector<client *> client_connections;
 
+/// Counts the connections of the peer slot, so events and packets of a previous one are told apart
+/// after ENet handed the slot to someone else. Only valid on the thread owning the serverhost.
+extern uint peerconnection(ENetPeer *peer);
+
 extern client &add_client_connection(ENetPeer *peer);
 
 /// After some period of time without response we disconnect a client.
@@ -58,27 +67,39 @@ static constexpr int DEATHMILLIS = 300;
 
 extern int nextexceeded;
 
+/// Where and when a projectile was fired, to check the hits of its explosion (see verifyexplosion()).
+struct projectilelaunch
+{
+    vec from, to;
+    int millis;
+};
+
 template <int N>
 struct projectilestate
 {
     int projs[N];
+    projectilelaunch launches[N];
     int numprojs;
 
     projectilestate() : numprojs(0) {}
 
     void reset() { numprojs = 0; }
 
-    void add(int val)
+    void add(int val, const projectilelaunch &launch = projectilelaunch())
     {
         if(numprojs>=N) numprojs = 0;
+        launches[numprojs] = launch;
         projs[numprojs++] = val;
     }
 
-    bool remove(int val)
+    bool remove(int val, projectilelaunch *launch = nullptr)
     {
         loopi(numprojs) if(projs[i]==val)
         {
-            projs[i] = projs[--numprojs];
+            if(launch) *launch = launches[i];
+            --numprojs;
+            projs[i] = projs[numprojs];
+            launches[i] = launches[numprojs];
             return true;
         }
         return false;
@@ -152,68 +173,6 @@ struct gamestate : fpsstate
     }
 };
 
-struct clientinfo;
-
-// Events
-
-struct gameevent
-{
-    virtual ~gameevent() {}
-
-    virtual bool flush(clientinfo *ci, int fmillis);
-    virtual void process(clientinfo *ci) {}
-
-    virtual bool keepable() const { return false; }
-};
-
-struct timedevent : gameevent
-{
-    int millis;
-
-    bool flush(clientinfo *ci, int fmillis) override;
-};
-
-struct hitinfo
-{
-    int target;
-    int lifesequence;
-    int rays;
-    float dist;
-    vec dir;
-};
-
-struct shotevent : timedevent
-{
-    int id, gun;
-    vec from, to;
-    vector<hitinfo> hits;
-
-    void process(clientinfo *ci) override;
-};
-
-struct explodeevent : timedevent
-{
-    int id, gun;
-    vector<hitinfo> hits;
-
-    bool keepable() const override { return true; }
-
-    void process(clientinfo *ci) override;
-};
-
-struct suicideevent : gameevent
-{
-    void process(clientinfo *ci) override;
-};
-
-struct pickupevent : gameevent
-{
-    int ent;
-
-    void process(clientinfo *ci) override;
-};
-
-
 struct clientinfo
 {
     int clientnum, ownernum, connectmillis, sessionid, overflow;
@@ -225,10 +184,19 @@ struct clientinfo
     bool connected, timesync;
     int gameoffset, lastevent, pushed, exceeded;
     gamestate state;
-    vector<gameevent *> events;
+    gameeventqueue events;
     vector<uchar> position, messages;
     uchar *wsdata;
     int wslen;
+    vector<int> relayedpositions;
+    /// Last position we received and, if delta compressed positions were negotiated, what we sent to this client.
+    positionstate posstate;
+    bool poscodec;
+    int posframe;
+    positionacks posacks;
+    vector<positionhistory> poshistory;
+    /// Where this player was recently, to check hits on it.
+    hitboxhistory hitboxes;
     vector<clientinfo *> bots;
     int ping, aireinit;
     string clientmap;
@@ -238,12 +206,14 @@ struct clientinfo
     int lastclipboard, needclipboard;
 
     clientinfo() : getdemo(nullptr), getmap(nullptr), clipboard(nullptr) { reset(); }
-    ~clientinfo() { events.deletecontents(); cleanclipboard(); }
+    ~clientinfo() { cleanclipboard(); }
 
-    void addevent(gameevent *e)
+    /// @return the new event to fill in, or nullptr if it should be ignored.
+    gameevent *addevent(int type)
     {
-        if(state.state==CS_SPECTATOR || events.length()>100) delete e;
-        else events.add(e);
+        if(state.state==CS_SPECTATOR) return nullptr;
+        if(events.length()>100) { events.droppedevents++; return nullptr; }
+        return events.add(type);
     }
 
     enum
@@ -291,7 +261,8 @@ struct clientinfo
         mapvote[0] = 0;
         modevote = INT_MAX;
         state.reset();
-        events.deletecontents();
+        events.clear();
+        hitboxes.reset();
         overflow = 0;
         timesync = false;
         lastevent = 0;
@@ -306,14 +277,18 @@ struct clientinfo
     void reassign()
     {
         state.reassign();
-        events.deletecontents();
+        events.clear();
         timesync = false;
         lastevent = 0;
     }
 
     void cleanclipboard(bool fullclean = true)
     {
-        if(clipboard) { if(--clipboard->referenceCount <= 0) enet_packet_destroy(clipboard); clipboard = nullptr; }
+        if(clipboard)
+        {
+            releasepacket(clipboard); // ENet may still send it
+            clipboard = nullptr;
+        }
         if(fullclean) lastclipboard = 0;
     }
 
@@ -326,6 +301,11 @@ struct clientinfo
         connected = false;
         position.setsize(0);
         messages.setsize(0);
+        relayedpositions.setsize(0);
+        poscodec = false;
+        posframe = 0;
+        posacks = positionacks();
+        poshistory.shrink(0);
         ping = 0;
         aireinit = 0;
         needclipboard = 0;
@@ -1,5 +1,6 @@
 #include <boost/algorithm/clamp.hpp>                  // for clamp
 #include <fcntl.h>                                    // for SEEK_SET
+#include <limits.h>                                   // for INT_MAX
 #include <string.h>                                   // for memcmp, memcpy
 #include <time.h>                                     // for ctime, time
 #include <algorithm>                                  // for min
@@ -29,58 +30,359 @@ namespace server {
 vector<demofile> demos;
 
 bool demonextmatch = false;
-stream *demotmp = nullptr, *demorecord = nullptr, *demoplayback = nullptr;
+stream *demotmp = nullptr;
+demowriter *demorecord = nullptr;
+demoreader *demoplayback = nullptr;
 int nextplayback = 0, demomillis = 0;
 
+/// Names the temporary file of the demo being recorded.
+static int demotmpid = 0;
+
+/// Game time the last keyframe of the demo being recorded was taken at.
+static int lastkeyframe = 0;
+
+/// Whether the next keyframe record read during playback gets sent, true right after starting or seeking.
+static bool demokeyframepending = false;
+
+/// Records on this channel hold keyframes, they are only played back when seeking to them.
+enum { DEMO_KEYFRAME = -1 };
+
 VAR(maxdemos, 0, 5, 25);
 VAR(maxdemosize, 0, 16, 31);
 
+/// Seconds of game time between two keyframes of a recorded demo, 0 to only write the initial one.
+VAR(demokeyframeinterval, 0, 30, 600);
+
+/// Size of the buffer between recording and the demo compression thread in kB.
+VAR(demowritebuffer, 64, 1024, 65536);
+
+static int demoindexsize(int numkeyframes)
+{
+    return numkeyframes*sizeof(demokeyframe) + sizeof(demoindexfooter);
+}
+
+/// Append the keyframes from first on to buf, with their offsets moved by -shift.
+static void putdemoindex(vector<uchar> &buf, const vector<demokeyframe> &index, int first = 0, int shift = 0)
+{
+    for(int i = first; i < index.length(); i++)
+    {
+        demokeyframe k = { index[i].millis, index[i].offset - shift };
+        lilswap(&k.millis, 2);
+        buf.put((const uchar *)&k, sizeof(demokeyframe));
+    }
+    demoindexfooter footer;
+    footer.numkeyframes = lilswap(index.length() - first);
+    memcpy(footer.magic, DEMO_INDEX_MAGIC, sizeof(footer.magic));
+    buf.put((const uchar *)&footer, sizeof(demoindexfooter));
+}
+
+/// Number of keyframes announced by the footer of a demo of len bytes, -1 if it is no valid index.
+static int numdemokeyframes(demoindexfooter &footer, int len)
+{
+    lilswap(&footer.numkeyframes, 1);
+    if(memcmp(footer.magic, DEMO_INDEX_MAGIC, sizeof(footer.magic))) return -1;
+    if(footer.numkeyframes <= 0 || demoindexsize(footer.numkeyframes) > len) return -1;
+    return footer.numkeyframes;
+}
+
+/// The keyframe segments have to be in order and lie between the header and the index.
+static bool checkdemoindex(vector<demokeyframe> &index, int indexstart)
+{
+    lilswap(&index[0].millis, 2*index.length());
+    loopv(index)
+    {
+        if(index[i].offset <= 0 || index[i].offset >= indexstart) return false;
+        if(i && (index[i].offset <= index[i-1].offset || index[i].millis < index[i-1].millis)) return false;
+    }
+    return true;
+}
+
+/// Read the index of a demo held in memory.
+static bool getdemoindex(const uchar *data, int len, vector<demokeyframe> &index)
+{
+    demoindexfooter footer;
+    if(len < int(sizeof(demoindexfooter))) return false;
+    memcpy(&footer, &data[len - sizeof(demoindexfooter)], sizeof(demoindexfooter));
+    int n = numdemokeyframes(footer, len);
+    if(n <= 0) return false;
+    int indexstart = len - demoindexsize(n);
+    index.setsize(0);
+    index.put((const demokeyframe *)&data[indexstart], n);
+    return checkdemoindex(index, indexstart);
+}
+
+/// The last keyframe at or before millis (binary search), 0 if there is none.
+static int findkeyframe(const vector<demokeyframe> &index, int millis)
+{
+    int lo = 0, hi = index.length() - 1;
+    while(lo < hi)
+    {
+        int mid = (lo + hi + 1)/2;
+        if(index[mid].millis <= millis) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+bool demoreader::open(const char *filename, demoheader &hdr)
+{
+    close();
+    file = openfile(filename, "rb");
+    if(!file) return false;
+    segment = opengzfile(nullptr, "rb", file);
+    if(!segment || segment->read(&hdr, sizeof(demoheader)) != sizeof(demoheader) || memcmp(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic)))
+        return false;
+    lilswap(&hdr.version, 2);
+    return true;
+}
+
+bool demoreader::readindex()
+{
+    DELETEP(segment);
+    if(!file) return false;
+    stream::offset len = file->size();
+    demoindexfooter footer;
+    if(len < stream::offset(sizeof(demoindexfooter)) || len > INT_MAX ||
+       !file->seek(len - sizeof(demoindexfooter), SEEK_SET) ||
+       file->read(&footer, sizeof(demoindexfooter)) != sizeof(demoindexfooter))
+        return false;
+    int n = numdemokeyframes(footer, int(len));
+    if(n <= 0) return false;
+    int indexstart = int(len) - demoindexsize(n);
+    index.setsize(0);
+    if(!file->seek(indexstart, SEEK_SET) || file->read(index.reserve(n).buf, n*sizeof(demokeyframe)) != n*sizeof(demokeyframe))
+        return false;
+    index.advance(n);
+    return checkdemoindex(index, indexstart) && seeksegment(0);
+}
+
+void demoreader::close()
+{
+    DELETEP(segment);
+    DELETEP(file);
+    index.setsize(0);
+    cursegment = -1;
+}
+
+bool demoreader::seeksegment(int k)
+{
+    DELETEP(segment);
+    if(!file || !index.inrange(k) || !file->seek(index[k].offset, SEEK_SET)) return false;
+    segment = opengzfile(nullptr, "rb", file);
+    cursegment = k;
+    return segment != nullptr;
+}
+
+bool demoreader::readstamp(int &millis)
+{
+    while(segment)
+    {
+        if(segment->read(&millis, sizeof(millis)) == sizeof(millis))
+        {
+            lilswap(&millis, 1);
+            return true;
+        }
+        // records never cross segments, so running out of data here just means the member ended
+        if(!seeksegment(cursegment + 1)) return false;
+    }
+    return false;
+}
+
+bool demoreader::read(void *buf, int len)
+{
+    return segment && len >= 0 && segment->read(buf, len) == size_t(len);
+}
+
+bool demoreader::skip(int len)
+{
+    return segment && len >= 0 && segment->seek(len, SEEK_CUR);
+}
+
+demowriter::demowriter(stream *file, const demoheader &hdr) : file(file)
+{
+    ringsize = demowritebuffer<<10;
+    ring = new uchar[ringsize];
+    put(OP_DATA, 0, 0, &hdr, sizeof(demoheader));
+    thread = std::thread([this] { run(); });
+}
+
+void demowriter::putrecord(int millis, int chan, const void *data, int len)
+{
+    put(OP_RECORD, millis, chan, data, len);
+}
+
+void demowriter::putkeyframe(int millis, const void *data, int len)
+{
+    put(OP_KEYFRAME, millis, DEMO_KEYFRAME, data, len);
+}
+
+void demowriter::copyin(const void *data, int len)
+{
+    int tail = (head + used) % ringsize, first = min(len, ringsize - tail);
+    memcpy(&ring[tail], data, first);
+    memcpy(ring, (const uchar *)data + first, len - first);
+    used += len;
+}
+
+void demowriter::put(int op, int millis, int chan, const void *data, int len)
+{
+    int entry[4] = { op, millis, chan, len };
+    int size = sizeof(entry) + len;
+    std::unique_lock<std::mutex> guard(lock);
+    if(size > ringsize)
+    {
+        // a single record bigger than the whole buffer: wait until it is empty and make room for it
+        drained.wait(guard, [this] { return !used || failed; });
+        delete[] ring;
+        ring = new uchar[size];
+        ringsize = size;
+        head = 0;
+    }
+    // only blocks the game thread if compression falls behind by a whole buffer
+    drained.wait(guard, [&] { return ringsize - used >= size || failed; });
+    if(failed) return;
+    copyin(entry, sizeof(entry));
+    copyin(data, len);
+    guard.unlock();
+    queued.notify_one();
+}
+
+bool demowriter::write(stream *&gz, const uchar *buf, int len)
+{
+    for(const uchar *end = &buf[len]; buf < end;)
+    {
+        int entry[4];
+        memcpy(entry, buf, sizeof(entry));
+        buf += sizeof(entry);
+        int op = entry[0], datalen = entry[3];
+        if(op == OP_KEYFRAME)
+        {
+            DELETEP(gz);
+            demokeyframe &k = index.add();
+            k.millis = entry[1];
+            k.offset = int(file->tell());
+            gz = opengzfile(nullptr, "wb", file);
+        }
+        if(!gz) return false;
+        if(op != OP_DATA)
+        {
+            int stamp[3] = { entry[1], entry[2], datalen };
+            lilswap(stamp, 3);
+            if(gz->write(stamp, sizeof(stamp)) != sizeof(stamp)) return false;
+        }
+        if(gz->write(buf, datalen) != size_t(datalen)) return false;
+        buf += datalen;
+    }
+    return true;
+}
+
+void demowriter::run()
+{
+    stream *gz = opengzfile(nullptr, "wb", file);
+    vector<uchar> batch;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            queued.wait(guard, [this] { return used || stopping; });
+            if(!used) break;
+            // entries are always queued whole, so this takes complete ones only
+            int first = min(used, ringsize - head);
+            batch.setsize(0);
+            batch.put(&ring[head], first);
+            batch.put(ring, used - first);
+            head = (head + used) % ringsize;
+            used = 0;
+        }
+        drained.notify_one();
+        if(failed) continue;
+        bool ok = write(gz, batch.getbuf(), batch.length());
+        if(gz) rawsize = int(gz->rawtell());
+        if(!ok)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            failed = true;
+            drained.notify_one();
+        }
+    }
+    DELETEP(gz);
+}
+
+bool demowriter::finish()
+{
+    if(thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        queued.notify_one();
+        thread.join();
+    }
+    DELETEA(ring);
+    return !failed;
+}
+
 void prunedemos(int extra = 0)
 {
     int n = clamp(demos.length() + extra - maxdemos, 0, demos.length());
     if(n <= 0) return;
-    loopi(n) delete[] demos[i].data;
+    loopi(n) DELETEP(demos[i].file);
     demos.remove(0, n);
 }
 
 void adddemo()
 {
     if(!demotmp) return;
-    int len = (int)min(demotmp->size(), stream::offset((maxdemosize<<20) + 0x10000));
+    int len = (int)demotmp->size();
     demofile &d = demos.add();
     time_t t = time(nullptr);
     char *timestr = ctime(&t), *trim = timestr + strlen(timestr);
     while(trim>timestr && iscubespace(*--trim)) *trim = '\0';
     formatstring(d.info, "%s: %s, %s, %.2f%s", timestr, modename(gamemode), smapname, len > 1024*1024 ? len/(1024*1024.f) : len/1024.0f, len > 1024*1024 ? "MB" : "kB");
     sendservmsgf("demo \"%s\" recorded", d.info);
-    d.data = new uchar[len];
+    d.file = demotmp;
     d.len = len;
-    demotmp->seek(0, SEEK_SET);
-    demotmp->read(d.data, len);
-    DELETEP(demotmp);
+    d.tmpid = demotmpid;
+    demotmp = nullptr;
 }
 
 void enddemorecord()
 {
     if(!demorecord) return;
 
+    bool written = demorecord->finish();
+    vector<uchar> index;
+    putdemoindex(index, demorecord->index);
     DELETEP(demorecord);
 
     if(!demotmp) return;
-    if(!maxdemos || !maxdemosize) { DELETEP(demotmp); return; }
+    if(!written || !maxdemos || !maxdemosize) { DELETEP(demotmp); return; }
+
+    demotmp->write(index.getbuf(), index.length());
 
     prunedemos(1);
     adddemo();
 }
 
+extern int welcomepacket(packetbuf &p, clientinfo *ci);
+extern void sendwelcome(clientinfo *ci);
+
+/// Start a new segment of the demo with a snapshot of the game state.
+static void writekeyframe()
+{
+    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+    welcomepacket(p, nullptr);
+    demorecord->putkeyframe(gamemillis, p.buf, p.len);
+    lastkeyframe = gamemillis;
+}
+
 void writedemo(int chan, void *data, int len)
 {
     if(!demorecord) return;
-    int stamp[3] ={gamemillis, chan, len};
-    lilswap(stamp, 3);
-    demorecord->write(stamp, sizeof(stamp));
-    demorecord->write(data, len);
-    if(demorecord->rawtell() >= (maxdemosize<<20)) enddemorecord();
+    if(demokeyframeinterval && gamemillis - lastkeyframe >= demokeyframeinterval*1000) writekeyframe();
+    demorecord->putrecord(gamemillis, chan, data, len);
+    if(demorecord->rawsize >= (maxdemosize<<20)) enddemorecord();
 }
 
 void recordpacket(int chan, void *data, int len)
@@ -88,33 +390,31 @@ void recordpacket(int chan, void *data, int len)
     writedemo(chan, data, len);
 }
 
-extern int welcomepacket(packetbuf &p, clientinfo *ci);
-extern void sendwelcome(clientinfo *ci);
-
 void setupdemorecord()
 {
     if(m_edit) return;
 
-    demotmp = opentempfile("demorecord", "w+b");
+    // stored demos keep their temporary files, so pick a name none of them uses
+    for(demotmpid = 0;; demotmpid++)
+    {
+        bool used = false;
+        loopv(demos) if(demos[i].tmpid == demotmpid) { used = true; break; }
+        if(!used) break;
+    }
+    defformatstring(tmpname, "demorecord%d", demotmpid);
+    demotmp = opentempfile(tmpname, "w+b");
     if(!demotmp) return;
 
-    stream *f = opengzfile(nullptr, "wb", demotmp);
-    if(!f) { DELETEP(demotmp); return; }
-
     sendservmsg("recording demo");
 
-    demorecord = f;
-
     demoheader hdr;
     memcpy(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic));
     hdr.version = DEMO_VERSION;
     hdr.protocol = PROTOCOL_VERSION;
     lilswap(&hdr.version, 2);
-    demorecord->write(&hdr, sizeof(demoheader));
+    demorecord = new demowriter(demotmp, hdr);
 
-    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
-    welcomepacket(p, nullptr);
-    writedemo(1, p.buf, p.len);
+    writekeyframe();
 }
 
 void listdemos(int cn)
@@ -130,13 +430,13 @@ void cleardemos(int n)
 {
     if(!n)
     {
-        loopv(demos) delete[] demos[i].data;
+        loopv(demos) DELETEP(demos[i].file);
         demos.shrink(0);
         sendservmsg("cleared all demos");
     }
     else if(demos.inrange(n-1))
     {
-        delete[] demos[n-1].data;
+        DELETEP(demos[n-1].file);
         demos.remove(n-1);
         sendservmsgf("cleared demo %d", n);
     }
@@ -152,14 +452,41 @@ static void freegetdemo(ENetPacket *packet)
     }
 }
 
-void senddemo(clientinfo *ci, int num)
+void senddemo(clientinfo *ci, int num, int from)
 {
     if(ci->getdemo) return;
     if(!num) num = demos.length();
     if(!demos.inrange(num-1)) return;
     demofile &d = demos[num-1];
-    if((ci->getdemo = sendf(ci->clientnum, 2, "rim", N_SENDDEMO, d.len, d.data)))
-        ci->getdemo->freeCallback = freegetdemo;
+
+    // demos stay on disk, only pull them into memory while building the packet
+    size_t maplen = 0;
+    uchar *data = (uchar *)d.file->map(maplen);
+    bool mapped = data && maplen >= size_t(d.len);
+    if(!mapped)
+    {
+        if(data) d.file->unmap(data, maplen);
+        data = new uchar[d.len];
+        if(!d.file->seek(0, SEEK_SET) || d.file->read(data, d.len) != size_t(d.len)) { delete[] data; return; }
+    }
+
+    vector<demokeyframe> index;
+    int k = from > 0 && getdemoindex(data, d.len, index) ? findkeyframe(index, from) : 0;
+    if(k > 0)
+    {
+        // glue the header member to the segments from keyframe k on, which still makes a valid demo
+        int headerlen = index[0].offset, shift = index[k].offset - headerlen, indexstart = d.len - demoindexsize(index.length());
+        vector<uchar> part;
+        part.put(data, headerlen);
+        part.put(&data[index[k].offset], indexstart - index[k].offset);
+        putdemoindex(part, index, k, shift);
+        ci->getdemo = sendf(ci->clientnum, 2, "rim", N_SENDDEMO, part.length(), part.getbuf());
+    }
+    else ci->getdemo = sendf(ci->clientnum, 2, "rim", N_SENDDEMO, d.len, data);
+    if(ci->getdemo) ci->getdemo->freeCallback = freegetdemo;
+
+    if(mapped) d.file->unmap(data, maplen);
+    else delete[] data;
 }
 
 void enddemoplayback()
@@ -182,16 +509,15 @@ void setupdemoplayback()
     string msg;
     msg[0] = '\0';
     defformatstring(file, "%s.dmo", smapname);
-    demoplayback = opengzfile(file, "rb");
-    if(!demoplayback) formatstring(msg, "could not read demo \"%s\"", file);
-    else if(demoplayback->read(&hdr, sizeof(demoheader))!=sizeof(demoheader) || memcmp(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic)))
-        formatstring(msg, "\"%s\" is not a demo file", file);
-    else
+    demoplayback = new demoreader;
+    if(!demoplayback->open(file, hdr))
     {
-        lilswap(&hdr.version, 2);
-        if(hdr.version!=DEMO_VERSION) formatstring(msg, "demo \"%s\" requires an %s version of Inexor", file, hdr.version<DEMO_VERSION ? "older" : "newer");
-        else if(hdr.protocol!=PROTOCOL_VERSION) formatstring(msg, "demo \"%s\" requires an %s version of Inexor", file, hdr.protocol<PROTOCOL_VERSION ? "older" : "newer");
+        if(!demoplayback->file) formatstring(msg, "could not read demo \"%s\"", file);
+        else formatstring(msg, "\"%s\" is not a demo file", file);
     }
+    else if(hdr.version!=DEMO_VERSION) formatstring(msg, "demo \"%s\" requires an %s version of Inexor", file, hdr.version<DEMO_VERSION ? "older" : "newer");
+    else if(hdr.protocol!=PROTOCOL_VERSION) formatstring(msg, "demo \"%s\" requires an %s version of Inexor", file, hdr.protocol<PROTOCOL_VERSION ? "older" : "newer");
+    else if(!demoplayback->readindex()) formatstring(msg, "demo \"%s\" has a damaged keyframe index", file);
     if(msg[0])
     {
         DELETEP(demoplayback);
@@ -201,52 +527,84 @@ void setupdemoplayback()
 
     sendservmsgf("playing demo \"%s\"", file);
 
-    demomillis = 0;
     sendf(-1, 1, "ri3", N_DEMOPLAYBACK, 1, -1);
 
-    if(demoplayback->read(&nextplayback, sizeof(nextplayback))!=sizeof(nextplayback))
+    if(!demoplayback->readstamp(nextplayback))
     {
         enddemoplayback();
         return;
     }
-    lilswap(&nextplayback, 1);
+    demomillis = nextplayback;
+    demokeyframepending = true;
 }
 
-void readdemo()
+/// Send all records up to demomillis to the clients.
+static void playdemo()
 {
-    if(!demoplayback) return;
-    demomillis += curtime;
     while(demomillis>=nextplayback)
     {
         int chan, len;
-        if(demoplayback->read(&chan, sizeof(chan))!=sizeof(chan) ||
-           demoplayback->read(&len, sizeof(len))!=sizeof(len))
+        if(!demoplayback->read(&chan, sizeof(chan)) || !demoplayback->read(&len, sizeof(len)))
         {
             enddemoplayback();
             return;
         }
         lilswap(&chan, 1);
         lilswap(&len, 1);
-        ENetPacket *packet = enet_packet_create(nullptr, len+1, 0);
-        if(!packet || demoplayback->read(packet->data+1, len)!=size_t(len))
+        if(chan == DEMO_KEYFRAME && !demokeyframepending)
         {
-            if(packet) enet_packet_destroy(packet);
-            enddemoplayback();
-            return;
+            // the state it holds has already been built up by the preceding records
+            if(!demoplayback->skip(len))
+            {
+                enddemoplayback();
+                return;
+            }
         }
-        packet->data[0] = N_DEMOPACKET;
-        sendpacket(-1, chan, packet);
-        if(!packet->referenceCount) enet_packet_destroy(packet);
-        if(!demoplayback) break;
-        if(demoplayback->read(&nextplayback, sizeof(nextplayback))!=sizeof(nextplayback))
+        else
+        {
+            if(chan == DEMO_KEYFRAME) chan = 1;
+            demokeyframepending = false;
+            ENetPacket *packet = len >= 0 ? enet_packet_create(nullptr, len+1, 0) : nullptr;
+            if(!packet || !demoplayback->read(packet->data+1, len))
+            {
+                if(packet) enet_packet_destroy(packet);
+                enddemoplayback();
+                return;
+            }
+            packet->data[0] = N_DEMOPACKET;
+            sendpacket(-1, chan, packet);
+            if(!packet->referenceCount) enet_packet_destroy(packet);
+            if(!demoplayback) break;
+        }
+        if(!demoplayback->readstamp(nextplayback))
         {
             enddemoplayback();
             return;
         }
-        lilswap(&nextplayback, 1);
     }
 }
 
+void readdemo()
+{
+    if(!demoplayback) return;
+    demomillis += curtime;
+    playdemo();
+}
+
+void seekdemo(int millis)
+{
+    if(!demoplayback) return;
+    if(!demoplayback->seeksegment(findkeyframe(demoplayback->index, millis)) || !demoplayback->readstamp(nextplayback))
+    {
+        enddemoplayback();
+        return;
+    }
+    sendservmsgf("seeking demo to %d:%02d", max(millis, 0)/60000, (max(millis, 0)/1000)%60);
+    demomillis = max(millis, nextplayback);
+    demokeyframepending = true;
+    playdemo();
+}
+
 void stopdemo()
 {
     if(m_demo) enddemoplayback();
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <atomic>                         // for atomic
+#include <condition_variable>             // for condition_variable
+#include <mutex>                          // for mutex
+#include <thread>                         // for thread
+
 #include "inexor/network/SharedVar.hpp"   // for SharedVar
+#include "inexor/network/legacy/game_types.hpp" // for demoheader, demokeyframe
 #include "inexor/shared/cube_types.hpp"   // for string, uchar
 #include "inexor/shared/cube_vector.hpp"  // for vector
 
@@ -12,19 +18,81 @@ struct stream;
 namespace server
 {
 
+/// A recorded demo, kept in its temporary file on disk.
 struct demofile
 {
     string info;
-    uchar *data;
+    stream *file;
     int len;
+    int tmpid;  ///< names the temporary file on platforms without anonymous ones
 };
 
 extern vector<demofile> demos;
-extern SharedVar<int> maxdemos, maxdemosize;
+extern SharedVar<int> maxdemos, maxdemosize, demokeyframeinterval, demowritebuffer;
+
+/// Compresses the demo being recorded on a background thread.
+/// The game thread only copies records into a bounded ring buffer, which the writer thread drains.
+struct demowriter
+{
+    stream *file;                       ///< the raw temporary file, owned by the caller
+    vector<demokeyframe> index;         ///< only safe to read after finish()
+    std::atomic<int> rawsize { 0 };     ///< compressed bytes written so far
+
+    /// Start the thread, the header goes into a gzip member of its own.
+    demowriter(stream *file, const demoheader &hdr);
+    ~demowriter() { finish(); }
+
+    void putrecord(int millis, int chan, const void *data, int len);
+    /// Start a new gzip member with a snapshot of the game state.
+    void putkeyframe(int millis, const void *data, int len);
+
+    /// Write everything still queued and end the last gzip member, false if writing failed.
+    bool finish();
+
+    enum { OP_DATA = 0, OP_RECORD, OP_KEYFRAME };
+
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable queued, drained;
+    uchar *ring;
+    int ringsize, head = 0, used = 0;
+    bool stopping = false, failed = false;
+
+    void put(int op, int millis, int chan, const void *data, int len);
+    void copyin(const void *data, int len);
+    void run();
+    bool write(stream *&gz, const uchar *buf, int len);
+};
 
-/// The streams for demo playback or demo recording.
+/// Sequential reader over the records of a demo file, hiding its keyframe segments.
+struct demoreader
+{
+    stream *file = nullptr;     ///< the raw demo file
+    stream *segment = nullptr;  ///< gzip stream over the keyframe segment currently read
+    vector<demokeyframe> index;
+    int cursegment = -1;
+
+    ~demoreader() { close(); }
+
+    /// Open the file and read its header, false if it is no demo at all.
+    bool open(const char *filename, demoheader &hdr);
+    /// Load the keyframe index from the end of the file and start reading at the first keyframe.
+    bool readindex();
+    void close();
+
+    /// Continue reading at the start of keyframe segment k.
+    bool seeksegment(int k);
+
+    /// Read the timestamp of the next record, moving on to the next segment at the end of the current one.
+    bool readstamp(int &millis);
+    bool read(void *buf, int len);
+    bool skip(int len);
+};
+
+/// The writer for demo recording and the reader for demo playback.
 /// set to nullptr if not recording/playing a demo.
-extern stream *demorecord, *demoplayback;
+extern demowriter *demorecord;
+extern demoreader *demoplayback;
 
 /// Whether we want to record a demo next match.
 extern bool demonextmatch;
@@ -38,6 +106,9 @@ extern void setupdemoplayback();
 extern void readdemo();
 extern void enddemoplayback();
 
+/// Jump to the last keyframe before millis and fast forward from there.
+extern void seekdemo(int millis);
+
 /// Wrapper for either enddemoplayback or enddemorecord, depending on m_demo.
 extern void stopdemo();
 
@@ -53,6 +124,7 @@ extern void listdemos(int cn);
 /// If client ci is not receiving one yet and num is valid.
 /// @param ci info of connected clients on server side
 /// @param num if 0 send the latest demo.
-extern void senddemo(clientinfo *ci, int num);
+/// @param from if > 0 only send the part starting at the last keyframe before this game time.
+extern void senddemo(clientinfo *ci, int num, int from = 0);
 
 } // ns server
@@ -0,0 +1,81 @@
+#include <chrono>                           // for duration, steady_clock
+#include <memory>                           // for unique_ptr
+
+#include "inexor/io/Logging.hpp"            // for Log, Logger
+#include "inexor/server/gameevents.hpp"
+#include "inexor/shared/command.hpp"        // for COMMAND
+#include "inexor/shared/cube_loops.hpp"     // for i, loopi, loopj, loopk
+#include "inexor/shared/cube_vector.hpp"    // for vector
+
+namespace server {
+
+/// The heap allocated, polymorphic events gameeventqueue replaced, to compare against.
+struct legacyevent
+{
+    virtual ~legacyevent() {}
+    virtual void process(int &damage) {}
+};
+
+struct legacyshot : legacyevent
+{
+    int millis, id, gun;
+    vec from, to;
+    vector<hitinfo> hits;
+
+    void process(int &damage) override { loopv(hits) damage += hits[i].rays; }
+};
+
+/// Queue and process n rounds of game events the old way and with gameeventqueue:
+/// every one of 32 clients shoots four times with three hits per round, then all events get processed.
+static void eventbench(int *num)
+{
+    const int NUMCLIENTS = 32, NUMHITS = 3;
+    int rounds = *num > 0 ? *num : 20000, olddamage = 0, newdamage = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    vector<legacyevent *> legacy[NUMCLIENTS];
+    loopi(rounds)
+    {
+        loopj(NUMCLIENTS) loopk(4)
+        {
+            legacyshot *shot = new legacyshot;
+            shot->millis = i;
+            loopl(NUMHITS) shot->hits.add().rays = 1;
+            legacy[j].add(shot);
+        }
+        loopj(NUMCLIENTS) while(legacy[j].length())
+        {
+            legacy[j][0]->process(olddamage);
+            delete legacy[j].remove(0);
+        }
+    }
+    auto legacydone = std::chrono::steady_clock::now();
+
+    std::unique_ptr<gameeventqueue[]> queues(new gameeventqueue[NUMCLIENTS]);
+    loopi(rounds)
+    {
+        loopj(NUMCLIENTS) loopk(4)
+        {
+            gameeventqueue &q = queues[j];
+            gameevent *e = q.add(EV_SHOT);
+            e->millis = i;
+            loopl(NUMHITS) q.addhit(*e)->rays = 1;
+        }
+        loopj(NUMCLIENTS) while(!queues[j].empty())
+        {
+            gameeventqueue &q = queues[j];
+            gameevent &e = q.first();
+            loopl(e.numhits) newdamage += q.hit(e, l).rays;
+            q.removefirst();
+        }
+    }
+    auto queuedone = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> before = legacydone - start, after = queuedone - legacydone;
+    double events = double(NUMCLIENTS) * 4 * rounds;
+    Log.std->info("eventbench: {} game events per second before, {} with gameeventqueue{}",
+                  int(events / before.count()), int(events / after.count()), olddamage == newdamage ? "" : " (results differ!)");
+}
+COMMAND(eventbench, "i");
+
+} // ns server
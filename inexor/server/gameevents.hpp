@@ -0,0 +1,116 @@
+#pragma once
+
+#include "inexor/shared/cube_loops.hpp"              // for loopj
+#include "inexor/shared/geom.hpp"                    // for vec
+
+namespace server {
+
+struct hitinfo
+{
+    int target;
+    int lifesequence;
+    int rays;
+    float dist;
+    vec dir;
+};
+
+enum
+{
+    EV_SHOT = 0,
+    EV_EXPLODE,
+    EV_SUICIDE,
+    EV_PICKUP
+};
+
+/// Something a client did, processed once the game time reaches it.
+/// Shots and explosions are timed, suicides and pickups get processed on the next update.
+struct gameevent
+{
+    int type, millis;
+    int id;       ///< projectile id, or the entity for pickups
+    int gun;
+    vec from, to;
+    int firsthit, numhits;
+
+    bool timed() const { return type == EV_SHOT || type == EV_EXPLODE; }
+
+    /// Projectiles fired before a respawn still explode afterwards.
+    bool keepable() const { return type == EV_EXPLODE; }
+};
+
+/// The pending events of a client.
+///
+/// A fixed size ring of events, the hits of all events go to a second ring.
+/// Nothing gets allocated while playing and events never move while queued,
+/// so references to them stay valid while they get processed.
+struct gameeventqueue
+{
+    enum { MAXEVENTS = 128, MAXHITS = 1024 }; // powers of two
+
+    gameevent events[MAXEVENTS];
+    hitinfo hits[MAXHITS];
+    int tail = 0, head = 0, hittail = 0, hithead = 0;
+    /// Events and hits refused because the queue was full, until someone reports and resets them.
+    int droppedevents = 0, droppedhits = 0;
+
+    int length() const { return head - tail; }
+    bool empty() const { return head == tail; }
+
+    gameevent &operator[](int i) { return events[(tail + i) & (MAXEVENTS-1)]; }
+    gameevent &first() { return events[tail & (MAXEVENTS-1)]; }
+    hitinfo &hit(const gameevent &e, int i) { return hits[(e.firsthit + i) & (MAXHITS-1)]; }
+
+    /// Queue a new event.
+    /// @return nullptr if the queue is full.
+    gameevent *add(int type)
+    {
+        if(length() >= MAXEVENTS) { droppedevents++; return nullptr; }
+        gameevent &e = events[head++ & (MAXEVENTS-1)];
+        e.type = type;
+        e.millis = e.id = e.gun = 0;
+        e.firsthit = hithead;
+        e.numhits = 0;
+        return &e;
+    }
+
+    /// Add a hit to the most recently added event e.
+    /// @return nullptr if there is no room left for hits.
+    hitinfo *addhit(gameevent &e)
+    {
+        if(hithead - hittail >= MAXHITS) { droppedhits++; return nullptr; }
+        e.numhits++;
+        return &hits[hithead++ & (MAXHITS-1)];
+    }
+
+    void removefirst()
+    {
+        if(empty()) return; // processing the event may have cleared the queue
+        tail++;
+        hittail = empty() ? hithead : first().firsthit;
+    }
+
+    void clear()
+    {
+        tail = head = hittail = hithead = 0;
+    }
+
+    /// Drop all events except for the keepable ones, which move up together with their hits.
+    void clearunkept()
+    {
+        int keep = tail, keephit = hittail;
+        for(int i = tail; i < head; i++)
+        {
+            gameevent &e = events[i & (MAXEVENTS-1)];
+            if(!e.keepable()) continue;
+            if(e.firsthit != keephit) loopj(e.numhits) hits[(keephit + j) & (MAXHITS-1)] = hits[(e.firsthit + j) & (MAXHITS-1)];
+            e.firsthit = keephit;
+            keephit += e.numhits;
+            if(keep != i) events[keep & (MAXEVENTS-1)] = e;
+            keep++;
+        }
+        head = keep;
+        hithead = keephit;
+    }
+};
+
+} // ns server
@@ -0,0 +1,107 @@
+#include <algorithm>                             // for max, min
+#include <chrono>                                // for duration, steady_...
+
+#include "inexor/fpsgame/guns.hpp"               // for guns, guninfo
+#include "inexor/io/Logging.hpp"                 // for Log, Logger
+#include "inexor/server/client_management.hpp"   // for clientinfo, get_cl...
+#include "inexor/server/gameevents.hpp"          // for gameevent, hitinfo
+#include "inexor/server/hitverify.hpp"
+#include "inexor/shared/command.hpp"             // for VAR, ICOMMAND
+#include "inexor/util/legacy_time.hpp"           // for gamemillis
+
+namespace server {
+
+VAR(hitverify, 0, 0, 1);
+VAR(hitverifyrewind, 0, 300, 1000);
+VAR(hitverifytolerance, 0, 4, 64);
+
+static struct
+{
+    std::chrono::steady_clock::duration tick, total, worst;
+    int ticks, shots, hits, rejected;
+} stats;
+
+void recordhitbox(clientinfo *ci)
+{
+    if(hitverify) ci->hitboxes.add(gamemillis, ci->state.o);
+}
+
+/// The time the shooter ci saw the targets of an event at millis.
+static int rewindtime(clientinfo *ci, int millis)
+{
+    clientinfo *owner = get_client_info(ci->ownernum);
+    return hitrewindtime(millis, owner ? owner->ping : ci->ping, hitverifyrewind);
+}
+
+/// Test the segment from -> from+ray against the hitboxes of the targets of e at time, each grown by margin
+/// plus spread per unit of distance, and invalidate the hits on the ones it misses.
+static void rejectmisses(clientinfo *ci, gameevent &e, int time, const vec &from, const vec &ray, float margin, float spread)
+{
+    auto start = std::chrono::steady_clock::now();
+    hitbatch batch;
+    for(int i = 0; i < e.numhits;)
+    {
+        for(batch.num = 0; i < e.numhits && !batch.full(); i++)
+        {
+            clientinfo *target = get_client_info(ci->events.hit(e, i).target);
+            vec o;
+            if(!target || !target->hitboxes.rewind(time, o)) continue; // nothing to check against, processshot() decides
+            batch.add(i, o, margin + spread * from.dist(o));
+        }
+        batch.trace(from, ray);
+        for(int j = 0; j < batch.num; j++) if(batch.missed[j])
+        {
+            ci->events.hit(e, batch.hits[j]).target = -1;
+            stats.rejected++;
+        }
+    }
+    stats.shots++;
+    stats.hits += e.numhits;
+    stats.tick += std::chrono::steady_clock::now() - start;
+}
+
+void verifyhits(clientinfo *ci, gameevent &e)
+{
+    if(!hitverify || e.type != EV_SHOT || !e.numhits) return;
+    const guninfo &gun = guns[e.gun];
+    if(gun.projspeed) return;
+
+    // Hits end the sent ray on the hitbox the client saw, and pellets of guns with more than one ray
+    // spread around it (see offsetray() on the client), so test the aimed ray over the full range and
+    // grow every box by the spread at its distance instead of tracing single pellets.
+    vec ray = vec(e.to).sub(e.from);
+    float len = ray.magnitude();
+    if(len <= 0) return;
+    ray.mul(std::max(float(gun.range), len) / len);
+    rejectmisses(ci, e, rewindtime(ci, e.millis), e.from, ray, hitverifytolerance, gun.rays > 1 ? gun.spread / 2048.0f : 0);
+}
+
+void verifyexplosion(clientinfo *ci, gameevent &e, const projectilelaunch &launch)
+{
+    if(!hitverify || e.type != EV_EXPLODE || e.gun != GUN_RL || !e.numhits) return;
+    const guninfo &gun = guns[e.gun];
+    // the rocket exploded somewhere on the way it flew so far, so its targets were within its radius of that
+    vec path = rocketpath(launch.from, launch.to, gun.projspeed, e.millis - launch.millis, hitverifytolerance);
+    rejectmisses(ci, e, rewindtime(ci, e.millis), launch.from, path, gun.exprad + hitverifytolerance, 0);
+}
+
+void hitverifytick()
+{
+    if(!hitverify) return;
+    stats.ticks++;
+    stats.total += stats.tick;
+    stats.worst = std::max(stats.worst, stats.tick);
+    stats.tick = std::chrono::steady_clock::duration::zero();
+}
+
+static void hitverifystats()
+{
+    typedef std::chrono::duration<double, std::milli> ms;
+    Log.std->info("hitverify: {} shots with {} hits checked, {} rejected", stats.shots, stats.hits, stats.rejected);
+    Log.std->info("  {:.4f} ms per tick on average, {:.4f} ms at most ({} ticks)",
+                  stats.ticks ? ms(stats.total).count() / stats.ticks : 0.0, ms(stats.worst).count(), stats.ticks);
+    stats = {};
+}
+COMMAND(hitverifystats, "");
+
+} // ns server
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <math.h>                        // for fabs
+#include <algorithm>                     // for max, min
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+#include "inexor/shared/geom.hpp"        // for vec
+
+namespace server {
+struct clientinfo;
+struct gameevent;
+struct projectilelaunch;
+}  // namespace server
+
+namespace server
+{
+
+/// Lag compensated hit verification.
+///
+/// Clients decide themselves whom they hit. With hitverify enabled the server remembers where every
+/// player was over the last second, rewinds the targets of a shot to the time the shooter saw them
+/// (the shot time minus the shooters ping) and drops hits whose ray misses the rewound hitbox.
+/// The server has no octree loaded, so walls between shooter and target can not be checked; the
+/// clients already clip the ray they send to the world though.
+/// Rocket explosions are checked against the part of the rocket's path it can have flown by then.
+/// Grenades, bombs and splinters are not checked, the server does not know how they bounced.
+
+/// Whether to verify the hits of hitscan weapons.
+extern SharedVar<int> hitverify;
+/// Maximum time (in milliseconds) to rewind targets, higher pings get their hits checked at this age.
+extern SharedVar<int> hitverifyrewind;
+/// Extra distance (in cube units) a ray may pass besides a hitbox, to allow for interpolation errors.
+extern SharedVar<int> hitverifytolerance;
+
+/// The bounding box of a player (see physent), the server does not know any other.
+static const float HITBOX_RADIUS = 4.1f, HITBOX_EYEHEIGHT = 14, HITBOX_ABOVEEYE = 1;
+
+/// Bounds of the hitbox of a player standing at feet, grown by margin on every side.
+/// Clients send the position of the feet (see sendposition()), not the one of the eyes.
+inline void hitboxbounds(const vec &feet, float margin, vec &lo, vec &hi)
+{
+    lo = vec(feet.x - HITBOX_RADIUS - margin, feet.y - HITBOX_RADIUS - margin, feet.z - margin);
+    hi = vec(feet.x + HITBOX_RADIUS + margin, feet.y + HITBOX_RADIUS + margin, feet.z + HITBOX_EYEHEIGHT + HITBOX_ABOVEEYE + margin);
+}
+
+/// The time the targets of an event at millis get rewound to: the shooter saw them one ping before.
+inline int hitrewindtime(int millis, int ping, int maxrewind)
+{
+    return millis - std::max(0, std::min(ping, maxrewind));
+}
+
+/// Hitboxes to test a ray against in one go, stored per axis so the slab test vectorizes.
+struct hitbatch
+{
+    enum { SIZE = 64 };
+
+    float lo[3][SIZE], hi[3][SIZE];
+    int hits[SIZE]; ///< the index of the hit each box belongs to
+    bool missed[SIZE];
+    int num = 0;
+
+    bool full() const { return num >= SIZE; }
+
+    /// Add the hitbox of a player standing at feet, grown by margin.
+    void add(int hit, const vec &feet, float margin)
+    {
+        vec boxlo, boxhi;
+        hitboxbounds(feet, margin, boxlo, boxhi);
+        for(int k = 0; k < 3; k++)
+        {
+            lo[k][num] = boxlo[k];
+            hi[k][num] = boxhi[k];
+        }
+        hits[num++] = hit;
+    }
+
+    /// Slab test of the segment from -> from+ray against all boxes, free of branches so it vectorizes.
+    void trace(const vec &from, const vec &ray)
+    {
+        float invray[3];
+        for(int k = 0; k < 3; k++) invray[k] = 1 / (fabs(ray[k]) > 1e-6f ? ray[k] : 1e-6f);
+        for(int j = 0; j < num; j++)
+        {
+            float tmin = 0, tmax = 1;
+            for(int k = 0; k < 3; k++)
+            {
+                float t1 = (lo[k][j] - from[k]) * invray[k], t2 = (hi[k][j] - from[k]) * invray[k];
+                tmin = std::max(tmin, std::min(t1, t2));
+                tmax = std::min(tmax, std::max(t1, t2));
+            }
+            missed[j] = tmin > tmax;
+        }
+    }
+};
+
+/// The part of the way from -> to a rocket flying at speed can have covered after flight milliseconds,
+/// plus slack. Rockets fly straight and explode at to at the latest.
+inline vec rocketpath(const vec &from, const vec &to, int speed, int flight, float slack)
+{
+    vec ray = vec(to).sub(from);
+    float len = ray.magnitude();
+    if(len <= 0) return ray;
+    return ray.mul(std::min(len, speed * std::max(flight, 0) / 1000.0f + slack) / len);
+}
+
+/// Positions of a player over the last second, oldest first in a ring.
+/// Every field has its own array so rewinding the targets of a shot only touches what it needs.
+struct hitboxhistory
+{
+    enum { SIZE = 32 }; // positions arrive about 30 times a second
+
+    int millis[SIZE];
+    float x[SIZE], y[SIZE], z[SIZE];
+    int newest = -1, count = 0;
+
+    void reset() { newest = -1; count = 0; }
+
+    void add(int time, const vec &o)
+    {
+        newest = (newest + 1) % SIZE;
+        millis[newest] = time;
+        x[newest] = o.x;
+        y[newest] = o.y;
+        z[newest] = o.z;
+        if(count < SIZE) count++;
+    }
+
+    /// Interpolated position of the feet at time, clamped to the remembered range.
+    /// @return false if nothing is remembered.
+    bool rewind(int time, vec &o) const
+    {
+        if(!count) return false;
+        int cur = newest, next = -1;
+        for(int i = 1; i < count && millis[cur] > time; i++)
+        {
+            next = cur;
+            cur = (cur + SIZE - 1) % SIZE;
+        }
+        if(next < 0 || millis[cur] > time) o = vec(x[cur], y[cur], z[cur]);
+        else
+        {
+            float t = float(time - millis[cur]) / (millis[next] - millis[cur]);
+            o = vec(x[cur], y[cur], z[cur]).lerp(vec(x[next], y[next], z[next]), t);
+        }
+        return true;
+    }
+};
+
+/// Remember the current position of ci at the current game time.
+extern void recordhitbox(clientinfo *ci);
+
+/// Invalidate (set the target to -1) all hits of the shot e by ci whose ray misses the target.
+extern void verifyhits(clientinfo *ci, gameevent &e);
+
+/// Invalidate all hits of the explosion e of a rocket launched by ci whose target was out of its reach.
+extern void verifyexplosion(clientinfo *ci, gameevent &e, const projectilelaunch &launch);
+
+/// Fold the time spent verifying since the last call into the per tick statistics (see hitverifystats).
+extern void hitverifytick();
+
+} // ns server
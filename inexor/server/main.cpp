@@ -2,8 +2,23 @@
 
 #include <limits.h>                                   // for INT_MAX
 #include <stdlib.h>                                   // for atexit, EXIT_SU...
+#include <string.h>                                   // for strncmp
 #include <algorithm>                                  // for max, min
+#include <atomic>                                     // for atomic
+#include <chrono>                                     // for milliseconds
 #include <memory>                                     // for __shared_ptr
+#include <string>                                     // for string, to_string
+#include <thread>                                     // for thread, sleep_...
+#ifndef WIN32
+#include <errno.h>                                    // for errno
+#include <signal.h>                                   // for sigaction, kill
+#include <sys/types.h>                                // for pid_t
+#include <sys/wait.h>                                 // for waitpid, WNOHANG
+#include <unistd.h>                                   // for fork, getppid
+#ifdef __linux__
+#include <sys/prctl.h>                                // for prctl, PR_SET_PDEATHSIG
+#endif
+#endif
 
 #include <enet/enet.h>                                // for enet_socket_des...
 #include "inexor/crashreporter/CrashReporter.hpp"     // for CrashReporter
@@ -15,12 +30,14 @@
 #include "inexor/network/legacy/cube_network.hpp"     // for MAXCLIENTS, MAX...
 #include "inexor/network/legacy/game_types.hpp"       // for server_port
 #include "inexor/server/client_management.hpp"        // for client, disconn...
+#include "inexor/server/network_send.hpp"             // for sendqueuedpackets, runnetcom...
 #include "inexor/server/windows_integration.hpp"      // IWYU pragma: keep
 #include "inexor/shared/command.hpp"                  // for execfile, SVAR
 #include "inexor/shared/cube_loops.hpp"               // for i, loopi
 #include "inexor/shared/cube_tools.hpp"               // for copystring, UNUSED
 #include "inexor/shared/cube_types.hpp"               // for string, uchar
 #include "inexor/shared/tools.hpp"                    // for max, min
+#include "inexor/util/SpscQueue.hpp"                  // for SpscQueue
 #include "inexor/util/Subsystem.hpp"                  // for Metasystem, SUB...
 #include "inexor/util/legacy_time.hpp"                // for updatetime, tot...
 
@@ -130,6 +147,100 @@ SVAR(serverip, "");
 VARF(serverport, 0, INEXOR_SERVER_PORT, MAX_POSSIBLE_PORT, { if(!serverport) serverport = server_port(); });
 
 
+/// Run the network thread: all ENet I/O happens there, the game logic runs in fixed ticks.
+VAR(networkthread, 0, 0, 1);
+/// Length of a game tick (in milliseconds) if the network thread is used.
+VAR(servertick, 1, 5, 100);
+
+static std::thread *netthread = nullptr;
+
+/// The traffic since the last status, moved out of the serverhost by the thread owning it.
+static std::atomic<uint> sentdata(0), receiveddata(0);
+
+static void collecthoststats()
+{
+    sentdata += serverhost->totalSentData;
+    receiveddata += serverhost->totalReceivedData;
+    serverhost->totalSentData = serverhost->totalReceivedData = 0;
+}
+
+/// Display bandwidth stats once a minute, useful for server ops.
+static void printstatus()
+{
+    if(totalmillis-laststatus<=60*1000) return;
+    laststatus = totalmillis;
+    if(!netthread) collecthoststats();
+    uint sent = sentdata.exchange(0), received = receiveddata.exchange(0);
+    if(has_clients() || sent || received)
+        Log.std->info("status: {0} remote clients, {1} send, {2} rec (K/sec)",
+                                     get_num_clients(), (sent/60.0f/1024), (received/60.0f/1024));
+}
+
+/// Connections per peer slot of the serverhost, see peerconnection().
+static vector<uint> peerconnections;
+
+uint peerconnection(ENetPeer *peer)
+{
+    int slot = int(peer - serverhost->peers);
+    while(peerconnections.length() <= slot) peerconnections.add(0);
+    return peerconnections[slot];
+}
+
+/// An event of ENet and the connection of its peer at the time it happened.
+struct netevent
+{
+    ENetEvent event;
+    uint connection;
+    ENetAddress address; ///< of the peer, which may be someone else by the time the game handles the event
+};
+
+/// Tag an event ENet just returned, on the thread owning the serverhost.
+static netevent tagevent(const ENetEvent &event)
+{
+    netevent e;
+    e.event = event;
+    e.address = event.peer->address;
+    e.connection = peerconnection(event.peer);
+    if(event.type == ENET_EVENT_TYPE_CONNECT) e.connection = ++peerconnections[int(event.peer - serverhost->peers)];
+    return e;
+}
+
+static void handleevent(netevent &e)
+{
+    ENetEvent &event = e.event;
+    switch(event.type)
+    {
+        case ENET_EVENT_TYPE_CONNECT:
+        {
+            client &c = add_client_connection(event.peer);
+            c.connection = e.connection;
+            string hn;
+            copystring(c.hostname, (enet_address_get_host_ip(&e.address, hn, sizeof(hn))==0) ? hn : "unknown");
+            Log.std->info("client connected ({0})", c.hostname);
+            int reason = server::clientconnect(c.num, e.address.host);
+            if(reason) disconnect_client(c.num, reason);
+            break;
+        }
+        case ENET_EVENT_TYPE_RECEIVE:
+        {
+            client *c = (client *)event.peer->data;
+            if(c && c->connection == e.connection) process(event.packet, c->num, event.channelID);
+            if(event.packet->referenceCount==0) enet_packet_destroy(event.packet);
+            break;
+        }
+        case ENET_EVENT_TYPE_DISCONNECT:
+        {
+            client *c = (client *)event.peer->data;
+            if(!c || c->connection != e.connection) break; // the slot belongs to someone else by now
+            Log.std->info("disconnected client ({0})", c->hostname);
+            disconnect_client(c->num, DISC_NONE);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 /// main server update
 void serverslice(uint timeout)
 {
@@ -148,14 +259,7 @@ void serverslice(uint timeout)
 
     checkserversockets();
 
-    if(totalmillis-laststatus>60*1000)   // display bandwidth stats, useful for server ops
-    {
-        laststatus = totalmillis;
-        if(has_clients() || serverhost->totalSentData || serverhost->totalReceivedData)
-            Log.std->info("status: {0} remote clients, {1} send, {2} rec (K/sec)",
-                                         get_num_clients(), (serverhost->totalSentData/60.0f/1024), (serverhost->totalReceivedData/60.0f/1024));
-        serverhost->totalSentData = serverhost->totalReceivedData = 0;
-    }
+    printstatus();
 
     ENetEvent event;
     bool serviced = false;
@@ -166,48 +270,99 @@ void serverslice(uint timeout)
             if(enet_host_service(serverhost, &event, timeout) <= 0) break;
             serviced = true;
         }
-        switch(event.type)
-        {
-            case ENET_EVENT_TYPE_CONNECT:
-            {
-                client &c = add_client_connection(event.peer);
-                string hn;
-                copystring(c.hostname, (enet_address_get_host_ip(&c.peer->address, hn, sizeof(hn))==0) ? hn : "unknown");
-                Log.std->info("client connected ({0})", c.hostname);
-                int reason = server::clientconnect(c.num, c.peer->address.host);
-                if(reason) disconnect_client(c.num, reason);
-                break;
-            }
-            case ENET_EVENT_TYPE_RECEIVE:
-            {
-                client *c = (client *)event.peer->data;
-                if(c) process(event.packet, c->num, event.channelID);
-                if(event.packet->referenceCount==0) enet_packet_destroy(event.packet);
-                break;
-            }
-            case ENET_EVENT_TYPE_DISCONNECT:
-            {
-                client *c = (client *)event.peer->data;
-                if(!c) break;
-                Log.std->info("disconnected client ({0})", c->hostname);
-                disconnect_client(c->num, DISC_NONE);
-                break;
-            }
-            default:
-                break;
-        }
+        netevent e = tagevent(event);
+        handleevent(e);
     }
     if(server::sendpackets()) enet_host_flush(serverhost);
 }
 
+/// The events of each peer slot on their way to the game thread, so a flooding client does not hold up the others.
+static inexor::util::SpscQueue<netevent, 256> *slotevents = nullptr;
+/// Network thread: the events of each slot which did not fit into its queue yet.
+static vector<netevent> *pendingevents = nullptr;
+
+static void queueevent(const netevent &e)
+{
+    int slot = int(e.event.peer - serverhost->peers);
+    if(!pendingevents[slot].empty() || !slotevents[slot].push(e)) pendingevents[slot].add(e);
+}
+
+static void queuependingevents()
+{
+    loopi(int(serverhost->peerCount))
+    {
+        vector<netevent> &pending = pendingevents[i];
+        int pushed = 0;
+        while(pushed < pending.length() && slotevents[i].push(pending[pushed])) pushed++;
+        pending.remove(0, pushed);
+    }
+}
+
+/// The network thread is the only one calling into ENet: it runs the commands of the game thread,
+/// lets ENet do its protocol work (acks, resends, reassembly) and passes the events on to the game thread.
+/// Waits at most a millisecond for incoming data, which is the delay commands may see.
+static void networkloop()
+{
+    for(;;)
+    {
+        if(runnetcommands()) enet_host_flush(serverhost);
+        enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+        enet_socket_wait(serverhost->socket, &condition, 1);
+        ENetEvent event;
+        while(enet_host_service(serverhost, &event, 0) > 0) queueevent(tagevent(event));
+        queuependingevents();
+        releasesentpackets();
+        collecthoststats();
+    }
+}
+
+/// A single game tick if the network thread is used: handle the events of every client, update the game
+/// and hand the commands of the tick to the network thread. Sleeps until the next tick afterwards.
+/// The packets are still parsed here, since that changes the game state.
+static void gameslice()
+{
+    static auto nexttick = std::chrono::steady_clock::now();
+    metapp.tick();
+    updatetime(server::ispaused(), server::gamespeed);
+    netevent e;
+    loopi(int(serverhost->peerCount)) while(slotevents[i].pop(e)) handleevent(e);
+    server::serverupdate();
+    checkserversockets();
+    server::sendpackets();
+    printstatus();
+    sendqueuedpackets();
+    nexttick += std::chrono::milliseconds(*servertick);
+    auto now = std::chrono::steady_clock::now();
+    if(nexttick < now) nexttick = now;
+    else std::this_thread::sleep_until(nexttick);
+}
+
+static void reportinstances();
+
+static void runslice()
+{
+    reportinstances();
+    if(netthread) gameslice();
+    else serverslice(5);
+}
+
 void flushserver(bool force)
 {
-    if(server::sendpackets(force) && serverhost) enet_host_flush(serverhost);
+    if(!server::sendpackets(force) || !serverhost) return;
+    if(queuepackets) sendqueuedpackets();
+    else enet_host_flush(serverhost);
 }
 
 void run_server()
 {
     Log.std->info("dedicated server started, waiting for clients...");
+    if(networkthread && serverhost)
+    {
+        slotevents = new inexor::util::SpscQueue<netevent, 256>[serverhost->peerCount];
+        pendingevents = new vector<netevent>[serverhost->peerCount];
+        queuepackets = true;
+        netthread = new std::thread(networkloop);
+    }
 #ifdef WIN32
     SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
     for(;;)
@@ -219,10 +374,10 @@ void run_server()
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
-        serverslice(5);
+        runslice();
     }
 #else
-    for(;;) serverslice(5);
+    for(;;) runslice();
 #endif
     }
 
@@ -264,6 +419,141 @@ bool setup_network_sockets()
     else enet_socket_set_option(lansock, ENET_SOCKOPT_NONBLOCK, 1);
     return true;
 }
+
+/// How many game instances this process hosts (--instances=N on the command line).
+/// Every instance is a forked copy of the process after the init script ran, so configs, map rotations and bans
+/// are shared copy-on-write between them. Each one listens on serverport + 2*instance (the info port is the one above).
+static int numinstances = 1, serverinstance = 0;
+static const int MAXINSTANCES = 64;
+
+#ifndef WIN32
+/// The pids of the forked instances, by instance number, in instance 0.
+/// The SIGCHLD handler negates the pid of an instance it reaped, reportinstances() clears it.
+static volatile pid_t instancepids[MAXINSTANCES];
+static volatile int instancestatus[MAXINSTANCES];
+static volatile sig_atomic_t instancesexited = 0;
+
+/// SIGCHLD handler of instance 0: reap the instances which exited, with async signal safe calls only.
+static void reapinstances(int)
+{
+    int olderrno = errno;
+    for(int i = 1; i < numinstances; i++)
+    {
+        pid_t pid = instancepids[i];
+        int status;
+        if(pid <= 0 || waitpid(pid, &status, WNOHANG) != pid) continue;
+        instancestatus[i] = status;
+        instancepids[i] = -pid;
+        instancesexited = 1;
+    }
+    errno = olderrno;
+}
+
+/// Instance 0 takes the other instances down with it.
+static void killinstances()
+{
+    for(int i = 1; i < numinstances; i++) if(instancepids[i] > 0) kill(instancepids[i], SIGTERM);
+}
+#endif
+
+/// Log the instances the SIGCHLD handler reaped.
+static void reportinstances()
+{
+#ifndef WIN32
+    if(!instancesexited) return;
+    instancesexited = 0;
+    for(int i = 1; i < numinstances; i++) if(instancepids[i] < 0)
+    {
+        int status = instancestatus[i];
+        Log.std->warn("server instance {} (pid {}) exited with status {}", i, -instancepids[i], WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        instancepids[i] = 0;
+    }
+#endif
+}
+
+/// Parse and remove --instances=N from the command line.
+static void parseinstances(int &argc, char **argv)
+{
+    loopi(argc) if(!strncmp(argv[i], "--instances=", 12))
+    {
+        numinstances = clamp(atoi(&argv[i][12]), 1, MAXINSTANCES);
+        for(int j = i; j < argc-1; j++) argv[j] = argv[j+1];
+        argc--;
+        break;
+    }
+}
+
+/// Fork off the additional instances, we stay instance 0.
+/// Returns in every instance with serverinstance set accordingly.
+static void forkinstances()
+{
+#ifdef WIN32
+    if(numinstances > 1) Log.std->warn("multiple server instances are not supported on windows");
+#else
+    if(numinstances <= 1) return;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = reapinstances;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+    // an instance exiting right away gets reaped once its pid is known
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+    pid_t parent = getpid();
+    for(int i = 1; i < numinstances; i++)
+    {
+        pid_t pid = fork();
+        if(pid < 0) { Log.std->error("could not fork server instance {}", i); break; }
+        if(!pid)
+        {
+            serverinstance = i;
+            signal(SIGCHLD, SIG_DFL);
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            if(getppid() != parent) _exit(EXIT_FAILURE); // instance 0 is gone already
+            break;
+        }
+        instancepids[i] = pid;
+    }
+    sigprocmask(SIG_SETMASK, &old, nullptr);
+    if(!serverinstance) atexit(killinstances);
+#endif
+}
+
+/// Move the port of this instance past the ones of the instances before it.
+/// Done after the init script, which may set serverport itself.
+static void offsetinstanceport()
+{
+    if(numinstances <= 1) return;
+    if(serverinstance) serverport = (serverport <= 0 ? server_port() : *serverport) + 2*serverinstance;
+    Log.std->info("server instance {} of {} (port {})", serverinstance, numinstances, serverport <= 0 ? server_port() : *serverport);
+}
+
+/// Start the RPC subsystem. Every instance gets its own port, offset by the instance.
+static void startrpc(int argc, char **argv)
+{
+    metapp.start("rpc");
+    std::string port;
+    if(argc >= 2 && serverinstance)
+    {
+        // the RPC subsystem takes its port from the first argument
+        char *end = nullptr;
+        long base = strtol(argv[1], &end, 10);
+        if(end == argv[1] || *end || base <= 0 || base + serverinstance > 65535)
+            Log.std->error("server instance {}: '{}' is no RPC port, it can not be offset", serverinstance, argv[1]);
+        else
+        {
+            port = std::to_string(base + serverinstance);
+            argv[1] = &port[0];
+        }
+    }
+    metapp.initialize("rpc", argc, argv);
+}
+
 } // ns server
 
 using namespace server;
@@ -277,8 +567,7 @@ int main(int argc, char **argv)
     // Remote Procedure Call: communication with the scripting engine
     SUBSYSTEM_REQUIRE(rpc);
 
-    metapp.start("rpc");
-    metapp.initialize("rpc", argc, argv);
+    parseinstances(argc, argv);
 
     if(enet_initialize()<0) fatal("Unable to initialise network module");
     atexit(enet_deinitialize);
@@ -289,6 +578,12 @@ int main(int argc, char **argv)
     if(initscript) execfile(initscript);
     else execfile("server-init.cfg", false);
 
+    // Everything loaded so far is shared by the instances. The RPC server uses threads,
+    // which do not survive fork(), so it starts afterwards (in every mode, to keep them alike).
+    forkinstances();
+    startrpc(argc, argv);
+    offsetinstanceport();
+
     setup_network_sockets();
 
     run_server(); // never returns
@@ -1,6 +1,7 @@
 
 #include <ctype.h>                                 // for isdigit
 #include <stdarg.h>                                // for va_arg, va_end
+#include <unordered_map>                           // for unordered_map
 
 #include "inexor/network/legacy/buffer_types.hpp"  // for packetbuf
 #include "inexor/network/legacy/cube_network.hpp"  // for putint, make_file_...
@@ -12,12 +13,72 @@
 #include "inexor/shared/cube_loops.hpp"            // for i, loopi, loopv
 #include "inexor/shared/cube_types.hpp"            // for uchar
 #include "inexor/shared/cube_vector.hpp"           // for vector
+#include "inexor/util/SpscQueue.hpp"               // for SpscQueue
 #include "inexor/fpsgame/server.hpp"
 
 struct stream;
 
+namespace server { extern ENetHost *serverhost; }
+
 using namespace server; // TODO move this in there
 
+bool queuepackets = false;
+
+/// Something the game thread wants the network thread to do with ENet.
+struct netcommand
+{
+    enum { SEND, DISCONNECT, RELEASE, DUPLICATEPEERS };
+    int type;
+    ENetPeer *peer;
+    uint connection;    ///< the peerconnection() the command is meant for
+    int arg;            ///< the channel to send on, the reason of the disconnect or the duplicate peers
+    ENetPacket *packet;
+    bool ownsref;       ///< the command carries a reference to packet, which the network thread drops after running it
+};
+/// Game thread: the commands of this tick and those which did not fit into netcommands yet.
+static vector<netcommand> tickcommands;
+static inexor::util::SpscQueue<netcommand, 4096> netcommands;
+
+/// A packet the network thread is done with and how many commands for it it ran since it got it.
+struct sentpacket
+{
+    ENetPacket *packet;
+    uint commands;
+};
+static inexor::util::SpscQueue<sentpacket, 4096> sentpackets;
+/// Network thread: sent packets which did not fit into sentpackets yet.
+static vector<sentpacket> unreportedpackets;
+
+/// Game thread: the packets handed to the network thread, with the number of commands issued for them
+/// and the number the network thread reported done. Once both match the packet is ours again.
+struct publishedpacket
+{
+    uint issued = 0, done = 0;
+};
+static std::unordered_map<ENetPacket *, publishedpacket> publishedpackets;
+
+/// Network thread: the packets it got, each holding one reference of it, with the commands it ran for them.
+static std::unordered_map<ENetPacket *, uint> inflightpackets;
+
+static void queuecommand(int type, ENetPeer *peer, uint connection, int arg, ENetPacket *packet)
+{
+    netcommand &c = tickcommands.add();
+    c.type = type;
+    c.peer = peer;
+    c.connection = connection;
+    c.arg = arg;
+    c.packet = packet;
+    if(type == netcommand::RELEASE) c.ownsref = true;
+    // the reference keeps the packet alive until it is sent, like ENet's would; the count of a packet
+    // the network thread knows is its own to change though, it holds the packet anyway
+    else if(type == netcommand::SEND && publishedpackets.find(packet) == publishedpackets.end())
+    {
+        c.ownsref = true;
+        packet->referenceCount++;
+    }
+    else c.ownsref = false;
+}
+
 void sendpacket(int n, int chan, ENetPacket *packet, int exclude)
 {
     if(n<0)
@@ -26,7 +87,101 @@ void sendpacket(int n, int chan, ENetPacket *packet, int exclude)
         loopv(client_connections) if(i!=exclude && allowbroadcast(i)) sendpacket(i, chan, packet);
         return;
     }
-    if(client_connections[n]->connected) enet_peer_send(client_connections[n]->peer, chan, packet);
+    client &c = *client_connections[n];
+    if(!c.connected) return;
+    if(!queuepackets) enet_peer_send(c.peer, chan, packet);
+    else queuecommand(netcommand::SEND, c.peer, c.connection, chan, packet);
+}
+
+void releasepacket(ENetPacket *packet)
+{
+    if(queuepackets && publishedpackets.find(packet) != publishedpackets.end()) queuecommand(netcommand::RELEASE, nullptr, 0, 0, packet);
+    else if(--packet->referenceCount <= 0) enet_packet_destroy(packet);
+}
+
+void disconnectpeer(ENetPeer *peer, uint connection, int reason)
+{
+    if(queuepackets) queuecommand(netcommand::DISCONNECT, peer, connection, reason, nullptr);
+    else if(peerconnection(peer) == connection) enet_peer_disconnect(peer, reason);
+}
+
+void setduplicatepeers(int duplicatepeers)
+{
+    if(queuepackets) queuecommand(netcommand::DUPLICATEPEERS, nullptr, 0, duplicatepeers, nullptr);
+    else serverhost->duplicatePeers = duplicatepeers;
+}
+
+void sendqueuedpackets()
+{
+    sentpacket s;
+    while(sentpackets.pop(s))
+    {
+        auto it = publishedpackets.find(s.packet);
+        it->second.done += s.commands;
+        if(it->second.done != it->second.issued) continue; // the network thread gets it again
+        publishedpackets.erase(it);
+        s.packet->referenceCount = 0;
+        enet_packet_destroy(s.packet);
+    }
+
+    static int published = 0; // the commands of tickcommands which count as issued already
+    for(; published < tickcommands.length(); published++) if(tickcommands[published].packet) publishedpackets[tickcommands[published].packet].issued++;
+    int pushed = 0;
+    while(pushed < tickcommands.length() && netcommands.push(tickcommands[pushed])) pushed++;
+    tickcommands.remove(0, pushed);
+    published -= pushed;
+}
+
+bool runnetcommands()
+{
+    bool sent = false;
+    netcommand c;
+    while(netcommands.pop(c))
+    {
+        if(c.packet)
+        {
+            auto it = inflightpackets.find(c.packet);
+            if(it == inflightpackets.end())
+            {
+                it = inflightpackets.emplace(c.packet, 0).first;
+                c.packet->referenceCount++;
+            }
+            it->second++;
+        }
+        // the slot might have been taken over by someone else meanwhile
+        bool samepeer = c.peer && peerconnection(c.peer) == c.connection;
+        switch(c.type)
+        {
+            case netcommand::SEND:
+                if(samepeer) sent = enet_peer_send(c.peer, c.arg, c.packet) >= 0 || sent;
+                break;
+            case netcommand::DISCONNECT:
+                if(samepeer) enet_peer_disconnect(c.peer, c.arg);
+                break;
+            case netcommand::DUPLICATEPEERS:
+                serverhost->duplicatePeers = c.arg;
+                break;
+        }
+        if(c.ownsref) c.packet->referenceCount--;
+    }
+    return sent;
+}
+
+void releasesentpackets()
+{
+    for(auto it = inflightpackets.begin(); it != inflightpackets.end();)
+    {
+        ENetPacket *packet = it->first;
+        if(packet->referenceCount > 1) { ++it; continue; }
+        sentpacket &s = unreportedpackets.add();
+        s.packet = packet;
+        s.commands = it->second;
+        packet->referenceCount = 0;
+        it = inflightpackets.erase(it);
+    }
+    int reported = 0;
+    while(reported < unreportedpackets.length() && sentpackets.push(unreportedpackets[reported])) reported++;
+    unreportedpackets.remove(0, reported);
 }
 
 // broadcast if cn = -1
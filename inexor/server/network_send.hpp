@@ -1,9 +1,36 @@
 #pragma once
 
-#include <enet/enet.h>  // for ENetPacket
+#include <enet/enet.h>                   // for ENetPacket, ENetPeer
+
+#include "inexor/shared/cube_types.hpp"  // for uint
 
 struct stream;
 
+/// Whether the network thread owns the serverhost.
+/// ENet is not threadsafe, so then only the network thread calls into it: the game thread sends packets,
+/// disconnects and releases packets through commands, which sendqueuedpackets() hands over at the end of a tick.
+extern bool queuepackets;
+
+/// Game thread: hand the commands of this tick to the network thread and destroy the packets it is done with.
+/// A packet stays ours until then, so its reference count and callbacks may be changed after sendpacket().
+extern void sendqueuedpackets();
+
+/// Network thread: run the commands of the game thread. Returns whether any packets were sent.
+extern bool runnetcommands();
+
+/// Network thread: report the packets ENet is done with back to the game thread, which destroys them.
+/// Every packet the network thread got holds one reference of it until then, so ENet never frees
+/// a packet (calling back into the game) on the network thread.
+extern void releasesentpackets();
+
+/// Drop a reference the game holds on a packet it may have sent.
+extern void releasepacket(ENetPacket *packet);
+
+/// Disconnect the peer, unless ENet gave its slot to another connection meanwhile.
+extern void disconnectpeer(ENetPeer *peer, uint connection, int reason);
+
+/// Set how many connections the serverhost allows from the same address.
+extern void setduplicatepeers(int duplicatepeers);
 
 extern ENetPacket *sendf(int cn, int chan, const char *format, ...);
 extern void sendpacket(int cn, int chan, ENetPacket *packet, int exclude = -1);
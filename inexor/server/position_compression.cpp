@@ -0,0 +1,113 @@
+#include <stdio.h>                                    // for sscanf
+
+#include "inexor/io/Logging.hpp"                      // for Log, Logger
+#include "inexor/network/legacy/buffer_types.hpp"     // for ucharbuf
+#include "inexor/network/legacy/cube_network.hpp"     // for putint, sendstring
+#include "inexor/network/legacy/game_types.hpp"       // for ::N_POS, demoheader
+#include "inexor/network/legacy/position_codec.hpp"   // for positionstate
+#include "inexor/server/client_management.hpp"        // for clientinfo
+#include "inexor/server/demos.hpp"                    // for demoreader
+#include "inexor/server/network_send.hpp"             // for sendf
+#include "inexor/server/position_compression.hpp"
+#include "inexor/shared/command.hpp"                  // for VAR, ICOMMAND
+#include "inexor/shared/cube_endian.hpp"              // for lilswap
+#include "inexor/shared/cube_formatting.hpp"          // for defformatstring
+#include "inexor/shared/tools.hpp"                    // for max
+
+namespace server {
+
+VAR(poscodec, 0, 1, 1);
+VAR(posdeltakeyframe, 0, 90, 1000);
+
+void offerposcodec(clientinfo *ci)
+{
+    if(!poscodec) return;
+    defformatstring(offer, "poscodec %d", POSCODEC_VERSION);
+    sendf(ci->clientnum, 1, "ris", N_SERVCMD, offer);
+}
+
+bool acceptposcodec(clientinfo *ci, const char *cmd)
+{
+    int version = 0;
+    if(sscanf(cmd, "poscodec %d", &version) != 1) return false;
+    ci->poscodec = poscodec && version == POSCODEC_VERSION;
+    ci->posframe = 0;
+    ci->posacks = positionacks();
+    ci->poshistory.shrink(0);
+    return true;
+}
+
+void ackposframe(clientinfo *ci, int frame)
+{
+    ci->posacks.add(unwrapframe(frame&0xFF, ci->posframe));
+}
+
+bool putcompressedposition(vector<uchar> &buf, clientinfo &receiver, clientinfo &sender)
+{
+    if(buf.empty())
+    {
+        // every packet is a frame of its own, so an acked frame arrived completely
+        receiver.posframe++;
+        putint(buf, N_POSFRAME);
+        putuint(buf, receiver.posframe&0xFF);
+    }
+    while(receiver.poshistory.length() <= sender.clientnum) receiver.poshistory.add();
+    return putpositiondelta(buf, receiver.poshistory[sender.clientnum], sender.posstate, receiver.posframe, receiver.posacks, posdeltakeyframe);
+}
+
+/// Replay the positions of a recorded demo through the codec and report the bytes per tick.
+/// Assumes the single receiving client acknowledges every frame acklag frames later.
+static void posdeltabench(const char *name, int acklag)
+{
+    defformatstring(file, "%s.dmo", name);
+    demoreader f;
+    demoheader hdr;
+    if(!f.open(file, hdr) || hdr.version != DEMO_VERSION || !f.readindex())
+    {
+        Log.std->error("could not read demo \"{}\"", file);
+        return;
+    }
+    vector<positionhistory> history;
+    positionacks acks;
+    vector<uchar> data, out;
+    long long rawbytes = 0, deltabytes = 0;
+    int ticks = 0, keyframes = 0, frame = 0;
+    int millis, stamp[2];
+    while(f.readstamp(millis) && f.read(stamp, sizeof(stamp)))
+    {
+        lilswap(stamp, 2);
+        int chan = stamp[0], len = stamp[1];
+        if(len < 0 || len > MAXTRANS) break;
+        data.setsize(0);
+        if(!f.read(data.reserve(len).buf, len)) break;
+        data.advance(len);
+        if(chan != 0) continue;
+
+        ticks++;
+        frame++;
+        acks.add(frame - max(acklag, 1));
+        out.setsize(0);
+        putint(out, N_POSFRAME);
+        putuint(out, frame&0xFF);
+        ucharbuf p(data.getbuf(), len);
+        while(p.remaining())
+        {
+            int start = p.length();
+            if(getint(p) != N_POS) break;
+            positionstate s;
+            if(!getposition(p, s) || s.cn < 0 || s.cn >= 2*MAXCLIENTS) break; // bots are numbered from MAXCLIENTS on
+            rawbytes += p.length() - start;
+            while(history.length() <= s.cn) history.add();
+            if(putpositiondelta(out, history[s.cn], s, frame, acks, posdeltakeyframe)) keyframes++;
+        }
+        deltabytes += out.length();
+    }
+    f.close();
+    if(!ticks) { Log.std->info("demo \"{}\" contains no positions", file); return; }
+    Log.std->info("posdeltabench \"{}\": {} ticks, {} keyframes", file, ticks, keyframes);
+    Log.std->info("  legacy: {:.1f} bytes/tick, delta: {:.1f} bytes/tick ({:.1f}%)",
+                  rawbytes/double(ticks), deltabytes/double(ticks), rawbytes ? 100.0*deltabytes/rawbytes : 0.0);
+}
+ICOMMAND(posdeltabench, "si", (char *name, int *acklag), posdeltabench(name, *acklag));
+
+} // ns server
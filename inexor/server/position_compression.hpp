@@ -0,0 +1,36 @@
+#pragma once
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+#include "inexor/shared/cube_types.hpp"  // for uchar
+#include "inexor/shared/cube_vector.hpp" // for vector
+
+namespace server {
+struct clientinfo;
+}  // namespace server
+
+namespace server
+{
+
+/// Server side of the delta compressed positions, see network/legacy/position_codec.hpp for the protocol.
+
+/// Whether we offer delta compressed positions to clients.
+extern SharedVar<int> poscodec;
+/// Force a keyframe every this many frames (0 to only send them if there is no acknowledged baseline).
+extern SharedVar<int> posdeltakeyframe;
+
+/// Offer the position codec to a connecting client.
+extern void offerposcodec(clientinfo *ci);
+
+/// Handle a N_SERVCMD of a client, which might be the answer to our offer.
+/// @return whether it was.
+extern bool acceptposcodec(clientinfo *ci, const char *cmd);
+
+/// A client acknowledged to have received this (wrapped) frame number.
+extern void ackposframe(clientinfo *ci, int frame);
+
+/// Append the position of sender to a packet buffer for receiver.
+/// Starts a new frame if the buffer is empty.
+/// @return whether it requires a keyframe.
+extern bool putcompressedposition(vector<uchar> &buf, clientinfo &receiver, clientinfo &sender);
+
+} // ns server
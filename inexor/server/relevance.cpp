@@ -0,0 +1,37 @@
+#include "inexor/gamemode/gamemode.hpp"          // for m_edit, isteam
+#include "inexor/server/client_management.hpp"   // for clientinfo
+#include "inexor/server/relevance.hpp"
+#include "inexor/shared/command.hpp"             // for VAR
+#include "inexor/shared/ents.hpp"                // for ::CS_ALIVE
+#include "inexor/shared/geom.hpp"                // for vec
+
+namespace server {
+
+VAR(relevancerange, 0, 0, 0x10000);
+VAR(relevancerefresh, 33, 250, 2000);
+
+/// Last time (in milliseconds) receiver got senders position, indexed by the senders clientnum.
+static int &lastrelayed(clientinfo &receiver, int sendernum)
+{
+    vector<int> &relayed = receiver.relayedpositions;
+    while(relayed.length() <= sendernum) relayed.add(0);
+    return relayed[sendernum];
+}
+
+static bool isthrottled(clientinfo &receiver, clientinfo &sender)
+{
+    if(!relevancerange || m_edit) return false;
+    if(receiver.state.state != CS_ALIVE || sender.state.state != CS_ALIVE) return false;
+    if(isteam(receiver.team, sender.team)) return false;
+    return receiver.state.o.squaredist(sender.state.o) > float(relevancerange)*float(relevancerange);
+}
+
+bool checkrelevance(clientinfo &receiver, clientinfo &sender, int millis)
+{
+    int &last = lastrelayed(receiver, sender.clientnum);
+    if(isthrottled(receiver, sender) && millis - last < relevancerefresh && millis >= last) return false;
+    last = millis;
+    return true;
+}
+
+} // ns server
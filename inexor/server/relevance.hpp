@@ -0,0 +1,27 @@
+#pragma once
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+
+namespace server {
+struct clientinfo;
+}  // namespace server
+
+namespace server
+{
+
+/// Interest management for relayed positions.
+///
+/// Players further apart than relevancerange only get each others positions every relevancerefresh
+/// milliseconds instead of every worldstate tick. Teammates (radar), spectators and edit mode are never
+/// throttled. The server has no octree loaded, so this is purely distance based.
+
+/// Distance (in cube units) above which position updates get throttled, 0 disables the filter.
+extern SharedVar<int> relevancerange;
+/// Guaranteed minimum refresh interval (in milliseconds) for throttled positions.
+extern SharedVar<int> relevancerefresh;
+
+/// Whether the position of sender should be relayed to receiver this tick.
+/// Records the relay if so, so call this only when you actually send it.
+extern bool checkrelevance(clientinfo &receiver, clientinfo &sender, int millis);
+
+} // ns server
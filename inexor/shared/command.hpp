@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "inexor/network/SharedTree.hpp"
 #include "inexor/shared/cube_vector.hpp"
 #include "inexor/shared/cube_formatting.hpp"
@@ -75,7 +77,8 @@ enum
 	IDF_READONLY = 1<<3,
 	IDF_OVERRIDDEN = 1<<4,
 	IDF_UNKNOWN = 1<<5,
-	IDF_ARG = 1<<6
+	IDF_ARG = 1<<6,
+	IDF_PURE = 1<<7 ///< builtin without side effects, see purecommands in command.cpp
 };
 
 struct ident;
@@ -92,13 +95,19 @@ struct identval
     };
 };
 
+/// Number of strings handed to script values while the script profiler runs, for its allocation counts.
+/// Atomic since values get set off the main thread as well; only the main thread reads it.
+extern std::atomic<uint> scriptallocs;
+/// Whether the script profiler runs (see scriptprofile), a plain flag so setting values stays cheap otherwise.
+extern bool scriptprofiling;
+
 struct tagval : identval
 {
     int type;
 
     void setint(int val) { type = VAL_INT; i = val; }
     void setfloat(float val) { type = VAL_FLOAT; f = val; }
-    void setstr(char *val) { type = VAL_STR; s = val; }
+    void setstr(char *val) { type = VAL_STR; s = val; if(scriptprofiling) scriptallocs.fetch_add(1, std::memory_order_relaxed); }
     void setnull() { type = VAL_NULL; i = 0; }
     void setcode(const uint *val) { type = VAL_CODE; code = val; }
     void setmacro(const uint *val) { type = VAL_MACRO; code = val; }
@@ -0,0 +1,54 @@
+/// @file simd.hpp
+/// Detection of the x86 vector instruction sets, for kernels which pick their implementation at runtime.
+///
+/// Code for an instruction set above the compiler's baseline gets marked with its SIMD_TARGET_ macro
+/// and may only run if cpusimd() reports it.
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define SIMD_X86 1
+  #include <emmintrin.h>                 // for __m128i, _mm_add_epi16
+  #include <immintrin.h>                 // for __m256i, _mm256_add_epi16
+  #ifdef _MSC_VER
+    #include <intrin.h>                  // for __cpuid, _xgetbv
+    #define SIMD_TARGET_AVX2
+  #else
+    #define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+  #endif
+#endif
+
+enum { SIMD_SCALAR = 0, SIMD_SSE2, SIMD_AVX2, NUMSIMDLEVELS };
+
+static inline int detectsimd()
+{
+#ifdef SIMD_X86
+  #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) return SIMD_SSE2;
+    __cpuid(info, 1);
+    bool osavx = (info[2]&(1<<27)) && (info[2]&(1<<28)) && (_xgetbv(0)&6) == 6;
+    __cpuidex(info, 7, 0);
+    return osavx && (info[1]&(1<<5)) ? SIMD_AVX2 : SIMD_SSE2;
+  #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SSE2;
+  #endif
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+/// The highest instruction set the cpu (and the OS) supports.
+inline int cpusimd()
+{
+    static const int level = detectsimd();
+    return level;
+}
+
+inline const char *simdname(int level)
+{
+    static const char * const names[NUMSIMDLEVELS] = { "scalar", "sse2", "avx2" };
+    return level >= 0 && level < NUMSIMDLEVELS ? names[level] : "";
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest-message.h"              // for Message
+#include "gtest/gtest-test-part.h"            // for TestPartResult
+#include "gtest/gtest.h"                      // for Test, TestInfo (ptr only)
+#include "inexor/server/gameevents.hpp"       // for gameeventqueue, gameevent
+#include "inexor/shared/cube_loops.hpp"       // for loopi, loopk
+#include "inexor/test/helpers.hpp"            // for expectEq, test
+
+using namespace server;
+
+namespace {
+
+  gameevent *addshot(gameeventqueue &q, int millis, int numhits) {
+    gameevent *e = q.add(EV_SHOT);
+    if(!e) return nullptr;
+    e->millis = millis;
+    loopi(numhits) q.addhit(*e)->target = millis*100 + i;
+    return e;
+  }
+
+  test(gameeventqueue, Wraps) {
+    gameeventqueue q;
+    loopi(1000) {
+      addshot(q, i, 3);
+      if(q.length() > 10) {
+        gameevent &e = q.first();
+        expectEq(e.numhits, 3);
+        loopk(3) expectEq(q.hit(e, k).target, e.millis*100 + k);
+        q.removefirst();
+      }
+    }
+    expectEq(q.length(), 10);
+  }
+
+  test(gameeventqueue, Full) {
+    gameeventqueue q;
+    loopi(gameeventqueue::MAXEVENTS) assert(q.add(EV_SUICIDE));
+    assertEq(q.add(EV_SUICIDE), nullptr);
+    q.removefirst();
+    expect(q.add(EV_SUICIDE));
+
+    gameeventqueue h;
+    gameevent *e = h.add(EV_SHOT);
+    loopi(gameeventqueue::MAXHITS) assert(h.addhit(*e));
+    assertEq(h.addhit(*e), nullptr);
+  }
+
+  test(gameeventqueue, ClearUnkept) {
+    gameeventqueue q;
+    addshot(q, 1, 2);
+    gameevent *e = q.add(EV_EXPLODE);
+    e->millis = 2;
+    loopi(4) q.addhit(*e)->target = 200 + i;
+    q.add(EV_PICKUP);
+    addshot(q, 3, 1);
+    q.clearunkept();
+    assertEq(q.length(), 1);
+    gameevent &kept = q.first();
+    expectEq(kept.type, EV_EXPLODE);
+    loopi(4) expectEq(q.hit(kept, i).target, 200 + i);
+    addshot(q, 4, 2);
+    expectEq(q.hit(q[1], 1).target, 401);
+  }
+
+  test(gameeventqueue, CountsDrops) {
+    gameeventqueue q;
+    loopi(gameeventqueue::MAXEVENTS + 5) q.add(EV_SUICIDE);
+    expectEq(q.length(), int(gameeventqueue::MAXEVENTS));
+    expectEq(q.droppedevents, 5) << "events beyond the capacity should be counted";
+
+    gameeventqueue h;
+    gameevent *e = h.add(EV_SHOT);
+    loopi(gameeventqueue::MAXHITS + 3) h.addhit(*e);
+    expectEq(e->numhits, int(gameeventqueue::MAXHITS));
+    expectEq(h.droppedhits, 3) << "hits beyond the capacity should be counted";
+    expectEq(h.droppedevents, 0);
+  }
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest-message.h"            // for Message
+#include "gtest/gtest-test-part.h"          // for TestPartResult
+#include "gtest/gtest.h"                    // for Test, TestInfo (ptr only)
+#include "inexor/server/hitverify.hpp"      // for hitbatch, hitboxhistory, hitrewindtime
+#include "inexor/shared/geom.hpp"           // for vec
+#include "inexor/test/helpers.hpp"          // for expect, expectEq, expectNot
+
+using namespace server;
+
+namespace {
+
+  // Whether the segment from -> from+ray passes the hitbox of a player standing at feet, grown by margin.
+  bool passes(const vec &from, const vec &ray, const vec &feet, float margin = 0) {
+    hitbatch batch;
+    batch.add(0, feet, margin);
+    batch.trace(from, ray);
+    return !batch.missed[0];
+  }
+
+  test(hitverify, HeadHeight) {
+    vec feet(512, 512, 256), ray(200, 0, 0);
+    float head = feet.z + HITBOX_EYEHEIGHT - 0.5f;
+    expect(passes(vec(400, 512, head), ray, feet));
+    expect(passes(vec(400, 512, feet.z + 7), ray, feet));
+    expectNot(passes(vec(400, 512, feet.z - 4), ray, feet)) << "shots below the feet should miss";
+    expectNot(passes(vec(400, 512, head + 4), ray, feet)) << "shots above the head should miss";
+  }
+
+  test(hitverify, RejectsOutOfBox) {
+    vec feet(512, 512, 256);
+    vec from(400, 512 + HITBOX_RADIUS + 8, feet.z + 7), ray(200, 0, 0);
+    expectNot(passes(from, ray, feet)) << "a ray passing besides the box should miss";
+    expect(passes(from, ray, feet, 10)) << "the tolerance should let it pass";
+    expectNot(passes(vec(400, 512, feet.z + 7), vec(50, 0, 0), feet)) << "a ray ending before the box should miss";
+  }
+
+  test(hitverify, BatchKeepsHits) {
+    hitbatch batch;
+    vec from(0, 0, 0), ray(1000, 0, 0);
+    for(int i = 0; i < hitbatch::SIZE; i++) batch.add(100 + i, vec(10 + i * 10, i % 2 ? 50 : 0, -7), 0);
+    expect(batch.full());
+    batch.trace(from, ray);
+    for(int j = 0; j < batch.num; j++) {
+      expectEq(batch.hits[j], 100 + j);
+      expectEq(batch.missed[j], j % 2 == 1);
+    }
+  }
+
+  test(hitverify, Rewind) {
+    hitboxhistory h;
+    vec o;
+    expectNot(h.rewind(100, o)) << "nothing to rewind to yet";
+    h.add(100, vec(0, 0, 0));
+    h.add(200, vec(100, 0, 0));
+    expect(h.rewind(150, o));
+    expectEq(o.x, 50);
+    expect(h.rewind(50, o));
+    expectEq(o.x, 0) << "times before the history should clamp to the oldest position";
+    expect(h.rewind(300, o));
+    expectEq(o.x, 100) << "times after the history should clamp to the newest position";
+    for(int i = 0; i < hitboxhistory::SIZE; i++) h.add(300 + i * 10, vec(i, 0, 0));
+    expect(h.rewind(0, o));
+    expectEq(o.x, 0) << "the ring should only remember the last positions";
+  }
+
+  test(hitverify, LatencyRewind) {
+    // the target ran along y, the shooter saw it 100ms late
+    hitboxhistory h;
+    for(int t = 0; t <= 1000; t += 33) h.add(t, vec(512, t / 2.0f, 256));
+    int time = hitrewindtime(1000, 100, 300);
+    expectEq(time, 900);
+    vec then, now;
+    expect(h.rewind(time, then));
+    expect(h.rewind(1000, now));
+    vec from(300, then.y, 263), ray(400, 0, 0);
+    expect(passes(from, ray, then)) << "the shot should hit where the shooter saw the target";
+    expectNot(passes(from, ray, now)) << "the target moved out of the shot since";
+    expectEq(hitrewindtime(1000, 900, 300), 700) << "high pings should rewind at most hitverifyrewind";
+    expectEq(hitrewindtime(1000, -5, 300), 1000);
+  }
+
+  test(hitverify, RocketReach) {
+    vec from(0, 0, 0), to(1000, 0, 0), feet(300, 0, -7);
+    // 100 units per second, 1 second of flight: the rocket got no further than 100 + slack
+    vec path = rocketpath(from, to, 100, 1000, 4);
+    expectEq(path.x, 104);
+    expectNot(passes(from, path, feet, 30)) << "the rocket can not have exploded near the target yet";
+    expect(passes(from, rocketpath(from, to, 100, 2800, 4), feet, 30));
+    expectEq(rocketpath(from, to, 100, 60000, 4).x, 1000) << "rockets explode at their target at the latest";
+    expectEq(rocketpath(from, to, 100, -50, 4).x, 4);
+  }
+}
@@ -0,0 +1,45 @@
+#include <thread>                             // for thread
+
+#include "gtest/gtest-message.h"              // for Message
+#include "gtest/gtest-test-part.h"            // for TestPartResult
+#include "gtest/gtest.h"                      // for Test, TestInfo (ptr only)
+#include "inexor/test/helpers.hpp"            // for expect, expectEq, expectNot
+#include "inexor/util/SpscQueue.hpp"          // for SpscQueue
+
+using namespace inexor::util;
+
+namespace {
+
+  test(SpscQueue, FullAndEmpty) {
+    SpscQueue<int, 4> q;
+    int v = -1;
+    expect(q.empty());
+    expectNot(q.pop(v));
+    for(int i = 0; i < 4; i++) expect(q.push(i));
+    expectNot(q.push(4)) << "a full queue should refuse more items";
+    for(int i = 0; i < 4; i++) {
+      expect(q.pop(v));
+      expectEq(v, i);
+    }
+    expectNot(q.pop(v));
+    expect(q.empty());
+  }
+
+  test(SpscQueue, KeepsOrderAcrossThreads) {
+    static SpscQueue<int, 64> q;
+    const int num = 200000;
+    std::thread producer([&] {
+      for(int i = 0; i < num; i++) while(!q.push(i)) std::this_thread::yield();
+    });
+    int expected = 0, v;
+    bool inorder = true;
+    while(expected < num) {
+      if(!q.pop(v)) { std::this_thread::yield(); continue; }
+      if(v != expected) inorder = false;
+      expected++;
+    }
+    producer.join();
+    expect(inorder) << "items should arrive in the order they were pushed";
+    expect(q.empty());
+  }
+}
@@ -1,6 +1,8 @@
 /// @file SDL_loading.cpp
 /// Wrapper for the SDL API calls used to load textures.
 
+#include <stdlib.h>                      // for abs
+#include <string.h>                      // for memcmp, strlen, strcasecmp
 #include <algorithm>                     // for min
 
 #include "SDL_blendmode.h"               // for ::SDL_BLENDMODE_NONE
@@ -9,6 +11,7 @@
 #include "SDL_pixels.h"                  // for SDL_PixelFormat, SDL_Color
 #include "inexor/io/legacy/stream.hpp"   // for findfile, openfile, stream
 #include "inexor/shared/cube_loops.hpp"  // for i, loopi
+#include "inexor/shared/cube_tools.hpp"  // for strcasecmp
 #include "inexor/shared/cube_types.hpp"  // for uint
 #include "inexor/shared/tools.hpp"       // for min
 #include "inexor/texture/SDL_loading.hpp"
@@ -102,3 +105,63 @@ SDL_Surface *loadsurface(const char *name)
     SDL_Surface *s = IMG_Load(findfile(name, "rb"));
     return fixsurfaceformat(s);
 }
+
+static inline int readbig16(const uchar *p) { return (p[0]<<8) | p[1]; }
+static inline int readbig32(const uchar *p) { return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3]; }
+static inline int readlil16(const uchar *p) { return p[0] | (p[1]<<8); }
+static inline int readlil32(const uchar *p) { return p[0] | (p[1]<<8) | (p[2]<<16) | (p[3]<<24); }
+
+/// Walk the markers of a jpeg file up to the first start of frame.
+static bool jpegsize(stream *f, int &w, int &h)
+{
+    uchar marker[4];
+    while(f->read(marker, 4) == 4 && marker[0] == 0xFF)
+    {
+        int type = marker[1], len = readbig16(&marker[2]);
+        // SOF0..SOF15, without DHT (C4), JPG (C8) and DAC (CC)
+        if(type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC)
+        {
+            uchar frame[5];
+            if(f->read(frame, 5) != 5) return false;
+            h = readbig16(&frame[1]);
+            w = readbig16(&frame[3]);
+            return true;
+        }
+        if(len < 2 || !f->seek(len - 2, SEEK_CUR)) return false;
+    }
+    return false;
+}
+
+bool loadsurfacesize(const char *name, int &w, int &h)
+{
+    stream *f = openfile(name, "rb");
+    if(!f) return false;
+    uchar header[26];
+    bool found = false;
+    size_t len = f->read(header, sizeof(header)), namelen = strlen(name);
+    static const uchar pngsig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if(len >= 24 && !memcmp(header, pngsig, 8) && !memcmp(&header[12], "IHDR", 4))
+    {
+        w = readbig32(&header[16]);
+        h = readbig32(&header[20]);
+        found = true;
+    }
+    else if(len >= 2 && header[0] == 0xFF && header[1] == 0xD8)
+    {
+        found = f->seek(2, SEEK_SET) && jpegsize(f, w, h);
+    }
+    else if(len >= 26 && header[0] == 'B' && header[1] == 'M')
+    {
+        w = readlil32(&header[18]);
+        h = abs(readlil32(&header[22]));
+        found = true;
+    }
+    else if(len >= 18 && namelen >= 4 && !strcasecmp(name + namelen - 4, ".tga"))
+    {
+        w = readlil16(&header[12]);
+        h = readlil16(&header[14]);
+        found = true;
+    }
+    delete f;
+    return found && w > 0 && h > 0;
+}
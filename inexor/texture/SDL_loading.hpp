@@ -10,4 +10,8 @@ extern SDL_Surface *wrapsurface(void *data, int width, int height, int bpp);
 extern bool canloadsurface(const char *name);
 extern SDL_Surface *loadsurface(const char *name);
 
+/// Read the size of the image name from its header, without decoding it.
+/// Knows png, jpg, tga and bmp files.
+extern bool loadsurfacesize(const char *name, int &w, int &h);
+
 
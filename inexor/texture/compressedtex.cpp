@@ -18,37 +18,43 @@
 #include "inexor/shared/tools.hpp"                    // for min
 #include "inexor/texture/compressedtex.hpp"
 #include "inexor/texture/image.hpp"                   // for ImageData
+#include "inexor/texture/imagekernels.hpp"            // for splitrows
 
 VAR(dbgdds, 0, 0, 1);
 
+/// Rows of blocks get decoded in parallel for large images.
 #define DECODEDDS(name, dbpp, initblock, writeval, nextval) \
 static void name(ImageData &s) \
 { \
     ImageData d(s.w, s.h, dbpp); \
-    uchar *dst = d.data; \
-    const uchar *src = s.data; \
-    for(int by = 0; by < s.h; by += s.align) \
+    int blockrows = (s.h + s.align-1)/s.align, blockcols = (s.w + s.align-1)/s.align; \
+    splitrows(blockrows, s.align*d.pitch, [&](int row0, int row1) \
+    { \
+        uchar *dst = &d.data[row0*s.align*d.pitch]; \
+        const uchar *src = &s.data[row0*blockcols*s.bpp]; \
+        for(int by = row0*s.align; by < min(row1*s.align, s.h); by += s.align) \
         { \
-        for(int bx = 0; bx < s.w; bx += s.align, src += s.bpp) \
-                { \
-            int maxy = min(d.h - by, s.align), maxx = min(d.w - bx, s.align); \
-            initblock; \
-            loop(y, maxy) \
+            for(int bx = 0; bx < s.w; bx += s.align, src += s.bpp) \
             { \
-                int x; \
-                for(x = 0; x < maxx; ++x) \
-                                { \
-                    writeval; \
-                    nextval; \
-                    dst += d.bpp; \
-                                }  \
-                for(; x < s.align; ++x) { nextval; } \
-                dst += d.pitch - maxx*d.bpp; \
-            } \
-            dst += maxx*d.bpp - maxy*d.pitch; \
+                int maxy = min(d.h - by, s.align), maxx = min(d.w - bx, s.align); \
+                initblock; \
+                loop(y, maxy) \
+                { \
+                    int x; \
+                    for(x = 0; x < maxx; ++x) \
+                    { \
+                        writeval; \
+                        nextval; \
+                        dst += d.bpp; \
+                    }  \
+                    for(; x < s.align; ++x) { nextval; } \
+                    dst += d.pitch - maxx*d.bpp; \
                 } \
-        dst += (s.align-1)*d.pitch; \
+                dst += maxx*d.bpp - maxy*d.pitch; \
+            } \
+            dst += (s.align-1)*d.pitch; \
         } \
+    }); \
     s.replace(d); \
 }
 
@@ -11,6 +11,7 @@
 #include "inexor/shared/cube_endian.hpp"   // for lilswap
 #include "inexor/shared/geom.hpp"          // for vec, vec::(anonymous union...
 #include "inexor/texture/image.hpp"
+#include "inexor/texture/imagekernels.hpp"  // for splitrows, imagepath
 #include "inexor/texture/macros.hpp"       // for dst, src, readwritetex
 #include "inexor/texture/texsettings.hpp"  // for texreduce, maxtexsize, hwc...
 
@@ -55,7 +56,8 @@ template<int BPP> static void shifttexture(uchar *src, uint sw, uint sh, uint st
     }
 }
 
-template<int BPP> static void scaletexture(uchar *src, uint sw, uint sh, uint stride, uchar *dst, uint dw, uint dh)
+/// Scale the rows [y0, y1) of dst.
+template<int BPP> static void scaletexture(uchar *src, uint sw, uint sh, uint stride, uchar *dst, uint dw, uint dh, uint y0, uint y1)
 {
     uint wfrac = (sw<<12)/dw, hfrac = (sh<<12)/dh, darea = dw*dh, sarea = sw*sh;
     int over, under;
@@ -65,9 +67,9 @@ template<int BPP> static void scaletexture(uchar *src, uint sw, uint sh, uint st
             ascale = clamp(12 + under - over, 0, 24),
             dscale = ascale + 12 - cscale,
             area = ((ullong)darea<<ascale)/sarea;
+    dst += y0*dw*BPP;
     dw *= wfrac;
-    dh *= hfrac;
-    for(uint y = 0; y < dh; y += hfrac)
+    for(uint y = y0*hfrac; y < y1*hfrac; y += hfrac)
     {
         const uint yn = y + hfrac - 1, yi = y>>12, h = (yn>>12) - yi, ylow = ((yn|(-int(h)>>24))&0xFFFU) + 1 - (y&0xFFFU), yhigh = (yn&0xFFFU) + 1;
         const uchar *ysrc = &src[yi*stride];
@@ -104,33 +106,47 @@ void scaletexture(uchar *src, uint sw, uint sh, uint bpp, uint pitch, uchar *dst
 {
     if(sw == dw*2 && sh == dh*2)
     {
-        switch(bpp)
+        int path = imagepath();
+        splitrows(dh, 2*sw*bpp, [&](int y0, int y1)
         {
-            case 1: return halvetexture<1>(src, sw, sh, pitch, dst);
-            case 2: return halvetexture<2>(src, sw, sh, pitch, dst);
-            case 3: return halvetexture<3>(src, sw, sh, pitch, dst);
-            case 4: return halvetexture<4>(src, sw, sh, pitch, dst);
-        }
+            uchar *ysrc = &src[2*y0*pitch], *ydst = &dst[y0*dw*bpp];
+            if(halverows(path, ysrc, sw, y1 - y0, bpp, pitch, ydst)) return;
+            switch(bpp)
+            {
+                case 1: return halvetexture<1>(ysrc, sw, 2*(y1 - y0), pitch, ydst);
+                case 2: return halvetexture<2>(ysrc, sw, 2*(y1 - y0), pitch, ydst);
+                case 3: return halvetexture<3>(ysrc, sw, 2*(y1 - y0), pitch, ydst);
+                case 4: return halvetexture<4>(ysrc, sw, 2*(y1 - y0), pitch, ydst);
+            }
+        });
     }
     else if(sw < dw || sh < dh || sw&(sw-1) || sh&(sh-1) || dw&(dw-1) || dh&(dh-1))
     {
-        switch(bpp)
+        splitrows(dh, sw*bpp*max(sh/dh, 1U), [&](int y0, int y1)
         {
-            case 1: return scaletexture<1>(src, sw, sh, pitch, dst, dw, dh);
-            case 2: return scaletexture<2>(src, sw, sh, pitch, dst, dw, dh);
-            case 3: return scaletexture<3>(src, sw, sh, pitch, dst, dw, dh);
-            case 4: return scaletexture<4>(src, sw, sh, pitch, dst, dw, dh);
-        }
+            switch(bpp)
+            {
+                case 1: return scaletexture<1>(src, sw, sh, pitch, dst, dw, dh, y0, y1);
+                case 2: return scaletexture<2>(src, sw, sh, pitch, dst, dw, dh, y0, y1);
+                case 3: return scaletexture<3>(src, sw, sh, pitch, dst, dw, dh, y0, y1);
+                case 4: return scaletexture<4>(src, sw, sh, pitch, dst, dw, dh, y0, y1);
+            }
+        });
     }
     else
     {
-        switch(bpp)
+        uint hfrac = sh/dh;
+        splitrows(dh, sw*bpp*hfrac, [&](int y0, int y1)
         {
-            case 1: return shifttexture<1>(src, sw, sh, pitch, dst, dw, dh);
-            case 2: return shifttexture<2>(src, sw, sh, pitch, dst, dw, dh);
-            case 3: return shifttexture<3>(src, sw, sh, pitch, dst, dw, dh);
-            case 4: return shifttexture<4>(src, sw, sh, pitch, dst, dw, dh);
-        }
+            uchar *ysrc = &src[y0*hfrac*pitch], *ydst = &dst[y0*dw*bpp];
+            switch(bpp)
+            {
+                case 1: return shifttexture<1>(ysrc, sw, (y1 - y0)*hfrac, pitch, ydst, dw, y1 - y0);
+                case 2: return shifttexture<2>(ysrc, sw, (y1 - y0)*hfrac, pitch, ydst, dw, y1 - y0);
+                case 3: return shifttexture<3>(ysrc, sw, (y1 - y0)*hfrac, pitch, ydst, dw, y1 - y0);
+                case 4: return shifttexture<4>(ysrc, sw, (y1 - y0)*hfrac, pitch, ydst, dw, y1 - y0);
+            }
+        });
     }
 }
 
@@ -334,9 +350,18 @@ void texoffset(ImageData &s, int xoffset, int yoffset)
 void texmad(ImageData &s, const vec &mul, const vec &add)
 {
     int maxk = min(int(s.bpp), 3);
-    writetex(s,
-        loopk(maxk) dst[k] = uchar(clamp(dst[k] * mul[k] + 255 * add[k], 0.0f, 255.0f));
-    );
+    float muls[12], adds[12];
+    loopi(12)
+    {
+        int k = i%s.bpp;
+        muls[i] = k < maxk ? mul[k] : 1.0f;
+        adds[i] = k < maxk ? 255 * add[k] : 0.0f;
+    }
+    int path = imagepath();
+    splitrows(s.h, s.w*s.bpp, [&](int y0, int y1)
+    {
+        for(int y = y0; y < y1; y++) madrow(path, &s.data[y*s.pitch], s.w*s.bpp, muls, adds);
+    });
 }
 
 void texcolorify(ImageData &s, const vec &color, vec weights)
@@ -412,14 +437,15 @@ void texpremul(ImageData &s)
         );
         break;
     case 4:
-        writetex(s,
-            uint alpha = dst[3];
-        dst[0] = uchar((uint(dst[0])*alpha) / 255);
-        dst[1] = uchar((uint(dst[1])*alpha) / 255);
-        dst[2] = uchar((uint(dst[2])*alpha) / 255);
-        );
+    {
+        int path = imagepath();
+        splitrows(s.h, s.w*s.bpp, [&](int y0, int y1)
+        {
+            for(int y = y0; y < y1; y++) premulrow(path, &s.data[y*s.pitch], s.w);
+        });
         break;
     }
+    }
 }
 
 void texagrad(ImageData &s, float x2, float y2, float x1, float y1)
@@ -467,27 +493,39 @@ void texflip(ImageData &s)
     s.replace(d);
 }
 
+/// Read the first channel of row y (wrapping around) with the wrapped neighbours as padding, see normalrow().
+static void loadheights(const ImageData &s, int y, float *heights)
+{
+    const uchar *src = &s.data[((y + s.h) % s.h)*s.pitch];
+    heights[0] = src[(s.w - 1)*s.bpp];
+    loop(x, s.w) heights[x + 1] = src[x*s.bpp];
+    heights[s.w + 1] = src[0];
+}
+
 void texnormal(ImageData &s, int emphasis)
 {
     ImageData d(s.w, s.h, 3);
-    uchar *src = s.data, *dst = d.data;
-    loop(y, s.h) loop(x, s.w)
-    {
-        vec normal(0.0f, 0.0f, 255.0f / emphasis);
-        normal.x += src[y*s.pitch + ((x + s.w - 1) % s.w)*s.bpp];
-        normal.x -= src[y*s.pitch + ((x + 1) % s.w)*s.bpp];
-        normal.y += src[((y + s.h - 1) % s.h)*s.pitch + x*s.bpp];
-        normal.y -= src[((y + 1) % s.h)*s.pitch + x*s.bpp];
-        normal.normalize();
-        *dst++ = uchar(127.5f + normal.x*127.5f);
-        *dst++ = uchar(127.5f + normal.y*127.5f);
-        *dst++ = uchar(127.5f + normal.z*127.5f);
-    }
+    float z = 255.0f / emphasis;
+    int path = imagepath();
+    splitrows(s.h, s.w*3, [&](int y0, int y1)
+    {
+        float *heights = new float[3*(s.w + 2)], *prev = heights, *cur = &heights[s.w + 2], *next = &heights[2*(s.w + 2)];
+        loadheights(s, y0 - 1, prev);
+        loadheights(s, y0, cur);
+        for(int y = y0; y < y1; y++)
+        {
+            loadheights(s, y + 1, next);
+            normalrow(path, prev, cur, next, s.w, z, &d.data[y*d.pitch]);
+            swap(prev, cur);
+            swap(cur, next);
+        }
+        delete[] heights;
+    });
     s.replace(d);
 }
 
 template<int n, int bpp, bool normals>
-static void blurtexture(int w, int h, uchar *dst, const uchar *src, int margin)
+static void blurtexture(int w, int h, uchar *dst, const uchar *src, int margin, int y0, int y1)
 {
     static const int weights3x3[9] =
     {
@@ -510,8 +548,9 @@ static void blurtexture(int w, int h, uchar *dst, const uchar *src, int margin)
         startoffset = n*bpp,
         nextoffset1 = stride + mstride*bpp,
         nextoffset2 = stride - mstride*bpp;
-    src += margin*(stride + bpp);
-    for(int y = margin; y < h - margin; y++)
+    src += margin*(stride + bpp) + (y0 - margin)*stride;
+    dst += (y0 - margin)*(w - 2*margin)*bpp;
+    for(int y = y0; y < y1; y++)
     {
         for(int x = margin; x < w - margin; x++)
         {
@@ -564,22 +603,32 @@ static void blurtexture(int w, int h, uchar *dst, const uchar *src, int margin)
 
 void blurtexture(int n, int bpp, int w, int h, uchar *dst, const uchar *src, int margin)
 {
-    switch((clamp(n, 1, 2) << 4) | bpp)
+    splitrows(h - 2*margin, w*bpp*(2*n + 1), [&](int y0, int y1)
     {
-    case 0x13: blurtexture<1, 3, false>(w, h, dst, src, margin); break;
-    case 0x23: blurtexture<2, 3, false>(w, h, dst, src, margin); break;
-    case 0x14: blurtexture<1, 4, false>(w, h, dst, src, margin); break;
-    case 0x24: blurtexture<2, 4, false>(w, h, dst, src, margin); break;
-    }
+        y0 += margin;
+        y1 += margin;
+        switch((clamp(n, 1, 2) << 4) | bpp)
+        {
+        case 0x13: blurtexture<1, 3, false>(w, h, dst, src, margin, y0, y1); break;
+        case 0x23: blurtexture<2, 3, false>(w, h, dst, src, margin, y0, y1); break;
+        case 0x14: blurtexture<1, 4, false>(w, h, dst, src, margin, y0, y1); break;
+        case 0x24: blurtexture<2, 4, false>(w, h, dst, src, margin, y0, y1); break;
+        }
+    });
 }
 
 void blurnormals(int n, int w, int h, bvec *dst, const bvec *src, int margin)
 {
-    switch(clamp(n, 1, 2))
+    splitrows(h - 2*margin, w*3*(2*n + 1), [&](int y0, int y1)
     {
-    case 1: blurtexture<1, 3, true>(w, h, dst->v, src->v, margin); break;
-    case 2: blurtexture<2, 3, true>(w, h, dst->v, src->v, margin); break;
-    }
+        y0 += margin;
+        y1 += margin;
+        switch(clamp(n, 1, 2))
+        {
+        case 1: blurtexture<1, 3, true>(w, h, dst->v, src->v, margin, y0, y1); break;
+        case 2: blurtexture<2, 3, true>(w, h, dst->v, src->v, margin, y0, y1); break;
+        }
+    });
 }
 
 void texblur(ImageData &s, int n, int r)
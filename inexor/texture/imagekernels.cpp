@@ -0,0 +1,334 @@
+/// @file imagekernels.cpp
+/// SIMD versions of the per pixel loops of image.cpp, and splitting of large images into rows for the job system.
+
+#include <boost/algorithm/clamp.hpp>                  // for clamp
+#include <algorithm>                                  // for min, max
+#include <chrono>                                     // for duration, steady_...
+
+#include "inexor/io/Logging.hpp"                      // for Log, Logger
+#include "inexor/network/SharedVar.hpp"               // for SharedVar
+#include "inexor/shared/command.hpp"                  // for VARP, COMMAND
+#include "inexor/shared/cube_loops.hpp"               // for loopi, loopj
+#include "inexor/shared/geom.hpp"                     // for vec
+#include "inexor/shared/simd.hpp"                     // for cpusimd, SIMD_X86
+#include "inexor/texture/image.hpp"                   // for ImageData, scal...
+#include "inexor/texture/imagekernels.hpp"
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem
+
+using boost::algorithm::clamp;
+using std::min;
+using std::max;
+using inexor::util::JobSystem;
+
+/// Highest instruction set used by the image kernels: 0 scalar, 1 SSE2, 2 AVX2.
+VARP(imagesimd, 0, 2, 2);
+
+/// Process large images in rows on the job system.
+VARP(imagejobs, 0, 1, 1);
+
+int imagepath()
+{
+    return min(int(imagesimd), cpusimd());
+}
+
+void splitrows(int h, int rowbytes, const std::function<void(int, int)> &fn)
+{
+    JobSystem *jobs = imagejobs ? JobSystem::running() : nullptr;
+    int rows = max((1<<16) / max(rowbytes, 1), 1), chunks = (h + rows - 1) / rows; // 64 KB per job
+    if(!jobs || chunks < 2) { fn(0, h); return; }
+    jobs->parallel_for(chunks, [&](int i) { fn(i*rows, min((i+1)*rows, h)); });
+}
+
+template<int BPP> static inline void halvepixels(const uchar *row0, const uchar *row1, uint x, uint end, uchar *dst)
+{
+    for(; x < end; x += 2*BPP, dst += BPP)
+        loopi(BPP) dst[i] = (uint(row0[x+i]) + uint(row0[x+i+BPP]) + uint(row1[x+i]) + uint(row1[x+i+BPP]))>>2;
+}
+
+static inline void normalpixel(float nx, float ny, float z, uchar *dst)
+{
+    vec normal(nx, ny, z);
+    normal.normalize();
+    dst[0] = uchar(127.5f + normal.x*127.5f);
+    dst[1] = uchar(127.5f + normal.y*127.5f);
+    dst[2] = uchar(127.5f + normal.z*127.5f);
+}
+
+static inline void premulpixel(uchar *dst)
+{
+    uint alpha = dst[3];
+    dst[0] = uchar((uint(dst[0])*alpha) / 255);
+    dst[1] = uchar((uint(dst[1])*alpha) / 255);
+    dst[2] = uchar((uint(dst[2])*alpha) / 255);
+}
+
+#ifdef SIMD_X86
+
+/// Sums of the 2x2 blocks in the bytes a and b of two rows, in 16 bit lanes.
+/// P is the intrinsic prefix, the shuffles stay within 128 bits so it works for both widths.
+#define HALVESUM(P, BPP, a, b, zero, sum) \
+    { \
+        auto lo = P##_add_epi16(P##_unpacklo_epi8(a, zero), P##_unpacklo_epi8(b, zero)), \
+             hi = P##_add_epi16(P##_unpackhi_epi8(a, zero), P##_unpackhi_epi8(b, zero)); \
+        if(BPP == 1) sum = P##_packs_epi32(P##_madd_epi16(lo, P##_set1_epi16(1)), P##_madd_epi16(hi, P##_set1_epi16(1))); \
+        else \
+        { \
+            if(BPP == 2) \
+            { \
+                lo = P##_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)); \
+                hi = P##_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)); \
+            } \
+            sum = P##_add_epi16(P##_unpacklo_epi64(lo, hi), P##_unpackhi_epi64(lo, hi)); \
+        } \
+    }
+
+template<int BPP> static void halvesse2(const uchar *src, uint sw, uint dh, uint stride, uchar *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint rowlen = sw*BPP, veclen = rowlen&~15U;
+    for(uint y = 0; y < dh; y++, src += 2*stride)
+    {
+        const uchar *row0 = src, *row1 = src + stride;
+        for(uint x = 0; x < veclen; x += 16, dst += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)&row0[x]), b = _mm_loadu_si128((const __m128i *)&row1[x]), sum;
+            HALVESUM(_mm, BPP, a, b, zero, sum);
+            _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(_mm_srli_epi16(sum, 2), zero));
+        }
+        halvepixels<BPP>(row0, row1, veclen, rowlen, dst);
+        dst += (rowlen - veclen)/2;
+    }
+}
+
+/// Three bytes a pixel don't line up with the vectors, so only the vertical sums are done in them.
+static void halvergbsse2(const uchar *src, uint sw, uint dh, uint stride, uchar *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint rowlen = sw*3, veclen = rowlen - rowlen%48;
+    ushort sums[48];
+    for(uint y = 0; y < dh; y++, src += 2*stride)
+    {
+        const uchar *row0 = src, *row1 = src + stride;
+        for(uint x = 0; x < veclen; x += 48, dst += 24)
+        {
+            loopk(3)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)&row0[x + 16*k]), b = _mm_loadu_si128((const __m128i *)&row1[x + 16*k]);
+                _mm_storeu_si128((__m128i *)&sums[16*k], _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+                _mm_storeu_si128((__m128i *)&sums[16*k + 8], _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+            }
+            loopk(8) loopi(3) dst[3*k + i] = (uint(sums[6*k + i]) + uint(sums[6*k + 3 + i]))>>2;
+        }
+        halvepixels<3>(row0, row1, veclen, rowlen, dst);
+        dst += (rowlen - veclen)/2;
+    }
+}
+
+template<int BPP> SIMD_TARGET_AVX2 static void halveavx2(const uchar *src, uint sw, uint dh, uint stride, uchar *dst)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint rowlen = sw*BPP, veclen = rowlen&~31U;
+    for(uint y = 0; y < dh; y++, src += 2*stride)
+    {
+        const uchar *row0 = src, *row1 = src + stride;
+        for(uint x = 0; x < veclen; x += 32, dst += 16)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)&row0[x]), b = _mm256_loadu_si256((const __m256i *)&row1[x]), sum;
+            HALVESUM(_mm256, BPP, a, b, zero, sum);
+            // every 128 bit lane packed its 8 pixels into its low half
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(sum, 2), zero), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(packed));
+        }
+        halvepixels<BPP>(row0, row1, veclen, rowlen, dst);
+        dst += (rowlen - veclen)/2;
+    }
+}
+
+/// Write the x, y and z components of n normals, each scaled to 0..255, as rgb.
+static inline void storenormals(const int *nx, const int *ny, const int *nz, int n, uchar *dst)
+{
+    loopi(n)
+    {
+        dst[3*i] = nx[i];
+        dst[3*i + 1] = ny[i];
+        dst[3*i + 2] = nz[i];
+    }
+}
+
+static void normalrowsse2(const float *prev, const float *cur, const float *next, int w, float z, uchar *dst)
+{
+    const __m128 vz = _mm_set1_ps(z), half = _mm_set1_ps(127.5f);
+    int x = 0;
+    for(; x + 4 <= w; x += 4, dst += 12)
+    {
+        __m128 nx = _mm_sub_ps(_mm_loadu_ps(&cur[x]), _mm_loadu_ps(&cur[x + 2])),
+               ny = _mm_sub_ps(_mm_loadu_ps(&prev[x + 1]), _mm_loadu_ps(&next[x + 1])),
+               mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(vz, vz)));
+        alignas(16) int ox[4], oy[4], oz[4];
+        _mm_store_si128((__m128i *)ox, _mm_cvttps_epi32(_mm_add_ps(half, _mm_mul_ps(_mm_div_ps(nx, mag), half))));
+        _mm_store_si128((__m128i *)oy, _mm_cvttps_epi32(_mm_add_ps(half, _mm_mul_ps(_mm_div_ps(ny, mag), half))));
+        _mm_store_si128((__m128i *)oz, _mm_cvttps_epi32(_mm_add_ps(half, _mm_mul_ps(_mm_div_ps(vz, mag), half))));
+        storenormals(ox, oy, oz, 4, dst);
+    }
+    for(; x < w; x++, dst += 3) normalpixel(cur[x] - cur[x + 2], prev[x + 1] - next[x + 1], z, dst);
+}
+
+SIMD_TARGET_AVX2 static void normalrowavx2(const float *prev, const float *cur, const float *next, int w, float z, uchar *dst)
+{
+    const __m256 vz = _mm256_set1_ps(z), half = _mm256_set1_ps(127.5f);
+    int x = 0;
+    for(; x + 8 <= w; x += 8, dst += 24)
+    {
+        __m256 nx = _mm256_sub_ps(_mm256_loadu_ps(&cur[x]), _mm256_loadu_ps(&cur[x + 2])),
+               ny = _mm256_sub_ps(_mm256_loadu_ps(&prev[x + 1]), _mm256_loadu_ps(&next[x + 1])),
+               mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(vz, vz)));
+        alignas(32) int ox[8], oy[8], oz[8];
+        _mm256_store_si256((__m256i *)ox, _mm256_cvttps_epi32(_mm256_add_ps(half, _mm256_mul_ps(_mm256_div_ps(nx, mag), half))));
+        _mm256_store_si256((__m256i *)oy, _mm256_cvttps_epi32(_mm256_add_ps(half, _mm256_mul_ps(_mm256_div_ps(ny, mag), half))));
+        _mm256_store_si256((__m256i *)oz, _mm256_cvttps_epi32(_mm256_add_ps(half, _mm256_mul_ps(_mm256_div_ps(vz, mag), half))));
+        storenormals(ox, oy, oz, 8, dst);
+    }
+    for(; x < w; x++, dst += 3) normalpixel(cur[x] - cur[x + 2], prev[x + 1] - next[x + 1], z, dst);
+}
+
+/// x/255 for all x up to 255*255, as the scalar division rounds it.
+static inline __m128i div255(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+static void premulrowsse2(uchar *row, int w)
+{
+    const __m128i zero = _mm_setzero_si128(), alphamask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    int x = 0;
+    for(; x + 4 <= w; x += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)&row[4*x]),
+                lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero),
+                alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)),
+                ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        lo = _mm_or_si128(_mm_andnot_si128(alphamask, div255(_mm_mullo_epi16(lo, alo))), _mm_and_si128(alphamask, lo));
+        hi = _mm_or_si128(_mm_andnot_si128(alphamask, div255(_mm_mullo_epi16(hi, ahi))), _mm_and_si128(alphamask, hi));
+        _mm_storeu_si128((__m128i *)&row[4*x], _mm_packus_epi16(lo, hi));
+    }
+    for(; x < w; x++) premulpixel(&row[4*x]);
+}
+
+static void madrowsse2(uchar *row, int len, const float *mul, const float *add)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 low = _mm_setzero_ps(), high = _mm_set1_ps(255.0f);
+    __m128 muls[3], adds[3];
+    loopi(3)
+    {
+        muls[i] = _mm_loadu_ps(&mul[4*i]);
+        adds[i] = _mm_loadu_ps(&add[4*i]);
+    }
+    int x = 0;
+    for(; x + 48 <= len; x += 48) loopk(3) // 48 bytes are 12 vectors of floats, so the 12 factors repeat 4 times
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)&row[x + 16*k]),
+                lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero),
+                ints[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero), _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+        loopj(4)
+        {
+            int n = (4*k + j)%3;
+            __m128 f = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints[j]), muls[n]), adds[n]);
+            ints[j] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(f, low), high));
+        }
+        _mm_storeu_si128((__m128i *)&row[x + 16*k], _mm_packus_epi16(_mm_packs_epi32(ints[0], ints[1]), _mm_packs_epi32(ints[2], ints[3])));
+    }
+    for(; x < len; x++) row[x] = uchar(clamp(row[x]*mul[x%12] + add[x%12], 0.0f, 255.0f));
+}
+
+#endif
+
+bool halverows(int path, const uchar *src, uint sw, uint dh, uint bpp, uint stride, uchar *dst)
+{
+#ifdef SIMD_X86
+    if(path >= SIMD_AVX2) switch(bpp)
+    {
+        case 1: halveavx2<1>(src, sw, dh, stride, dst); return true;
+        case 2: halveavx2<2>(src, sw, dh, stride, dst); return true;
+        case 3: halvergbsse2(src, sw, dh, stride, dst); return true;
+        case 4: halveavx2<4>(src, sw, dh, stride, dst); return true;
+    }
+    if(path >= SIMD_SSE2) switch(bpp)
+    {
+        case 1: halvesse2<1>(src, sw, dh, stride, dst); return true;
+        case 2: halvesse2<2>(src, sw, dh, stride, dst); return true;
+        case 3: halvergbsse2(src, sw, dh, stride, dst); return true;
+        case 4: halvesse2<4>(src, sw, dh, stride, dst); return true;
+    }
+#endif
+    return false;
+}
+
+void normalrow(int path, const float *prev, const float *cur, const float *next, int w, float z, uchar *dst)
+{
+#ifdef SIMD_X86
+    if(path >= SIMD_AVX2) { normalrowavx2(prev, cur, next, w, z, dst); return; }
+    if(path >= SIMD_SSE2) { normalrowsse2(prev, cur, next, w, z, dst); return; }
+#endif
+    loop(x, w) normalpixel(cur[x] - cur[x + 2], prev[x + 1] - next[x + 1], z, &dst[3*x]);
+}
+
+void premulrow(int path, uchar *row, int w)
+{
+#ifdef SIMD_X86
+    if(path >= SIMD_SSE2) { premulrowsse2(row, w); return; }
+#endif
+    loop(x, w) premulpixel(&row[4*x]);
+}
+
+void madrow(int path, uchar *row, int len, const float *mul, const float *add)
+{
+#ifdef SIMD_X86
+    if(path >= SIMD_SSE2) { madrowsse2(row, len, mul, add); return; }
+#endif
+    loop(x, len) row[x] = uchar(clamp(row[x]*mul[x%12] + add[x%12], 0.0f, 255.0f));
+}
+
+/// Time the image operations on a generated size x size image,
+/// with every instruction set and with and without the job system.
+static void imagebench(int *size, int *iterations)
+{
+    int n = *size > 0 ? clamp(*size, 16, 4096) : 1024, num = *iterations > 0 ? *iterations : 10;
+    ImageData half(n/2, n/2, 4), scaled(n*3/4, n*3/4, 4);
+    struct benchkernel
+    {
+        const char *name;
+        int bpp;
+        std::function<void(ImageData &)> run;
+    };
+    const benchkernel kernels[] =
+    {
+        { "halve rgb", 3, [&](ImageData &s) { scaletexture(s.data, n, n, 3, s.pitch, half.data, n/2, n/2); } },
+        { "halve rgba", 4, [&](ImageData &s) { scaletexture(s.data, n, n, 4, s.pitch, half.data, n/2, n/2); } },
+        { "scale rgba", 4, [&](ImageData &s) { scaletexture(s.data, n, n, 4, s.pitch, scaled.data, n*3/4, n*3/4); } },
+        { "normal", 1, [&](ImageData &s) { texnormal(s, 3); } },
+        { "blur rgb", 3, [&](ImageData &s) { texblur(s, 1, 1); } },
+        { "premul", 4, [&](ImageData &s) { texpremul(s); } },
+        { "mad rgb", 3, [&](ImageData &s) { texmad(s, vec(0.9f, 1.1f, 1.0f), vec(0.01f, 0, 0)); } }
+    };
+    int oldsimd = imagesimd, oldjobs = imagejobs;
+    for(const benchkernel &k : kernels)
+    {
+        for(int path = SIMD_SCALAR; path <= cpusimd(); path++) loopj(JobSystem::running() ? 2 : 1)
+        {
+            // set without notifying anyone, this is no change of the settings
+            *imagesimd = path;
+            *imagejobs = j;
+            ImageData s(n, n, k.bpp);
+            loopi(n*n*k.bpp) s.data[i] = uchar((i*2654435761U)>>13);
+            auto start = std::chrono::steady_clock::now();
+            loopi(num) k.run(s);
+            std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+            Log.std->info("imagebench: {} {}x{}: {:.1f} MPixel/s with {}{}", k.name, n, n,
+                          double(n)*n*num / 1e6 / secs.count(), simdname(path), j ? " on the job system" : "");
+        }
+    }
+    *imagesimd = oldsimd;
+    *imagejobs = oldjobs;
+}
+COMMAND(imagebench, "ii");
@@ -0,0 +1,36 @@
+/// @file imagekernels.hpp
+/// SIMD versions of the per pixel loops of image.cpp, and splitting of large images into rows for the job system.
+/// All kernels give exactly the results of the scalar loops they replace.
+
+#pragma once
+
+#include <functional>                    // for function
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+#include "inexor/shared/cube_types.hpp"  // for uchar, uint
+#include "inexor/shared/simd.hpp"        // for SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2
+
+extern SharedVar<int> imagesimd, imagejobs;
+
+/// The fastest kernels this cpu supports, but none faster than the imagesimd variable allows.
+extern int imagepath();
+
+/// Call fn(y0, y1) for consecutive ranges of rows covering [0, h), in parallel on the job system if that pays off.
+/// @param rowbytes the amount of data processed per row.
+extern void splitrows(int h, int rowbytes, const std::function<void(int, int)> &fn);
+
+/// Halve dh rows of an image: every pixel of dst is the average of a 2x2 block of src.
+/// @return false if path has no kernel for bpp, the caller then uses the scalar loop.
+extern bool halverows(int path, const uchar *src, uint sw, uint dh, uint bpp, uint stride, uchar *dst);
+
+/// One row of texnormal(): the rgb normals of w heights.
+/// prev, cur and next are the rows above, at and below, each with the wrapped heights of both neighbours
+/// as padding, so pixel x is at index x+1.
+extern void normalrow(int path, const float *prev, const float *cur, const float *next, int w, float z, uchar *dst);
+
+/// Premultiply the colors of a row of w rgba pixels with their alpha.
+extern void premulrow(int path, uchar *row, int w);
+
+/// Apply byte = clamp(byte*mul + add, 0, 255) to len bytes of a row.
+/// mul and add hold 12 factors and offsets which repeat along the row, enough for whole pixels of 1 to 4 bytes.
+extern void madrow(int path, uchar *row, int len, const float *mul, const float *add);
@@ -8,6 +8,7 @@
 #include <string.h>                                   // for memcmp, memcpy
 #include <algorithm>                                  // for min, swap, max
 #include <memory>                                     // for __shared_ptr
+#include <string>                                     // for string
 
 #include "inexor/client/network.hpp"                  // for multiplayer
 #include "inexor/engine/material.hpp"                 // for ::MATF_INDEX
@@ -31,6 +32,8 @@
 #include "inexor/texture/image.hpp"                   // for ImageData, scal...
 #include "inexor/texture/macros.hpp"                  // for dst, src, readw...
 #include "inexor/texture/slot.hpp"
+#include "inexor/texture/streaming.hpp"               // for streamtexture
+#include "inexor/texture/texcache.hpp"                // for loadtexcache
 #include "inexor/texture/texture.hpp"                 // for ::TEX_DIFFUSE
 
 using namespace inexor::filesystem;
@@ -665,39 +668,69 @@ Slot::Tex *Slot::findtexture(int type)
 }
 
 
-void Slot::combinetextures(int index, Slot::Tex &t, bool msg, bool forceload)
+/// Load the image of t and merge the texture combined into it (e.g. a specmap into the alpha of the diffuse texture).
+static bool loadslottexture(ImageData &ts, Slot::Tex &t, Slot::Tex *combined, bool msg, int &compress)
 {
-    vector<char> key;
-    int texmask = 0; // receive control mask, todo check neccessarity
-
-    gencombinedname(key, texmask, *this, t, index, forceload);
-
-    t.t = gettexture(key.getbuf()); //todo check if working
-    if(t.t) return;
-    int compress = 0;
-    ImageData ts;
-    if(!texturedata(ts, nullptr, &t, msg, &compress)) { t.t = notexture; return; }
+    if(!texturedata(ts, nullptr, &t, msg, &compress)) return false;
     switch(t.type)
     {
         case TEX_DIFFUSE:
         case TEX_NORMAL:
-            if(!ts.compressed) loopv(sts)
+            if(!ts.compressed && combined)
             {
-                Slot::Tex &a = sts[i];
-                if(a.combined != index) continue;
+                Slot::Tex &a = *combined;
                 ImageData as;
-                if(!texturedata(as, nullptr, &a, msg)) continue;
+                if(!texturedata(as, nullptr, &a, msg)) break;
                 if(as.w != ts.w || as.h != ts.h) scaleimage(as, ts.w, ts.h);
                 switch(a.type)
                 {
                     case TEX_SPEC: mergespec(ts, as); break;
                     case TEX_DEPTH: mergedepth(ts, as); break;
                 }
-                break; // only one combination
             }
             break;
     }
+    return true;
+}
+
+void Slot::combinetextures(int index, Slot::Tex &t, bool msg, bool forceload)
+{
+    vector<char> key;
+    int texmask = 0; // receive control mask, todo check neccessarity
+
+    gencombinedname(key, texmask, *this, t, index, forceload);
+
+    t.t = gettexture(key.getbuf()); //todo check if working
+    if(t.t) return;
+
+    Slot::Tex *combined = nullptr;
+    loopv(sts) if(sts[i].combined == index) { combined = &sts[i]; break; } // only one combination
+
+    int w, h;
+    if(cantexstream() && texturesize(t.name, w, h))
+    {
+        // the slot may be gone once the worker gets to it, so it loads copies
+        Slot::Tex tex = t, comb;
+        if(combined) comb = *combined;
+        bool hascomb = combined != nullptr;
+        std::string name = key.getbuf();
+        t.t = streamtexture(key.getbuf(), w, h, t.type, [tex, comb, hascomb, name](ImageData &ts, int &compress) mutable
+        {
+            Slot::Tex *c = hascomb ? &comb : nullptr;
+            if(loadtexcache(name.c_str(), tex, c, ts, compress, false)) return true;
+            if(!loadslottexture(ts, tex, c, false, compress)) return false;
+            savetexcache(name.c_str(), tex, c, ts, compress);
+            return true;
+        }, 0, true, true, true);
+        return;
+    }
+
+    int compress = 0;
+    ImageData ts;
+    bool cached = loadtexcache(key.getbuf(), t, combined, ts, compress);
+    if(!cached && !loadslottexture(ts, t, combined, msg, compress)) { t.t = notexture; return; }
     t.t = newtexture( t.t, key.getbuf(), ts, 0, true, true, true, compress);
+    if(!cached) savetexcache(key.getbuf(), t, combined, ts, compress, t.t);
 }
 
 MSlot &lookupmaterialslot(int index, bool load)
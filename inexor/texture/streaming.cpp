@@ -0,0 +1,224 @@
+/// @file streaming.cpp
+/// Background loading of textures which are needed in the middle of the game.
+
+#include <SDL_opengl.h>                               // for glTexImage2D, GL_...
+#include <string.h>                                   // for memcpy
+#include <algorithm>                                  // for max
+#include <atomic>                                     // for atomic
+
+#include "inexor/engine/frame.hpp"                    // for renderedframe
+#include "inexor/engine/glexts.hpp"                   // for glBindBuffer_
+#include "inexor/io/Logging.hpp"                      // for Log, Logger
+#include "inexor/network/SharedVar.hpp"               // for SharedVar
+#include "inexor/shared/command.hpp"                  // for VARP
+#include "inexor/shared/cube_loops.hpp"               // for loopv, loopi
+#include "inexor/shared/cube_tools.hpp"               // for DELETEA
+#include "inexor/shared/cube_vector.hpp"              // for vector
+#include "inexor/shared/tools.hpp"                    // for max
+#include "inexor/texture/format.hpp"                  // for texformat, alpha...
+#include "inexor/texture/image.hpp"                   // for ImageData, scale...
+#include "inexor/texture/slot.hpp"                    // for texturedata
+#include "inexor/texture/streaming.hpp"
+#include "inexor/texture/texsettings.hpp"             // for reducefilter
+#include "inexor/texture/texture.hpp"                 // for Texture, registe...
+#include "inexor/util/JobSystem.hpp"                  // for JobSystem, JobHa...
+
+using inexor::util::JobSystem;
+
+VARP(texstream, 0, 1, 1);
+VARP(texstreamupload, 1, 2048, 1<<16);
+
+/// Levels up to this size get uploaded right when decoding finished, outside of the budget.
+#define PREVIEWSIZE (16*1024)
+
+struct streamedtex
+{
+    Texture *t;                   ///< nullptr once cancelled
+    int textype, clamp;
+    bool mipit, canreduce;
+    textureloader load;
+    inexor::util::JobHandle job;
+
+    // results of decode(), valid once the job is done
+    bool failed = false;          ///< the image could not be loaded, notexture got decoded in its place
+    int xs = 0, ys = 0, w = 0, h = 0, bpp = 0, filter = 0, numlevels = 0;
+    GLenum format = GL_FALSE, component = GL_FALSE;
+    uchar *pixels = nullptr;      ///< all mip levels, largest first
+    vector<int> offsets;
+
+    bool landed = false;          ///< texture parameters are set up, levels are being uploaded
+    int nextlevel = 0;            ///< next level to upload, counting down to 0
+
+    ~streamedtex() { DELETEA(pixels); }
+
+    int levelw(int level) const { return max(w>>level, 1); }
+    int levelh(int level) const { return max(h>>level, 1); }
+    int levelsize(int level) const { return levelw(level)*levelh(level)*bpp; }
+};
+
+static vector<streamedtex *> streams;
+static GLuint streampbo = 0;
+
+bool cantexstream()
+{
+    return texstream && renderedframe && JobSystem::running();
+}
+
+/// Load the image and build its mip chain the way newtexture() and createtexture() would; on a worker thread.
+static void decode(streamedtex *st)
+{
+    ImageData s;
+    int compress = 0;
+    if(!st->load(s, compress) || !s.data || s.compressed || !texformat(s.bpp))
+    {
+        // like the synchronous path the slot shows notexture then, the placeholder can't stay forever
+        st->failed = true;
+        s.cleanup();
+        compress = 0;
+        if(!texturedata(s, notexture->name, nullptr, false) || !s.data || s.compressed || !texformat(s.bpp)) return;
+    }
+
+    st->xs = s.w;
+    st->ys = s.h;
+    st->bpp = s.bpp;
+    st->format = texformat(s.bpp);
+    st->filter = !st->canreduce || reducefilter ? (st->mipit ? 2 : 1) : 0;
+    resizetexture(s.w, s.h, st->mipit, st->canreduce, GL_TEXTURE_2D, compress, st->w, st->h);
+    st->component = compressedformat(st->format, st->w, st->h, compress);
+
+    bool mipmap = st->filter > 1;
+    int total = 0;
+    for(int level = 0;; level++)
+    {
+        st->offsets.add(total);
+        total += st->levelsize(level);
+        st->numlevels++;
+        if(!mipmap || max(st->levelw(level), st->levelh(level)) <= 1) break;
+    }
+    st->pixels = new uchar[total];
+
+    if(s.w != st->w || s.h != st->h) scaletexture(s.data, s.w, s.h, s.bpp, s.pitch, st->pixels, st->w, st->h);
+    else loopi(s.h) memcpy(&st->pixels[i*s.w*s.bpp], &s.data[i*s.pitch], s.w*s.bpp);
+    for(int level = 1; level < st->numlevels; level++)
+    {
+        scaletexture(&st->pixels[st->offsets[level-1]], st->levelw(level-1), st->levelh(level-1), st->bpp, st->levelw(level-1)*st->bpp,
+                     &st->pixels[st->offsets[level]], st->levelw(level), st->levelh(level));
+    }
+}
+
+/// A single texel standing in for the texture until its first level arrives.
+static void createplaceholder(Texture *t, int textype, int clamp)
+{
+    static const uchar normal[4] = { 128, 128, 255, 255 }, glow[4] = { 0, 0, 0, 0 }, other[4] = { 128, 128, 128, 0 };
+    const uchar *texel = textype == TEX_NORMAL ? normal : (textype == TEX_GLOW ? glow : other);
+    glGenTextures(1, &t->id);
+    createtexture(t->id, 1, 1, (void *)texel, clamp, 1, GL_RGBA, GL_TEXTURE_2D, 0, 0, 0, false);
+}
+
+Texture *streamtexture(const char *rname, int w, int h, int textype, const textureloader &load, int clamp, bool mipit, bool canreduce, bool transient)
+{
+    Texture *t = registertexture(rname);
+    t->clamp = clamp;
+    t->mipmap = mipit;
+    t->type = Texture::IMAGE;
+    if(transient) t->type |= Texture::TRANSIENT;
+    t->xs = w;
+    t->ys = h;
+    t->w = t->h = 1;
+    t->bpp = 4;
+    createplaceholder(t, textype, clamp);
+
+    streamedtex *st = streams.add(new streamedtex);
+    st->t = t;
+    st->textype = textype;
+    st->clamp = clamp;
+    st->mipit = mipit;
+    st->canreduce = canreduce;
+    st->load = load;
+    st->job = JobSystem::running()->submit([st] { decode(st); });
+    return t;
+}
+
+/// Point the texture at its decoded image; the levels follow with uploadlevel().
+static void land(streamedtex &st)
+{
+    Texture *t = st.t;
+    if(st.xs != t->xs || st.ys != t->ys)
+        Log.std->debug("streamed texture {} is {}x{} instead of {}x{}", t->name, st.xs, st.ys, t->xs, t->ys);
+    t->xs = st.xs;
+    t->ys = st.ys;
+    t->w = st.w;
+    t->h = st.h;
+    t->bpp = st.bpp;
+    if(alphaformat(st.format)) t->type |= Texture::ALPHA;
+    setuptexparameters(t->id, st.pixels, st.clamp, st.filter, st.format, GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, st.numlevels-1);
+    st.nextlevel = st.numlevels-1;
+    st.landed = true;
+}
+
+/// Upload the next level through the pixel buffer and let the texture sample from it onwards.
+static int uploadlevel(streamedtex &st)
+{
+    int level = st.nextlevel--, w = st.levelw(level), h = st.levelh(level), size = st.levelsize(level);
+    const uchar *src = &st.pixels[st.offsets[level]];
+
+    if(!streampbo) glGenBuffers_(1, &streampbo);
+    glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, streampbo);
+    glBufferData_(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW); // orphan the last upload instead of waiting for it
+    void *dst = glMapBuffer_(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if(dst)
+    {
+        memcpy(dst, src, size);
+        glUnmapBuffer_(GL_PIXEL_UNPACK_BUFFER);
+        src = nullptr; // offset into the pixel buffer
+    }
+    else glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, st.t->id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, texalign(nullptr, w, st.bpp));
+    glTexImage2D(GL_TEXTURE_2D, level, st.component, w, h, 0, st.format, GL_UNSIGNED_BYTE, src);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    if(dst) glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0);
+    return size;
+}
+
+void updatetexstreaming()
+{
+    if(streams.empty()) return;
+    int budget = texstreamupload*1024;
+    loopv(streams)
+    {
+        streamedtex &st = *streams[i];
+        if(!st.t || st.landed || !st.job->finished) continue;
+        if(st.failed) Log.std->warn("could not load texture {}", st.t->name);
+        if(!st.numlevels)
+        {
+            st.t = nullptr;
+            continue;
+        }
+        land(st);
+        while(st.nextlevel >= 0 && st.levelsize(st.nextlevel) <= PREVIEWSIZE) uploadlevel(st);
+    }
+    loopv(streams)
+    {
+        streamedtex &st = *streams[i];
+        while(st.t && st.landed && st.nextlevel >= 0 && budget > 0) budget -= uploadlevel(st);
+        if(st.t && (!st.landed || st.nextlevel >= 0)) continue;
+        if(!st.job->finished) continue; // cancelled while decoding
+        delete streams.remove(i--);
+    }
+}
+
+void canceltexstream(Texture *t)
+{
+    loopv(streams) if(streams[i]->t == t) streams[i]->t = nullptr;
+}
+
+void cleanuptexstreaming()
+{
+    JobSystem *jobs = JobSystem::running();
+    loopv(streams) if(jobs) jobs->wait(streams[i]->job);
+    streams.deletecontents();
+    if(streampbo) { glDeleteBuffers_(1, &streampbo); streampbo = 0; }
+}
@@ -0,0 +1,44 @@
+/// @file streaming.hpp
+/// Background loading of textures which are needed in the middle of the game.
+///
+/// A streamed texture gets registered right away with its final image size, so everything depending
+/// on the size (e.g. the texture coordinates of the world geometry) is right from the start.
+/// Decoding, processing and mipmapping happen on the job system, meanwhile the texture shows a
+/// single neutral texel. The mip levels are then uploaded smallest first through a pixel buffer,
+/// at most texstreamupload kilobytes a frame, so the texture sharpens over a few frames.
+
+#pragma once
+
+#include <functional>                    // for function
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+
+struct ImageData;
+struct Texture;
+
+/// Whether to stream textures first used in game instead of loading them right away.
+extern SharedVar<int> texstream;
+/// Kilobytes of texture data to upload per frame.
+extern SharedVar<int> texstreamupload;
+
+/// Fills the pixels of a streamed texture, runs on a worker thread.
+typedef std::function<bool(ImageData &, int &compress)> textureloader;
+
+/// Whether textures requested now should be streamed: the game is rendered and the job system runs.
+/// On loading screens textures get loaded right away.
+extern bool cantexstream();
+
+/// Register the texture rname with an image size of w x h (see texturesize()) and load it in the background.
+/// @param textype TEX_DIFFUSE, TEX_NORMAL, ... to pick a fitting placeholder.
+/// The other parameters are the ones of newtexture().
+extern Texture *streamtexture(const char *rname, int w, int h, int textype, const textureloader &load,
+                              int clamp = 0, bool mipit = true, bool canreduce = false, bool transient = false);
+
+/// Upload what the workers have finished, call once a frame.
+extern void updatetexstreaming();
+
+/// Stop streaming into t, since its GL texture gets deleted.
+extern void canceltexstream(Texture *t);
+
+/// Wait for all workers and forget all streams, before all textures get cleaned up.
+extern void cleanuptexstreaming();
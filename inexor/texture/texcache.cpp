@@ -0,0 +1,247 @@
+/// @file texcache.cpp
+/// On-disk cache of slot textures with their texture commands and merges already applied.
+
+#include <SDL_opengl.h>                               // for glGetTexLevelPa...
+#include <stdio.h>                                    // for remove, rename
+#include <string.h>                                   // for strlen, strrchr
+#include <sys/stat.h>                                 // for stat
+#include <zlib.h>                                     // for crc32
+
+#include "inexor/engine/glexts.hpp"                   // for glGetCompressed...
+#include "inexor/io/Logging.hpp"                      // for Log, Logger
+#include "inexor/io/legacy/stream.hpp"                // for stream, openraw...
+#include "inexor/shared/command.hpp"                  // for VARP
+#include "inexor/shared/cube_endian.hpp"              // for lilswap
+#include "inexor/shared/cube_formatting.hpp"          // for nformatstring, formatstring
+#include "inexor/shared/cube_loops.hpp"               // for loopi
+#include "inexor/shared/cube_tools.hpp"               // for copystring
+#include "inexor/shared/cube_vector.hpp"              // for vector
+#include "inexor/shared/tools.hpp"                    // for max
+#include "inexor/texture/format.hpp"                  // for compressedformat
+#include "inexor/texture/image.hpp"                   // for ImageData
+#include "inexor/texture/texcache.hpp"
+#include "inexor/texture/texture.hpp"                 // for Texture
+
+VARP(texcache, 0, 1, 1);
+
+#define TEXCACHE_MAGIC "OTCF"
+#define TEXCACHE_VERSION 1
+
+/// The key follows this header in the cache file, then the image data, aligned to 16 bytes.
+struct texcacheheader
+{
+    char magic[4];
+    int version;
+    uint sources;          ///< crc of names, modification times and sizes of the source images
+    int w, h, bpp, levels, align, compress;
+    uint compressed;       ///< GL format of the cached mip chain, or 0 for plain pixels
+    int keylen, datasize;
+};
+
+static int texcachedataoffset(int keylen) { return (sizeof(texcacheheader) + keylen + 15)&~15; }
+
+/// Textures coming from dds files are as fast to load as the cache already.
+static bool cacheable(const Slot::Tex &t)
+{
+    const char *file = strrchr(t.name, '>');
+    file = file ? file+1 : t.name;
+    int len = strlen(file);
+    return !strstr(t.name, "<dds") && !strstr(t.name, "<stub") && (len < 4 || strcasecmp(&file[len-4], ".dds"));
+}
+
+static bool stampsource(uint &crc, const Slot::Tex &t)
+{
+    const char *file = strrchr(t.name, '>');
+    string pname;
+    copystring(pname, file ? file+1 : t.name);
+    const char *found = findfile(path(pname), "rb");
+    struct stat info;
+    if(!found || stat(found, &info)) return false;
+    long long stamp[2] = { (long long)info.st_mtime, (long long)info.st_size };
+    crc = crc32(crc, (const Bytef *)pname, strlen(pname));
+    crc = crc32(crc, (const Bytef *)stamp, sizeof(stamp));
+    return true;
+}
+
+/// Get the file name of the cache entry of key and the stamp of its sources.
+static bool texcacheentry(const char *key, const Slot::Tex &t, const Slot::Tex *combined, char *cachename, uint &sources)
+{
+    if(!texcache || !cacheable(t) || (combined && !cacheable(*combined))) return false;
+    sources = crc32(0, nullptr, 0);
+    if(!stampsource(sources, t) || (combined && !stampsource(sources, *combined))) return false;
+    nformatstring(cachename, MAXSTRLEN, "texcache/%08x.tex", uint(crc32(0, (const Bytef *)key, strlen(key))));
+    return true;
+}
+
+/// Keeps the cache file mapped for as long as an ImageData uses its pixels.
+struct texcachemapping
+{
+    stream *file;
+    void *data;
+    size_t len;
+};
+
+static void freetexcachemapping(void *owner)
+{
+    texcachemapping *m = (texcachemapping *)owner;
+    m->file->unmap(m->data, m->len);
+    delete m->file;
+    delete m;
+}
+
+/// Whether the driver would still compress the image of the entry the way it is cached.
+static bool usablecompressed(const texcacheheader &hdr)
+{
+    return compressedformat(uncompressedformat(hdr.compressed), hdr.w, hdr.h, hdr.compress) == hdr.compressed;
+}
+
+/// Whether cachename already holds a valid entry of key with a compressed mip chain still in use.
+static bool hascompressedentry(const char *cachename, const char *key, uint sources)
+{
+    stream *f = openrawfile(cachename, "rb");
+    if(!f) return false;
+    texcacheheader hdr;
+    bool ok = f->read(&hdr, sizeof(hdr)) == sizeof(hdr);
+    if(ok)
+    {
+        lilswap(&hdr.version, 11);
+        ok = !memcmp(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic)) && hdr.version == TEXCACHE_VERSION && hdr.sources == sources &&
+             hdr.compressed && hdr.keylen == int(strlen(key)) && hdr.datasize > 0 &&
+             f->size() >= stream::offset(texcachedataoffset(hdr.keylen) + hdr.datasize);
+    }
+    if(ok)
+    {
+        vector<char> storedkey;
+        storedkey.pad(hdr.keylen);
+        ok = f->read(storedkey.getbuf(), hdr.keylen) == size_t(hdr.keylen) && !memcmp(storedkey.getbuf(), key, hdr.keylen);
+    }
+    delete f;
+    return ok && usablecompressed(hdr);
+}
+
+bool loadtexcache(const char *key, const Slot::Tex &t, const Slot::Tex *combined, ImageData &d, int &compress, bool allowcompressed)
+{
+    string cachename;
+    uint sources;
+    if(!texcacheentry(key, t, combined, cachename, sources)) return false;
+    stream *f = openrawfile(cachename, "rb");
+    if(!f) return false;
+    size_t len = 0;
+    uchar *data = (uchar *)f->map(len);
+    if(!data) { delete f; return false; }
+
+    texcacheheader hdr;
+    bool ok = len >= sizeof(hdr);
+    if(ok)
+    {
+        memcpy(&hdr, data, sizeof(hdr));
+        lilswap(&hdr.version, 11);
+        ok = !memcmp(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic)) && hdr.version == TEXCACHE_VERSION && hdr.sources == sources &&
+             hdr.keylen == int(strlen(key)) && hdr.datasize > 0 && len >= size_t(texcachedataoffset(hdr.keylen) + hdr.datasize) &&
+             !memcmp(&data[sizeof(hdr)], key, hdr.keylen);
+    }
+    // a compressed chain is only of use if the current settings would compress it the same way
+    if(ok && hdr.compressed)
+        ok = allowcompressed && usablecompressed(hdr);
+    if(!ok) { f->unmap(data, len); delete f; return false; }
+
+    d.cleanup();
+    d.setdata(&data[texcachedataoffset(hdr.keylen)], hdr.w, hdr.h, hdr.bpp, hdr.levels, hdr.align, hdr.compressed);
+    if(d.calcsize() != hdr.datasize) { d.disown(); f->unmap(data, len); delete f; return false; }
+    d.owner = new texcachemapping { f, data, len };
+    d.freefunc = freetexcachemapping;
+    compress = hdr.compress;
+    return true;
+}
+
+/// Read back the mip chain the driver compressed tex to.
+/// Only done if tex got uploaded at the size of the image, so the chain can stand in for it.
+static bool readcompressed(Texture *tex, const ImageData &s, ImageData &d)
+{
+    if(!tex || tex->type&(Texture::COMPRESSED|Texture::STUB) || tex->w != s.w || tex->h != s.h) return false;
+    glBindTexture(GL_TEXTURE_2D, tex->id);
+    GLint compressed = 0, format = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    if(!compressed) return false;
+    int blocksize = 0;
+    switch(format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: blocksize = 8; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: blocksize = 16; break;
+        default: return false;
+    }
+    int levels = 1;
+    for(int lw = s.w, lh = s.h; max(lw, lh) > 1; levels++)
+    {
+        lw = max(lw/2, 1);
+        lh = max(lh/2, 1);
+        GLint size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        if(size <= 0) break;
+    }
+    d.setdata(nullptr, s.w, s.h, blocksize, levels, 4, format);
+    uchar *dst = d.data;
+    loopi(levels)
+    {
+        GLint size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        if(size != d.calclevelsize(i)) { d.cleanup(); return false; }
+        glGetCompressedTexImage_(GL_TEXTURE_2D, i, dst);
+        dst += size;
+    }
+    return true;
+}
+
+void savetexcache(const char *key, const Slot::Tex &t, const Slot::Tex *combined, const ImageData &d, int compress, Texture *tex)
+{
+    string cachename, tmpname;
+    uint sources;
+    if(!d.data || d.compressed || !texcacheentry(key, t, combined, cachename, sources)) return;
+
+    ImageData c;
+    const ImageData &s = readcompressed(tex, d, c) ? c : d;
+    // the streaming threads skip compressed entries, they must not replace them with plain pixels
+    if(!s.compressed && hascompressedentry(cachename, key, sources)) return;
+
+    // written next to the entry and renamed over it, as loaded entries stay mapped
+    formatstring(tmpname, "%s.tmp", cachename);
+    stream *f = openrawfile(tmpname, "wb");
+    if(!f) return;
+    texcacheheader hdr;
+    memcpy(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = TEXCACHE_VERSION;
+    hdr.sources = sources;
+    hdr.w = s.w;
+    hdr.h = s.h;
+    hdr.bpp = s.bpp;
+    hdr.levels = s.levels;
+    hdr.align = s.align;
+    hdr.compress = compress;
+    hdr.compressed = s.compressed;
+    hdr.keylen = strlen(key);
+    hdr.datasize = s.calcsize();
+    lilswap(&hdr.version, 11);
+
+    bool ok = f->write(&hdr, sizeof(hdr)) == sizeof(hdr) && f->write(key, hdr.keylen) == size_t(hdr.keylen);
+    for(int pad = texcachedataoffset(hdr.keylen) - sizeof(hdr) - hdr.keylen; ok && pad > 0; pad--) ok = f->putchar(0);
+    if(s.compressed || s.pitch == s.w*s.bpp) ok = ok && f->write(s.data, hdr.datasize) == size_t(hdr.datasize);
+    else loopi(s.h) ok = ok && f->write(&s.data[i*s.pitch], s.w*s.bpp) == size_t(s.w*s.bpp);
+    delete f;
+
+    string tmpfile, cachefile;
+    copystring(tmpfile, findfile(tmpname, "wb"));
+    copystring(cachefile, findfile(cachename, "wb"));
+    if(ok && rename(tmpfile, cachefile))
+    {
+        remove(cachefile); // windows does not replace existing files
+        ok = !rename(tmpfile, cachefile);
+    }
+    if(!ok)
+    {
+        remove(tmpfile);
+        Log.std->warn("could not write texture cache {}", cachename);
+    }
+}
@@ -0,0 +1,26 @@
+/// @file texcache.hpp
+/// On-disk cache of slot textures with their texture commands and merges already applied.
+///
+/// Entries are named after the combined texture name (see gencombinedname()) and are only valid
+/// as long as the source images keep their modification time and size.
+/// If the driver compressed the texture, its compressed mip chain gets cached instead of the pixels.
+
+#pragma once
+
+#include "inexor/network/SharedVar.hpp"  // for SharedVar
+#include "inexor/texture/slot.hpp"       // for Slot, Slot::Tex
+
+struct ImageData;
+struct Texture;
+
+extern SharedVar<int> texcache;
+
+/// Load the cached image of the combined texture key, made of t and the texture combined into it.
+/// The image data stays mapped from the cache file until d gets cleaned up.
+/// @param compress gets the compression requested by the texture commands.
+/// @param allowcompressed whether the compressed mip chain of the driver may be returned.
+extern bool loadtexcache(const char *key, const Slot::Tex &t, const Slot::Tex *combined, ImageData &d, int &compress, bool allowcompressed = true);
+
+/// Cache the processed image d of the combined texture key.
+/// @param tex the texture created from d, if its compressed levels should be cached instead; nullptr off the main thread.
+extern void savetexcache(const char *key, const Slot::Tex &t, const Slot::Tex *combined, const ImageData &d, int compress, Texture *tex = nullptr);
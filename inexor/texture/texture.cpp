@@ -27,13 +27,14 @@
 #include "inexor/shared/cube_tools.hpp"               // for matchstring
 #include "inexor/shared/geom.hpp"                     // for vec, vec::(anon...
 #include "inexor/shared/tools.hpp"                    // for max, clamp
-#include "inexor/texture/SDL_loading.hpp"             // for loadsurface
+#include "inexor/texture/SDL_loading.hpp"             // for loadsurface, loadsu...
 #include "inexor/texture/additionaltools.hpp"         // for flipnormalmapy
 #include "inexor/texture/compressedtex.hpp"           // for loaddds
 #include "inexor/texture/cubemap.hpp"                 // for clearenvmaps
 #include "inexor/texture/format.hpp"                  // for compressedformat
 #include "inexor/texture/image.hpp"                   // for ImageData, resi...
 #include "inexor/texture/slot.hpp"                    // for Slot::Tex, clea...
+#include "inexor/texture/streaming.hpp"               // for canceltexstream
 #include "inexor/texture/texsettings.hpp"             // for bilinear, maxte...
 #include "inexor/texture/texture.hpp"
 
@@ -355,6 +356,7 @@ VAR(scaledds, 0, 2, 4);
 bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex, bool msg, int *compress)
 {
     const char *cmds = nullptr, *file = tname;
+    string pname; // not static, the streaming threads load textures too
 
     if(!tname)
     {
@@ -368,7 +370,6 @@ bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex, bool msg, int
         }
         else file = tex->name;
 
-        static string pname; //todo threadsafe?
         formatstring(pname, "%s", file);
         file = path(pname);
     }
@@ -474,6 +475,48 @@ bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex, bool msg, int
     return true;
 }
 
+bool texturesize(const char *name, int &w, int &h)
+{
+    const char *cmds = nullptr, *file = name;
+    if(name[0]=='<')
+    {
+        cmds = name;
+        file = strrchr(name, '>');
+        if(!file) return false;
+        file++;
+    }
+    string pname;
+    copystring(pname, file);
+    file = path(pname);
+
+    int flen = strlen(file);
+    if(flen >= 4 && !strcasecmp(file + flen - 4, ".dds")) return false;
+    if(!loadsurfacesize(file, w, h) || max(w, h) > (1<<12)) return false;
+
+    while(cmds)
+    {
+        PARSETEXCOMMANDS(cmds);
+        if(matchstring(cmd, len, "rotate"))
+        {
+            int rots = atoi(arg[0]);
+            if(rots >= 1 && rots <= 5 && (rots&5) == 1) swap(w, h);
+        }
+        else if(matchstring(cmd, len, "reorient"))
+        {
+            if(atoi(arg[2]) > 0) swap(w, h);
+        }
+        else if(matchstring(cmd, len, "thumbnail"))
+        {
+            int tw = atoi(arg[0]), th = atoi(arg[1]);
+            if(tw <= 0 || tw > (1<<12)) tw = 64;
+            if(th <= 0 || th > (1<<12)) th = tw;
+            if(w > tw || h > th) { w = tw; h = th; }
+        }
+        else if(matchstring(cmd, len, "dds") || matchstring(cmd, len, "stub")) return false;
+    }
+    return true;
+}
+
 uchar *loadalphamask(Texture *t)
 {
     if(t->alphamask) return t->alphamask;
@@ -527,6 +570,7 @@ bool settexture(const char *name, int clamp)
 /// Clean up texture t: delete texture from gpu, only remove from registry if transient.
 void cleanuptexture(Texture *t)
 {
+    canceltexstream(t);
     DELETEA(t->alphamask);
     if(t->id) { glDeleteTextures(1, &t->id); t->id = 0; }
     if(t->type&Texture::TRANSIENT) textures.erase(t->name);
@@ -534,6 +578,7 @@ void cleanuptexture(Texture *t)
 
 void cleanuptextures()
 {
+    cleanuptexstreaming();
     clearenvmaps();
     cleanupslots();
     cleanupvslots();
@@ -74,6 +74,10 @@ extern Texture *newtexture(Texture *t, const char *rname, ImageData &s, int clam
 
 extern bool loadimage(const char *filename, ImageData &image);
 
+/// Tell the size texturedata() would return for name (with its <commands>) from the image header.
+/// @return false if that is not possible without loading it, e.g. for dds files.
+extern bool texturesize(const char *name, int &w, int &h);
+
 // Texture Registry:
 extern Texture *registertexture(const char *name);
 extern Texture *gettexture(const char *name);
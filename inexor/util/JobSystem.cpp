@@ -0,0 +1,210 @@
+#include "inexor/util/JobSystem.hpp"
+
+#include <algorithm>                                   // for max, min
+#include <utility>                                     // for move
+
+SUBSYSTEM_REGISTER(jobs, inexor::util::JobSystem);
+
+namespace inexor {
+namespace util {
+
+static JobSystem *current = nullptr;
+/// Index of the worker owning this thread, -1 outside of the pool.
+static thread_local int workerindex = -1;
+
+JobSystem::JobSystem()
+{
+    current = this;
+}
+
+JobSystem::~JobSystem()
+{
+    stop_workers();
+    if(current == this) current = nullptr;
+}
+
+void JobSystem::initialize(int argc, char **argv)
+{
+    if(!num_workers()) set_num_workers(std::max(int(std::thread::hardware_concurrency()) - 1, 1));
+}
+
+JobSystem *JobSystem::running()
+{
+    return current;
+}
+
+void JobSystem::set_num_workers(int num)
+{
+    num = std::max(num, 1);
+    if(num == num_workers()) return;
+    stop_workers();
+    start_workers(num);
+}
+
+int JobSystem::worker_index() const
+{
+    return workerindex >= 0 ? workerindex : num_workers();
+}
+
+void JobSystem::start_workers(int num)
+{
+    quit = false;
+    for(int i = 0; i < num; i++) workers.emplace_back(new Worker);
+    for(int i = 0; i < num; i++) workers[i]->thread = std::thread([this, i] { run_worker(i); });
+}
+
+void JobSystem::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleeplock);
+        quit = true;
+    }
+    wake.notify_all();
+    for(auto &w : workers) if(w->thread.joinable()) w->thread.join();
+    // Whatever is still queued runs here, nobody waits forever on a dropped job.
+    for(JobHandle job; (job = take(num_workers()));) execute(job);
+    workers.clear();
+}
+
+void JobSystem::run_worker(int index)
+{
+    workerindex = index;
+    for(;;)
+    {
+        if(JobHandle job = take(index)) { execute(job); continue; }
+        std::unique_lock<std::mutex> guard(sleeplock);
+        if(quit) break;
+        if(queued > 0) { guard.unlock(); std::this_thread::yield(); continue; }
+        wake.wait(guard, [this] { return quit || queued > 0; });
+    }
+    workerindex = -1;
+}
+
+void JobSystem::enqueue(const JobHandle &job)
+{
+    int num = num_workers();
+    if(!num) { execute(job); return; }
+    int index = job->affinity >= 0 ? job->affinity % num
+              : workerindex >= 0 && workerindex < num ? workerindex
+              : int(nextworker++ % unsigned(num));
+    Worker &w = *workers[index];
+    {
+        std::lock_guard<std::mutex> guard(w.lock);
+        w.jobs.push_back(job);
+    }
+    queued++;
+    // Taking the lock orders this against a thread that just found nothing and is about to sleep.
+    {
+        std::lock_guard<std::mutex> guard(sleeplock);
+    }
+    if(waiting > 0) wake.notify_all();
+    else wake.notify_one();
+}
+
+JobHandle JobSystem::take(int index)
+{
+    int num = num_workers();
+    if(queued <= 0 || !num) return nullptr;
+    if(index < num)
+    {
+        Worker &w = *workers[index];
+        std::lock_guard<std::mutex> guard(w.lock);
+        if(!w.jobs.empty())
+        {
+            JobHandle job = std::move(w.jobs.back());
+            w.jobs.pop_back();
+            queued--;
+            return job;
+        }
+    }
+    for(int i = 1; i <= num; i++)
+    {
+        Worker &victim = *workers[(index + i) % num];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(victim.jobs.empty()) continue;
+        JobHandle job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        queued--;
+        return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(const JobHandle &job)
+{
+    job->fn();
+    job->fn = nullptr;
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> guard(job->lock);
+        job->finished = true;
+        continuations.swap(job->continuations);
+    }
+    for(auto &c : continuations) if(--c->pending == 0) enqueue(c);
+    unfinished--;
+    if(waiting > 0)
+    {
+        { std::lock_guard<std::mutex> guard(sleeplock); }
+        wake.notify_all();
+    }
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn, const std::vector<JobHandle> &dependencies, int affinity)
+{
+    JobHandle job = std::make_shared<Job>();
+    unfinished++;
+    job->fn = std::move(fn);
+    job->affinity = affinity;
+    for(auto &dep : dependencies)
+    {
+        if(!dep) continue;
+        std::lock_guard<std::mutex> guard(dep->lock);
+        if(dep->finished) continue;
+        job->pending++;
+        dep->continuations.push_back(job);
+    }
+    if(--job->pending == 0) enqueue(job);
+    return job;
+}
+
+void JobSystem::wait(const JobHandle &job)
+{
+    while(!done(job))
+    {
+        if(JobHandle other = take(worker_index())) { execute(other); continue; }
+        waiting++;
+        {
+            std::unique_lock<std::mutex> guard(sleeplock);
+            wake.wait(guard, [this, &job] { return done(job) || queued > 0; });
+        }
+        waiting--;
+    }
+}
+
+void JobSystem::parallel_for(int num, const std::function<void(int)> &fn, int grain)
+{
+    grain = std::max(grain, 1);
+    int chunks = (num + grain - 1) / grain;
+    if(chunks <= 1 || !num_workers())
+    {
+        for(int i = 0; i < num; i++) fn(i);
+        return;
+    }
+    // Chunks are handed out by a counter, so a slow chunk does not hold up the others.
+    std::atomic<int> nextchunk{0};
+    auto work = [&]
+    {
+        for(int c; (c = nextchunk++) < chunks;)
+        {
+            int end = std::min((c + 1) * grain, num);
+            for(int i = c * grain; i < end; i++) fn(i);
+        }
+    };
+    std::vector<JobHandle> helpers;
+    for(int i = std::min(chunks - 1, num_workers()); i > 0; i--) helpers.push_back(submit(work));
+    work();
+    for(auto &h : helpers) wait(h);
+}
+
+}
+}
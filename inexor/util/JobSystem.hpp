@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>                                      // for atomic
+#include <condition_variable>                          // for condition_var...
+#include <deque>                                       // for deque
+#include <functional>                                  // for function
+#include <memory>                                      // for shared_ptr
+#include <mutex>                                       // for mutex
+#include <thread>                                      // for thread
+#include <vector>                                      // for vector
+
+#include "inexor/util/Subsystem.hpp"
+
+namespace inexor {
+namespace util {
+
+/// A unit of work for the JobSystem.
+struct Job
+{
+    std::function<void()> fn;
+    /// The worker this job should preferably run on, or -1.
+    int affinity = -1;
+    /// Unfinished dependencies; the job gets queued when this drops to zero.
+    std::atomic<int> pending{1};
+    std::atomic<bool> finished{false};
+    std::mutex lock;
+    /// Jobs depending on this one, queued once it has finished.
+    std::vector<std::shared_ptr<Job>> continuations;
+};
+
+/// Handle to a submitted job, used to wait for it or to depend on it.
+typedef std::shared_ptr<Job> JobHandle;
+
+/// Engine wide pool of worker threads.
+///
+/// Every worker owns a deque: jobs submitted from a worker are pushed
+/// to and popped from the back of its own deque (depth first, cache warm),
+/// idle workers steal from the front of the others.
+/// Jobs may depend on other jobs and waiting on a job executes queued
+/// jobs in the meantime, so jobs can fork and join further jobs.
+///
+/// If the subsystem is not running, callers should run their work inline.
+class JobSystem : public Subsystem
+{
+public:
+    JobSystem();
+    ~JobSystem() override;
+
+    /// Unless set_num_workers() was called before, starts one worker less than there are cores;
+    /// the calling thread makes up the last one.
+    void initialize(int argc, char **argv) override;
+
+    /// The running job system or nullptr.
+    static JobSystem *running();
+
+    /// Restart the pool with the given number of workers; must not be called from a job.
+    void set_num_workers(int num);
+    int num_workers() const { return int(workers.size()); }
+
+    /// Index of the worker executing the calling thread, num_workers() on any other thread.
+    /// Use it to pick per thread scratch data sized num_workers()+1.
+    int worker_index() const;
+
+    /// Queue fn to run once all dependencies have finished.
+    /// @param affinity Worker to prefer, other workers only take the job if that one is busy.
+    JobHandle submit(std::function<void()> fn, const std::vector<JobHandle> &dependencies = {}, int affinity = -1);
+
+    bool done(const JobHandle &job) const { return !job || job->finished; }
+
+    /// Whether no submitted job is left unfinished, including jobs still waiting on dependencies.
+    bool idle() const { return !unfinished; }
+
+    /// Block until the job has finished, running other queued jobs meanwhile.
+    void wait(const JobHandle &job);
+
+    /// Call fn(i) for all i in [0, num), in chunks of grain, and return once all have finished.
+    void parallel_for(int num, const std::function<void(int)> &fn, int grain = 1);
+
+private:
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<JobHandle> jobs;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    /// Jobs in any deque; sleeping threads wait on this.
+    std::atomic<int> queued{0};
+    std::atomic<int> waiting{0};
+    /// Submitted jobs which have not finished yet.
+    std::atomic<int> unfinished{0};
+    std::atomic<unsigned> nextworker{0};
+    std::mutex sleeplock;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void start_workers(int num);
+    void stop_workers();
+    void run_worker(int index);
+    void enqueue(const JobHandle &job);
+    JobHandle take(int index);
+    void execute(const JobHandle &job);
+};
+
+}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>  // for size_t
+#include <atomic>    // for atomic, memory_order_acquire, memory_order_release
+
+namespace inexor {
+namespace util {
+
+/// Bounded lock-free queue between exactly one producer and one consumer thread.
+///
+/// push() may only be called by the producer, pop() only by the consumer.
+/// Neither blocks: push() fails if the queue is full, pop() if it is empty.
+template<typename T, size_t SIZE>
+class SpscQueue
+{
+    static_assert(SIZE && !(SIZE & (SIZE-1)), "the size of a SpscQueue must be a power of two");
+
+    T items[SIZE];
+    /// Next item to pop, only written by the consumer.
+    alignas(64) std::atomic<size_t> head{0};
+    /// Next free slot, only written by the producer.
+    alignas(64) std::atomic<size_t> tail{0};
+
+public:
+    SpscQueue() {}
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) >= SIZE) return false;
+        items[t & (SIZE-1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & (SIZE-1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Only a hint if called by the producer.
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+}
+}